@@ -31,10 +31,10 @@
 
 #include <stdint.h>
 #include <stdio.h>
-#include "hardware/i2c.h"
-#include "hardware/gpio.h"
+#include "cmsis_os2.h"
 
 #include "HTU21D.h"
+#include "crc8.h"
 
 #define HTU21D_ADDRESS 0x40  //Unshifted 7-bit I2C address for the sensor
 
@@ -49,76 +49,105 @@
 #define READ_USER_REG  0xE7
 #define SOFT_RESET  0xFE
 
-#define USER_REGISTER_RESOLUTION_MASK 0x81
-#define USER_REGISTER_RESOLUTION_RH12_TEMP14 0x00
-#define USER_REGISTER_RESOLUTION_RH8_TEMP12 0x01
-#define USER_REGISTER_RESOLUTION_RH10_TEMP13 0x80
-#define USER_REGISTER_RESOLUTION_RH11_TEMP11 0x81
+
+//Longest conversion times at the power on resolution, page 3 (see setResolution)
+#define HUMIDITY_CONVERSION_MS  16    //12 bit
+#define TEMP_CONVERSION_MS      50    //14 bit
+#define EXTRA_WAIT_MS           20    //allowance before giving up on a reading
 
 #define USER_REGISTER_END_OF_BATTERY 0x40
 #define USER_REGISTER_HEATER_ENABLED 0x04
 #define USER_REGISTER_DISABLE_OTP_RELOAD 0x02
 
+//Conversions from page 14, folded to fixed point at compile time
+static constexpr Linear<Humidity> humidity_scale( 125.0 / 65536.0, -6.0 );            //2^16 = 65536
+static constexpr Linear<Temperature> temperature_scale( 175.72 / 65536.0, -46.85 );
+
 HTU21D::HTU21D()
 {
   //Set initial values for private vars
+  i2c_bus = 0;
+  pending_cmd = 0;
+  ready_time = nil_time;
+  humidity_ms = HUMIDITY_CONVERSION_MS;
+  temperature_ms = TEMP_CONVERSION_MS;
 }
 
 //Begin
 /*******************************************************************************************/
-//Start I2C communication
+//Start I2C communication - the HTU21D runs at up to 400kHz
 void HTU21D::begin( int i2cport, int SDA_Pin, int SCL_pin )
 {
-  int  retval;
+  i2c_bus = i2cport;
+  if ( !I2cBus_init( i2c_bus, I2C_BUS_FAST_MODE, SDA_Pin, SCL_pin ) )
+    printf("I2C%d init failed\n", i2c_bus );
+}
+
+//Wait, letting other threads run once the RTOS is going
+void HTU21D::waitUntil( absolute_time_t time )
+{
+  int64_t   remaining_us;
 
-  // select port
-  if ( i2cport==1 )
-    i2c_port = i2c1;
+  remaining_us = absolute_time_diff_us( get_absolute_time(), time );
+  if ( remaining_us<=0 )
+    return;
+  if ( osKernelGetState()==osKernelRunning )
+    osDelay( (uint32_t)((remaining_us+999)/1000) + 1 );   // osDelay may be up to one tick short
   else
-    i2c_port = i2c0;
-  // init port and pins
-  retval = i2c_init( i2c_port, 100 * 1000 );
-  //printf("Init returned %d\n", retval );
-  gpio_set_function( SDA_Pin, GPIO_FUNC_I2C );
-  gpio_pull_up( SDA_Pin );
-  gpio_set_function( SCL_pin, GPIO_FUNC_I2C );
-  gpio_pull_up( SCL_pin );
+    sleep_until( time );
 }
 
-#define MAX_WAIT 100
-#define DELAY_INTERVAL 10
-#define MAX_COUNTER (MAX_WAIT/DELAY_INTERVAL)
+//Trigger a NOHOLD measurement, to be read once the conversion time has passed
+bool HTU21D::startMeasurement( uint8_t cmd, uint32_t conversion_ms )
+{
+  I2cStatus_t status;
+
+  // the sensor ignores commands until any measurement in progress is done
+  waitUntil( ready_time );
+  pending_cmd = 0;
+
+  // issue command
+  status = I2cBus_transfer( i2c_bus, HTU21D_ADDRESS, &cmd,1, NULL,0 );
+  if ( status!=I2C_BUS_DONE )
+  {
+    printf("I2cBus_transfer write returned %d\n", status );
+    return false;
+  }
+  pending_cmd = cmd;
+  ready_time = make_timeout_time_ms( conversion_ms );
+  return true;
+}
 
 //Given a command, reads a given 2-byte value with CRC from the HTU21D
+//  The measurement is started first, unless it already has been
 bool HTU21D::readValue( uint8_t cmd, uint16_t *value )
 {
-  int       retval;
+  I2cStatus_t status;
   uint8_t   read_buf[3] = {0};
   uint16_t  rawValue;
-  uint32_t  timeout;
+  absolute_time_t giveup_time;
 
   // Request a reading. Read 3 bytes - high-byte low-byte crc
-
-  // issue command
-  retval = i2c_write_timeout_us( i2c_port, HTU21D_ADDRESS, &cmd,1, false, 1000 );
-  if ( retval!=1 )
+  if ( pending_cmd!=cmd )
   {
-    printf("i2c_write_timeout_us returned %d\n", retval );
-    return false;
+    if ( !startMeasurement( cmd, (cmd==TRIGGER_HUMD_MEASURE_NOHOLD) ? humidity_ms : temperature_ms ) )
+      return false;
   }
-  // wait for valid response when ready
-  timeout = 100000;
-  while ( timeout>0 )
+  pending_cmd = 0;
+
+  // sleep through the conversion, then read - the sensor NAKs until it is done
+  waitUntil( ready_time );
+  giveup_time = delayed_by_ms( ready_time, EXTRA_WAIT_MS );
+  while ( true )
   {
-    retval = i2c_read_timeout_us( i2c_port, HTU21D_ADDRESS, read_buf,3, false, 1000 );
-    if ( retval>0 )
+    status = I2cBus_transfer( i2c_bus, HTU21D_ADDRESS, NULL,0, read_buf,3 );
+    if ( (status!=I2C_BUS_NAK) || (absolute_time_diff_us( get_absolute_time(), giveup_time )<=0) )
       break;
-    sleep_us(50);
-    timeout -= 50;
+    waitUntil( make_timeout_time_ms( 1 ) );
   }
-  if ( retval!=3 )
+  if ( status!=I2C_BUS_DONE )
   {
-    printf("i2c_read_timeout_us returned %d\n", retval );
+    printf("I2cBus_transfer read returned %d\n", status );
     return false;
   }
   rawValue = ( ((uint16_t)(read_buf[0])) << 8) | ((uint16_t)(read_buf[1]));
@@ -132,42 +161,48 @@ bool HTU21D::readValue( uint8_t cmd, uint16_t *value )
   return true;
 }
 
+//Start a humidity measurement
+bool HTU21D::startHumidity( void )
+{
+  return startMeasurement( TRIGGER_HUMD_MEASURE_NOHOLD, humidity_ms );
+}
+
+//Start a temperature measurement
+bool HTU21D::startTemperature( void )
+{
+  return startMeasurement( TRIGGER_TEMP_MEASURE_NOHOLD, temperature_ms );
+}
+
 //Read the humidity
-bool HTU21D::readHumidity( double *value )
+bool HTU21D::readHumidity( Humidity *value )
 {
   bool      retb;
   uint16_t  rawHumidity;
-  double    tempHumidity;
   
   retb = readValue( TRIGGER_HUMD_MEASURE_NOHOLD, &rawHumidity );
   if ( !retb )
     return false;
 
   //Given the raw humidity data, calculate the actual relative humidity
-  tempHumidity = rawHumidity * (125.0 / 65536.0);     //2^16 = 65536
-  *value = tempHumidity - 6.0;                        //From page 14
+  *value = humidity_scale.apply( rawHumidity );
   return true;
 }
 
 //Read the temperature
-bool HTU21D::readTemperature( double *value )
+bool HTU21D::readTemperature( Temperature *value )
 {
   bool      retb;
   uint16_t  rawTemperature;
-  double    tempTemperature;
   
   retb = readValue( TRIGGER_TEMP_MEASURE_NOHOLD, &rawTemperature );
   if ( !retb )
     return false;
 
   // Given the raw temperature data, calculate the actual temperature
-  tempTemperature = rawTemperature * (175.72 / 65536.0);  //2^16 = 65536
-  *value = tempTemperature - 46.85;                       //From page 14
+  *value = temperature_scale.apply( rawTemperature );
   return true;
 }
 
-#if 0
-
 //Set sensor resolution
 /*******************************************************************************************/
 //Sets the sensor resolution to one of four levels
@@ -177,54 +212,83 @@ bool HTU21D::readTemperature( double *value )
 // 1/0 = 10bit RH, 13bit Temp
 // 1/1 = 11bit RH, 11bit Temp
 //Power on default is 0/0
+//The conversion times waited for follow the resolution
 
-void HTU21D::setResolution(uint8_t resolution)
+bool HTU21D::setResolution( uint8_t resolution )
 {
-  uint8_t userRegister = readUserRegister(); //Go get the current register state
+  uint8_t userRegister;
+
+  if ( !readUserRegister( &userRegister ) ) //Go get the current register state
+    return false;
   userRegister &= 0x7E;   // B01111110; //Turn off the resolution bits
-  resolution &= 0x81;     // B10000001; //Turn off all other bits but resolution bits
+  resolution &= USER_REGISTER_RESOLUTION_MASK;  // B10000001; //Turn off all other bits but resolution bits
   userRegister |= resolution; //Mask in the requested resolution bits
 
   //Request a write to user register
-  writeUserRegister(userRegister);
+  if ( !writeUserRegister( userRegister ) )
+    return false;
+
+  //Longest conversion times, page 3
+  switch ( resolution )
+  {
+    case USER_REGISTER_RESOLUTION_RH8_TEMP12:
+      humidity_ms = 3;
+      temperature_ms = 13;
+      break;
+    case USER_REGISTER_RESOLUTION_RH10_TEMP13:
+      humidity_ms = 5;
+      temperature_ms = 25;
+      break;
+    case USER_REGISTER_RESOLUTION_RH11_TEMP11:
+      humidity_ms = 8;
+      temperature_ms = 7;
+      break;
+    default:
+      humidity_ms = HUMIDITY_CONVERSION_MS;
+      temperature_ms = TEMP_CONVERSION_MS;
+      break;
+  }
+  return true;
 }
 
 //Read the user register
-uint8_t HTU21D::readUserRegister(void)
+bool HTU21D::readUserRegister( uint8_t *value )
 {
-  uint8_t userRegister;
-
-  //Request the user register
-  _i2cPort->beginTransmission(HTU21D_ADDRESS);
-  _i2cPort->write(READ_USER_REG); //Read the user register
-  _i2cPort->endTransmission();
-
-  //Read result
-  _i2cPort->requestFrom(HTU21D_ADDRESS, 1);
-
-  userRegister = _i2cPort->read();
+  I2cStatus_t status;
+  uint8_t     cmd = READ_USER_REG;
 
-  return (userRegister);
+  //Request the user register, and read it after a repeated start
+  waitUntil( ready_time );
+  status = I2cBus_transfer( i2c_bus, HTU21D_ADDRESS, &cmd,1, value,1 );
+  if ( status!=I2C_BUS_DONE )
+  {
+    printf("I2cBus_transfer user register read returned %d\n", status );
+    return false;
+  }
+  return true;
 }
 
-void HTU21D::writeUserRegister(uint8_t val)
+//Write the user register
+bool HTU21D::writeUserRegister( uint8_t val )
 {
-  _i2cPort->beginTransmission(HTU21D_ADDRESS);
-  _i2cPort->write(WRITE_USER_REG); //Write to the user register
-  _i2cPort->write(val); //Write the new resolution bits
-  _i2cPort->endTransmission();
-}
+  I2cStatus_t status;
+  uint8_t     cmd[2] = { WRITE_USER_REG, val };  //Write the new resolution bits
 
-#endif
+  waitUntil( ready_time );
+  status = I2cBus_transfer( i2c_bus, HTU21D_ADDRESS, cmd,2, NULL,0 );
+  if ( status!=I2C_BUS_DONE )
+  {
+    printf("I2cBus_transfer user register write returned %d\n", status );
+    return false;
+  }
+  return true;
+}
 
 
 //Give this function the 2 byte message (measurement) and the check_value byte from the HTU21D
 //If it returns 0, then the transmission was good
 //If it returns something other than 0, then the communication was corrupted
-//From: http://www.nongnu.org/avr-libc/user-manual/group__util__crc.html
 //POLYNOMIAL = 0x0131 = x^8 + x^5 + x^4 + 1 : http://en.wikipedia.org/wiki/Computation_of_cyclic_redundancy_checks
-#define SHIFTED_DIVISOR 0x988000 //This is the 0x0131 polynomial shifted to farthest left of three bytes
-
 uint8_t HTU21D::checkCRC(uint16_t message_from_sensor, uint8_t check_value_from_sensor)
 {
   //Test cases from datasheet:
@@ -232,24 +296,7 @@ uint8_t HTU21D::checkCRC(uint16_t message_from_sensor, uint8_t check_value_from_
   //message = 0x683A, checkvalue is 0x7C
   //message = 0x4E85, checkvalue is 0x6B
 
-  uint32_t remainder = (uint32_t)message_from_sensor << 8; //Pad with 8 bits because we have to add in the check value
-  remainder |= check_value_from_sensor; //Add on the check value
-
-  uint32_t divsor = (uint32_t)SHIFTED_DIVISOR;
-
-  for (int i = 0 ; i < 16 ; i++) //Operate on only 16 positions of max 24. The remaining 8 are our remainder and should be zero when we're done.
-  {
-    //Serial.print("remainder: ");
-    //Serial.println(remainder, BIN);
-    //Serial.print("divsor:    ");
-    //Serial.println(divsor, BIN);
-    //Serial.println();
-
-    if ( remainder & (uint32_t)1 << (23 - i) ) //Check if there is a one in the left position
-      remainder ^= divsor;
-
-    divsor >>= 1; //Rotate the divsor max 16 times so that we have 8 bits left of a remainder
-  }
+  uint8_t message[2] = { (uint8_t)(message_from_sensor >> 8), (uint8_t)message_from_sensor };
 
-  return (uint8_t)remainder;
+  return Crc8_htu21d::compute(message, sizeof(message)) ^ check_value_from_sensor;
 }
\ No newline at end of file
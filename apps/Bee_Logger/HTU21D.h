@@ -19,7 +19,16 @@
  */
 #include <stdbool.h>
 #include <stdint.h>
-#include "hardware/i2c.h"
+#include "pico/time.h"
+#include "i2c_bus.h"
+#include "fixed_point.h"
+
+//Resolution settings of the user register
+#define USER_REGISTER_RESOLUTION_MASK 0x81
+#define USER_REGISTER_RESOLUTION_RH12_TEMP14 0x00
+#define USER_REGISTER_RESOLUTION_RH8_TEMP12 0x01
+#define USER_REGISTER_RESOLUTION_RH10_TEMP13 0x80
+#define USER_REGISTER_RESOLUTION_RH11_TEMP11 0x81
 
 class HTU21D
 {
@@ -28,21 +37,31 @@ class HTU21D
 
     //Public Functions
     void begin( int i2cport, int SDA_Pin, int SCL_pin );
-    bool readHumidity( double *value );
-    bool readTemperature( double *value );
-//    void setResolution( uint8_t resBits );
+    // Start a measurement, without waiting for it (one at a time)
+    bool startHumidity( void );
+    bool startTemperature( void );
+    // Collect the measurement started, or start one and wait for it
+    bool readHumidity( Humidity *value );
+    bool readTemperature( Temperature *value );
+    bool setResolution( uint8_t resBits );
 
-//    uint8_t readUserRegister( void );
-//    void writeUserRegister( uint8_t val );
+    bool readUserRegister( uint8_t *value );
+    bool writeUserRegister( uint8_t val );
 
     //Public Variables
 
   private:
     //Private Functions
     uint8_t checkCRC( uint16_t message_from_sensor, uint8_t check_value_from_sensor );
+    bool startMeasurement( uint8_t cmd, uint32_t conversion_ms );
     bool readValue( uint8_t cmd, uint16_t *value );
+    void waitUntil( absolute_time_t time );
 
     //Private Variables
-    i2c_inst_t *i2c_port;
+    int i2c_bus;                      // shared through the I2C bus manager
+    uint8_t pending_cmd;              // measurement started, 0 if none
+    absolute_time_t ready_time;       // when it will be done
+    uint32_t humidity_ms;             // conversion times at the resolution set
+    uint32_t temperature_ms;
 
 };
@@ -0,0 +1,328 @@
+/*---------------------------------------------------------------------------
+
+    Acquisition
+        Reads every sensor bus at once, each with its own worker thread
+
+    clayton@isnotcrazy.com
+
+    The buses (ADC, I2C, HX711 and each 1-Wire pin) share nothing, so
+    reading them one after another wastes most of the cycle waiting.
+    Each bus has a worker thread which sleeps until a cycle starts, reads
+    its sensors into the staging snapshot, and sets its bit in the done
+    event flags.  The application waits for every bit (the barrier), then
+    takes a copy of the snapshot, so the cycle takes as long as the
+    slowest bus rather than the sum of them all.
+
+    A run need not start every worker - the buses are read at different
+    rates - and the readings of those not started are kept from their
+    last run.
+
+    Each worker only writes its own part of the staging snapshot.  The
+    load cell temperature is taken from the previous cycle's ambient
+    reading, so the weight does not have to wait for the HTU21D.
+
+---------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "pico/time.h"
+#include "cmsis_os2.h"
+#include "console.h"
+#include "supply_voltage.h"
+#include "analog_calibration.h"
+#include "humidity_temp_sensors.h"
+#include "weight_calibration.h"
+#include "acquisition.h"
+
+// Macros
+
+#define ACQ_CYCLE_TIMEOUT_MS    3000        // well inside the watchdog
+#define ACQ_START_FLAG          0x0001      // thread flag to a worker
+#define ACQ_WEIGHT_SAMPLES      8           // latest HX711 samples filtered for the weight
+
+// Also read the RP2040's own temperature (ADC4), published as "ChipTemperature"
+#define CHIP_TEMPERATURE        0
+
+// Types
+
+typedef struct
+{
+    const char          *name;
+    void                (*run)( int bus );
+    int                 bus;                // for the 1-Wire workers
+    osThreadId_t        thread;
+    volatile bool       busy;
+    AcqStats_t          stats;
+} AcqWorker_t;
+
+// Private Function Prototypes
+
+static void Acquisition_readSupply( int bus );
+static void Acquisition_readHumidity( int bus );
+static void Acquisition_readWeight( int bus );
+static void Acquisition_readTemperatures( int bus );
+
+// Data
+
+static const osThreadAttr_t acq_worker_attr =
+{
+    .name = "acq",
+    .stack_size = 2048U,
+    .priority = osPriorityNormal
+};
+
+_Static_assert( TEMP_BUS_COUNT==4, "one worker is listed for each 1-Wire bus" );
+
+static AcqWorker_t acq_workers[ACQ_WORKERS] =
+{
+    { "adc",     Acquisition_readSupply,        0 },
+    { "i2c",     Acquisition_readHumidity,      0 },
+    { "hx711",   Acquisition_readWeight,        0 },
+    { "1-wire1", Acquisition_readTemperatures,  0 },
+    { "1-wire2", Acquisition_readTemperatures,  1 },
+    { "1-wire3", Acquisition_readTemperatures,  2 },
+    { "1-wire4", Acquisition_readTemperatures,  3 },
+};
+
+static AcqStats_t           acq_cycle_stats;
+static uint32_t             acq_last_run;           // workers started by the last run
+static osEventFlagsId_t     acq_done;               // a flag per worker
+static AcqSnapshot_t        acq_staging;
+
+// Private Functions
+
+// ADC worker
+static void Acquisition_readSupply( int bus )
+{
+    (void)bus;
+    acq_staging.supply_valid = SupplyVoltage_read( &acq_staging.supply_reading, &acq_staging.pin_voltage,
+                                                   &acq_staging.supply_voltage );
+    acq_staging.chip_temp_valid = CHIP_TEMPERATURE && AnalogCalibration_chipTemperature( &acq_staging.chip_temp );
+}
+
+// I2C worker - the HTU21D makes one measurement at a time, so the
+// temperature then the humidity, each read starting its own (the
+// conversions overlap the other workers, not each other)
+static void Acquisition_readHumidity( int bus )
+{
+    (void)bus;
+    acq_staging.ambient_temp_valid = HumidityTempSensor_read( TEMP_SENSOR, &acq_staging.ambient_temp );
+    acq_staging.humidity_valid = HumidityTempSensor_read( HUMIDITY_SENSOR, &acq_staging.humidity );
+}
+
+// HX711 worker
+static void Acquisition_readWeight( int bus )
+{
+    (void)bus;
+    acq_staging.weight_valid = WeightSensor_window( ACQ_WEIGHT_SAMPLES, &acq_staging.weight );
+}
+
+// 1-Wire worker, one for each bus
+static void Acquisition_readTemperatures( int bus )
+{
+    TempSensor_readBus( bus, acq_staging.temperatures, acq_staging.temperatures_valid );
+}
+
+// Mark the readings of a worker that missed the cycle
+static void Acquisition_invalidate( int worker, AcqSnapshot_t *snapshot )
+{
+    int     ii;
+
+    switch ( worker )
+    {
+    case ACQ_WORKER_SUPPLY:
+        snapshot->supply_valid = false;
+        snapshot->chip_temp_valid = false;
+        break;
+    case ACQ_WORKER_HUMIDITY:
+        snapshot->ambient_temp_valid = false;
+        snapshot->humidity_valid = false;
+        break;
+    case ACQ_WORKER_WEIGHT:
+        snapshot->weight_valid = false;
+        break;
+    default:
+        for ( ii=0; ii<snapshot->temperature_count; ii++ )
+        {
+            if ( TempSensor_bus( ii+1 )==acq_workers[worker].bus )
+            {
+                snapshot->temperatures_valid[ii] = false;
+            }
+        }
+        break;
+    }
+}
+
+// Add a run to the timing
+static void Acquisition_record( AcqStats_t *stats, uint32_t elapsed_us )
+{
+    stats->runs++;
+    stats->last_us = elapsed_us;
+    stats->total_us += elapsed_us;
+    if ( elapsed_us>stats->max_us )
+    {
+        stats->max_us = elapsed_us;
+    }
+}
+
+// Worker thread - one run for each start flag
+static void Acquisition_worker( void *argument )
+{
+    AcqWorker_t     *worker;
+    uint32_t        start;
+
+    worker = (AcqWorker_t *)argument;
+    while ( 1 )
+    {
+        osThreadFlagsWait( ACQ_START_FLAG, osFlagsWaitAny, osWaitForever );
+        start = time_us_32();
+        worker->run( worker->bus );
+        Acquisition_record( &worker->stats, time_us_32() - start );
+        worker->busy = false;
+        osEventFlagsSet( acq_done, ACQ_WORKER_BIT(worker - acq_workers) );
+    }
+}
+
+// Public Functions
+
+// Start the workers
+void Acquisition_init( void )
+{
+    int     ii;
+
+    acq_done = osEventFlagsNew( NULL );
+    for ( ii=0; ii<ACQ_WORKERS; ii++ )
+    {
+        acq_workers[ii].thread = osThreadNew( Acquisition_worker, &acq_workers[ii], &acq_worker_attr );
+        if ( acq_workers[ii].thread==NULL )
+        {
+            printf( "Acquisition - no memory for the %s worker\n", acq_workers[ii].name );
+        }
+    }
+}
+
+// Run some of the workers
+bool Acquisition_run( uint32_t workers, AcqSnapshot_t *snapshot )
+{
+    AcqWorker_t     *worker;
+    uint32_t        start;
+    uint32_t        waiting;
+    uint32_t        done;
+    int             ii;
+
+    start = time_us_32();
+    acq_staging.temperature_count = TempSensor_count();
+
+    // start the idle workers - any still busy from the last cycle are just waited for
+    waiting = 0;
+    for ( ii=0; ii<ACQ_WORKERS; ii++ )
+    {
+        worker = &acq_workers[ii];
+        if ( (worker->thread==NULL) || ((workers & ACQ_WORKER_BIT(ii))==0) )
+        {
+            continue;
+        }
+        waiting |= ACQ_WORKER_BIT(ii);
+        if ( !worker->busy )
+        {
+            worker->busy = true;
+            osEventFlagsClear( acq_done, ACQ_WORKER_BIT(ii) );
+            osThreadFlagsSet( worker->thread, ACQ_START_FLAG );
+        }
+    }
+
+    // barrier
+    done = osEventFlagsWait( acq_done, waiting, osFlagsWaitAll | osFlagsNoClear, ACQ_CYCLE_TIMEOUT_MS );
+    if ( (done & osFlagsError)!=0 )
+    {
+        done = osEventFlagsGet( acq_done );
+    }
+
+    *snapshot = acq_staging;
+    snapshot->updated = waiting & done;
+    acq_last_run = waiting;
+    for ( ii=0; ii<ACQ_WORKERS; ii++ )
+    {
+        if ( ((waiting & ~done) & ACQ_WORKER_BIT(ii))!=0 )
+        {
+            printf( "Acquisition - %s worker missed the cycle\n", acq_workers[ii].name );
+            acq_workers[ii].stats.timeouts++;
+            Acquisition_invalidate( ii, snapshot );
+        }
+    }
+
+    // load cell compensation for the next weight
+    if ( ((snapshot->updated & ACQ_WORKER_BIT(ACQ_WORKER_HUMIDITY))!=0) && snapshot->ambient_temp_valid )
+    {
+        WeightCalibration_setTemperature( snapshot->ambient_temp );
+    }
+    Acquisition_record( &acq_cycle_stats, time_us_32() - start );
+    return ( (waiting & ~done)==0 );
+}
+
+// Name of a worker
+const char *Acquisition_name( int worker )
+{
+    if ( (worker>=0) && (worker<ACQ_WORKERS) )
+    {
+        return acq_workers[worker].name;
+    }
+    return ( worker==ACQ_WORKERS ) ? "cycle" : "";
+}
+
+// Timing of a worker
+const AcqStats_t *Acquisition_stats( int worker )
+{
+    if ( (worker>=0) && (worker<ACQ_WORKERS) )
+    {
+        return &acq_workers[worker].stats;
+    }
+    return ( worker==ACQ_WORKERS ) ? &acq_cycle_stats : NULL;
+}
+
+// Print the timing
+void Acquisition_show( void )
+{
+    const AcqStats_t    *stats;
+    uint32_t            sum_us;
+    int                 ii;
+
+    printf( "  worker   runs  missed    last     max    mean  (ms)\n" );
+    sum_us = 0;
+    for ( ii=0; ii<=ACQ_WORKERS; ii++ )
+    {
+        stats = Acquisition_stats( ii );
+        printf( "  %-7s  %4lu  %6lu  %6lu  %6lu  %6lu\n", Acquisition_name( ii ),
+                    (unsigned long)stats->runs, (unsigned long)stats->timeouts,
+                    (unsigned long)(stats->last_us / 1000), (unsigned long)(stats->max_us / 1000),
+                    (unsigned long)( (stats->runs==0) ? 0 : stats->total_us / stats->runs / 1000 ) );
+        if ( (ii<ACQ_WORKERS) && ((acq_last_run & ACQ_WORKER_BIT(ii))!=0) )
+        {
+            sum_us += stats->last_us;
+        }
+    }
+    printf( "  Last cycle %lu ms, its workers one after another %lu ms\n",
+                (unsigned long)(acq_cycle_stats.last_us / 1000), (unsigned long)(sum_us / 1000) );
+}
+
+// Console command
+void Acquisition_command( const char *args )
+{
+    int     ii;
+
+    if ( Console_match( &args, "show" ) )
+    {
+        Acquisition_show();
+    }
+    else if ( Console_match( &args, "clear" ) )
+    {
+        for ( ii=0; ii<ACQ_WORKERS; ii++ )
+        {
+            memset( &acq_workers[ii].stats, 0, sizeof(AcqStats_t) );
+        }
+        memset( &acq_cycle_stats, 0, sizeof(acq_cycle_stats) );
+    }
+    else
+    {
+        printf( "acq show | clear\n" );
+    }
+}
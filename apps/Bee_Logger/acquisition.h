@@ -0,0 +1,102 @@
+/*---------------------------------------------------------------------------
+
+    Acquisition
+        Reads every sensor bus at once, each with its own worker thread
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+
+#ifndef ACQUISITION_H
+#define ACQUISITION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fixed_point.h"
+#include "temperature_sensors.h"
+#include "weight_sensor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Macros
+
+// Workers - one for each independent bus
+#define ACQ_WORKER_SUPPLY       0           // ADC
+#define ACQ_WORKER_HUMIDITY     1           // HTU21D on I2C
+#define ACQ_WORKER_WEIGHT       2           // HX711
+#define ACQ_WORKER_ONE_WIRE     3           // first of TEMP_BUS_COUNT
+#define ACQ_WORKERS             (ACQ_WORKER_ONE_WIRE + TEMP_BUS_COUNT)
+#define ACQ_WORKER_BIT(w)       (1u << (w))
+#define ACQ_ONE_WIRE_WORKERS    (((1u << TEMP_BUS_COUNT) - 1) << ACQ_WORKER_ONE_WIRE)
+#define ACQ_ALL_WORKERS         ((1u << ACQ_WORKERS) - 1)
+
+// Types
+
+// The latest readings of every bus
+typedef struct
+{
+    uint32_t        updated;                // ACQ_WORKER_BIT of each worker that read at the last run
+
+    // ADC
+    bool            supply_valid;
+    uint16_t        supply_reading;         // counts x 16
+    milli_t         pin_voltage;            // V (x 1000)
+    milli_t         supply_voltage;
+    bool            chip_temp_valid;
+    milli_t         chip_temp;              // C (x 1000)
+
+    // HTU21D
+    bool            ambient_temp_valid;
+    milli_t         ambient_temp;           // C (x 1000)
+    bool            humidity_valid;
+    milli_t         humidity;               // % (x 1000)
+
+    // HX711
+    bool            weight_valid;
+    WeightWindow_t  weight;
+
+    // 1-Wire, indexed by sensor_id-1
+    int             temperature_count;
+    bool            temperatures_valid[SENSORS_MAX];
+    milli_t         temperatures[SENSORS_MAX];  // C (x 1000)
+} AcqSnapshot_t;
+
+// Timing of a worker, or of the whole cycle
+typedef struct
+{
+    uint32_t        runs;
+    uint32_t        timeouts;               // cycles it missed
+    uint32_t        last_us;
+    uint32_t        max_us;
+    uint64_t        total_us;               // for the mean
+} AcqStats_t;
+
+// Functions
+
+// Start the workers - the sensors must have been initialised
+void Acquisition_init( void );
+
+// Run the workers given (ACQ_WORKER_BIT of each), and wait for them all to finish
+//  The snapshot has their new readings, and the latest of the others
+//  A worker that has not finished by the cycle timeout has its readings
+//  marked invalid, and is waited for again at its next run
+//  Returns false if any worker timed out
+bool Acquisition_run( uint32_t workers, AcqSnapshot_t *snapshot );
+
+// Name and timing of a worker (0..ACQ_WORKERS-1), or of the cycle (ACQ_WORKERS)
+const char *Acquisition_name( int worker );
+const AcqStats_t *Acquisition_stats( int worker );
+
+// Print the timing of every worker
+void Acquisition_show( void );
+
+// Console command handler - "acq show|clear"
+void Acquisition_command( const char *args );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // ACQUISITION_H
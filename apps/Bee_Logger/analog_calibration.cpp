@@ -0,0 +1,346 @@
+/*---------------------------------------------------------------------------
+
+    Analog Calibration
+        ADC linearity correction and supply divider calibration
+
+    clayton@isnotcrazy.com
+
+    The RP2040 ADC has four wide codes (512, 1536, 2560 and 3584) which
+    show as DNL spikes of about 8 LSB, so the codes between them are a
+    little narrow and the INL is a sawtooth.  Each raw code is mapped to
+    the centre of the input range it really covers, in counts x 16.  The
+    table is generated by the compiler from the spike positions, and
+    AnalogChannel_read corrects each sample with a single lookup.
+
+    The supply divider is a straight line, so two points at known supply
+    voltages give its gain and offset, replacing the measured constants.
+    A single point just moves the offset.
+
+---------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flash_store.h"
+#include "console.h"
+#include "analog_channel.h"
+#include "supply_voltage.h"
+#include "analog_calibration.h"
+
+// Macros
+
+#define ANALOG_CAL_VERSION      1
+
+#define ANALOG_CODES            4096        // 12 bit ADC
+#define ANALOG_DNL_SPIKE        8.0         // extra width of each wide code, LSB
+#define ANALOG_CAL_GAIN_BITS    24          // fraction bits on the gain, beyond those of Voltage
+
+// Defaults, used until a calibration has been stored
+// Vin to ADC pin = 200k
+// ADC to GND = 22k
+// however measurements give:
+//      Ratio = 9.728
+//      Vdiode = 0.804
+#define DIVIDER_RATIO           9.728
+#define DIODE_DROP              0.804
+
+// Internal temperature sensor - 0.706V at 27C, -1.721mV/C
+#define CHIP_TEMP_SAMPLES       1024
+#define CHIP_TEMP_VBE           0.706
+#define CHIP_TEMP_SLOPE         -0.001721
+
+// default gain and offset, folded to fixed point at compile time
+static constexpr int32_t analog_default_gain = (int32_t)( ANALOG_VREF / ANALOG_FULL_SCALE * DIVIDER_RATIO *
+                                                    (1 << Voltage::frac_bits) * (1 << ANALOG_CAL_GAIN_BITS) + 0.5 );
+static constexpr int64_t analog_default_offset = (int64_t)( DIODE_DROP * (1 << Voltage::frac_bits) + 0.5 ) << ANALOG_CAL_GAIN_BITS;
+
+static constexpr Linear<Temperature> chip_temp_scale( ANALOG_VREF / ANALOG_FULL_SCALE / CHIP_TEMP_SLOPE,
+                                                      27.0 - CHIP_TEMP_VBE / CHIP_TEMP_SLOPE );
+
+// Types
+
+typedef struct
+{
+    uint16_t    value[ANALOG_CODES];
+} AnalogLinearity_t;
+
+typedef struct
+{
+    int32_t     gain;           // Voltage per reading count, with ANALOG_CAL_GAIN_BITS extra fraction bits
+    int64_t     offset;         // Voltage, with ANALOG_CAL_GAIN_BITS extra fraction bits
+} AnalogDivider_t;
+
+// Linearity Table
+
+static constexpr bool AnalogCalibration_isSpike( int code )
+{
+    return ( (code % 1024)==512 );
+}
+
+// Code centres, with the spikes' extra width taken evenly from the other codes
+static constexpr AnalogLinearity_t AnalogCalibration_makeLinearity( void )
+{
+    AnalogLinearity_t   table = {};
+    double              narrow = 1.0 - 4 * ANALOG_DNL_SPIKE / ( ANALOG_CODES - 4 );
+    double              start = -0.5;
+    double              width = 0.0;
+    double              centre = 0.0;
+
+    for ( int code=0; code<ANALOG_CODES; code++ )
+    {
+        width = AnalogCalibration_isSpike( code ) ? 1.0 + ANALOG_DNL_SPIKE : narrow;
+        centre = start + width / 2;
+        start += width;
+        centre = ( centre<0.0 ) ? 0.0 : ( centre>ANALOG_CODES-1 ) ? ANALOG_CODES-1 : centre;
+        table.value[code] = (uint16_t)( centre * (1 << ANALOG_FRACTION_BITS) + 0.5 );
+    }
+    return table;
+}
+
+static constexpr AnalogLinearity_t analog_linearity = AnalogCalibration_makeLinearity();
+
+static_assert( analog_linearity.value[0]==0, "linearity table must start at zero" );
+static_assert( analog_linearity.value[ANALOG_CODES-1]==(ANALOG_CODES-1) << ANALOG_FRACTION_BITS,
+               "linearity table must end at full scale" );
+
+// Data
+
+static AnalogCalibration_t  analog_calibration;
+static AnalogDivider_t      analog_divider = { analog_default_gain, analog_default_offset };
+
+// Private Functions
+
+// V (x 1000) to Voltage, with the extra gain bits
+static int64_t AnalogCalibration_toVoltage( milli_t voltage )
+{
+    return ( (int64_t)voltage << (Voltage::frac_bits + ANALOG_CAL_GAIN_BITS) ) / 1000;
+}
+
+// Make a calibration the one in use
+static bool AnalogCalibration_use( const AnalogCalibration_t *calibration )
+{
+    const AnalogCalPoint_t  *points;
+    AnalogDivider_t         divider;
+    int64_t                 gain;
+
+    points = calibration->points;
+    divider.gain = analog_default_gain;
+    divider.offset = analog_default_offset;
+    if ( (calibration->count<0) || (calibration->count>ANALOG_CAL_POINTS_MAX) )
+    {
+        return false;
+    }
+    if ( calibration->count==2 )
+    {
+        if ( points[1].reading<=points[0].reading )
+        {
+            return false;
+        }
+        gain = ( AnalogCalibration_toVoltage( points[1].voltage ) - AnalogCalibration_toVoltage( points[0].voltage ) )
+                    / ( points[1].reading - points[0].reading );
+        if ( (gain<=0) || (gain>INT32_MAX) )
+        {   // points too close together, or the wrong way round
+            return false;
+        }
+        divider.gain = (int32_t)gain;
+    }
+    if ( calibration->count>=1 )
+    {
+        divider.offset = AnalogCalibration_toVoltage( points[0].voltage ) - (int64_t)points[0].reading * divider.gain;
+    }
+    analog_calibration = *calibration;
+    analog_divider = divider;
+    return true;
+}
+
+// Public Functions
+
+// Linearity correction table
+const uint16_t *AnalogCalibration_linearity( void )
+{
+    return analog_linearity.value;
+}
+
+// Load the stored calibration
+void AnalogCalibration_init( void )
+{
+    AnalogCalibration_t     stored;
+
+    if ( FlashStore_read( FLASH_STORE_ANALOG_CALIBRATION, &stored, sizeof(stored) ) &&
+         (stored.version==ANALOG_CAL_VERSION) && AnalogCalibration_use( &stored ) )
+    {
+        printf( "Supply calibration loaded - %ld points\n", (long)stored.count );
+    }
+    else
+    {
+        printf( "Supply calibration using defaults\n" );
+        AnalogCalibration_clear();
+    }
+}
+
+// Convert a reading
+Voltage AnalogCalibration_convert( uint16_t reading )
+{
+    int64_t     value;
+
+    value = (int64_t)reading * analog_divider.gain + analog_divider.offset;
+    return Voltage::from_raw( (int32_t)Voltage::round_shift( value, ANALOG_CAL_GAIN_BITS ) );
+}
+
+// Convert a reading to V (x 1000)
+milli_t AnalogCalibration_apply( uint16_t reading )
+{
+    return AnalogCalibration_convert( reading ).to_milli();
+}
+
+// Add a calibration point
+bool AnalogCalibration_addPoint( milli_t voltage )
+{
+    AnalogCalibration_t     calibration;
+    AnalogCalPoint_t        point;
+    uint16_t                reading;
+    milli_t                 pin_voltage;
+    milli_t                 supply_voltage;
+    int                     ii;
+    int                     nearest;
+
+    if ( !SupplyVoltage_read( &reading, &pin_voltage, &supply_voltage ) )
+    {
+        printf( "Supply calibration - no reading\n" );
+        return false;
+    }
+    point.reading = reading;
+    point.voltage = voltage;
+
+    // drop any point with the same voltage, and make room by dropping the nearest
+    calibration = analog_calibration;
+    for ( ii=0; ii<calibration.count; ii++ )
+    {
+        if ( calibration.points[ii].voltage==voltage )
+        {
+            break;
+        }
+    }
+    if ( (ii==calibration.count) && (calibration.count>=ANALOG_CAL_POINTS_MAX) )
+    {
+        nearest = 0;
+        for ( ii=1; ii<calibration.count; ii++ )
+        {
+            if ( abs( calibration.points[ii].reading - point.reading )<abs( calibration.points[nearest].reading - point.reading ) )
+            {
+                nearest = ii;
+            }
+        }
+        ii = nearest;
+    }
+    if ( ii<calibration.count )
+    {
+        memmove( &calibration.points[ii], &calibration.points[ii+1], (calibration.count-ii-1) * sizeof(AnalogCalPoint_t) );
+        calibration.count--;
+    }
+
+    // insert in reading order
+    for ( ii=calibration.count; (ii>0) && (calibration.points[ii-1].reading>point.reading); ii-- )
+    {
+        calibration.points[ii] = calibration.points[ii-1];
+    }
+    calibration.points[ii] = point;
+    calibration.count++;
+
+    if ( !AnalogCalibration_use( &calibration ) )
+    {
+        printf( "Supply calibration - point does not fit the other\n" );
+        return false;
+    }
+    printf( "Supply calibration - point " MILLI_FMT " V = %u\n", MILLI_ARGS(voltage), reading );
+    return true;
+}
+
+// Return to the defaults
+void AnalogCalibration_clear( void )
+{
+    AnalogCalibration_t     calibration;
+
+    memset( &calibration, 0, sizeof(calibration) );
+    calibration.version = ANALOG_CAL_VERSION;
+    AnalogCalibration_use( &calibration );
+}
+
+// Store the calibration
+bool AnalogCalibration_save( void )
+{
+    if ( !FlashStore_write( FLASH_STORE_ANALOG_CALIBRATION, &analog_calibration, sizeof(analog_calibration) ) )
+    {
+        printf( "Supply calibration - save failed\n" );
+        return false;
+    }
+    printf( "Supply calibration saved\n" );
+    return true;
+}
+
+// Read the internal temperature sensor
+bool AnalogCalibration_chipTemperature( milli_t *temperature )
+{
+    static bool     enabled;
+    uint16_t        reading;
+
+    if ( !enabled )
+    {
+        AnalogChannel_enable( ANALOG_TEMP_SENSOR );
+        enabled = true;
+    }
+    if ( !AnalogChannel_read( ANALOG_TEMP_SENSOR, CHIP_TEMP_SAMPLES, &reading ) )
+    {
+        return false;
+    }
+    *temperature = chip_temp_scale.apply( reading ).to_milli();
+    return true;
+}
+
+// Print the calibration
+void AnalogCalibration_show( void )
+{
+    int     ii;
+
+    printf( "Supply calibration - %ld points  0 = " MILLI_FMT " V  %u = " MILLI_FMT " V\n",
+                (long)analog_calibration.count, MILLI_ARGS(AnalogCalibration_apply( 0 )),
+                (unsigned)(ANALOG_FULL_SCALE-1), MILLI_ARGS(AnalogCalibration_apply( ANALOG_FULL_SCALE-1 )) );
+    for ( ii=0; ii<analog_calibration.count; ii++ )
+    {
+        printf( "  %ld = " MILLI_FMT " V\n", (long)analog_calibration.points[ii].reading,
+                    MILLI_ARGS(analog_calibration.points[ii].voltage) );
+    }
+}
+
+// Console command
+void AnalogCalibration_command( const char *args )
+{
+    milli_t     value;
+
+    if ( Console_match( &args, "show" ) )
+    {
+        AnalogCalibration_show();
+    }
+    else if ( Console_match( &args, "point" ) && Console_parseMilli( &args, &value ) )
+    {
+        AnalogCalibration_addPoint( value );
+    }
+    else if ( Console_match( &args, "clear" ) )
+    {
+        AnalogCalibration_clear();
+    }
+    else if ( Console_match( &args, "save" ) )
+    {
+        AnalogCalibration_save();
+    }
+    else if ( Console_match( &args, "temp" ) )
+    {
+        if ( AnalogCalibration_chipTemperature( &value ) )
+        {
+            printf( "Chip temperature " MILLI_FMT " C\n", MILLI_ARGS(value) );
+        }
+    }
+    else
+    {
+        printf( "adc show | point <V> | clear | save | temp\n" );
+    }
+}
@@ -0,0 +1,81 @@
+/*---------------------------------------------------------------------------
+
+    Analog Calibration
+        ADC linearity correction and supply divider calibration
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+
+#ifndef ANALOG_CALIBRATION_H
+#define ANALOG_CALIBRATION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fixed_point.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Macros
+
+#define ANALOG_CAL_POINTS_MAX   2           // two points fix the divider gain and offset
+
+// Types
+
+// A known supply voltage and the oversampled reading it gave
+typedef struct
+{
+    int32_t     reading;        // counts x 16, linearity corrected
+    milli_t     voltage;        // V (x 1000)
+} AnalogCalPoint_t;
+
+// Calibration as stored in flash
+typedef struct
+{
+    uint32_t            version;
+    int32_t             count;              // points in use, sorted by reading
+    AnalogCalPoint_t    points[ANALOG_CAL_POINTS_MAX];
+} AnalogCalibration_t;
+
+// Functions
+
+// Linearity correction for each raw 12 bit ADC code, in counts x 16
+//  The table is built at compile time, so correcting a sample is one lookup
+const uint16_t *AnalogCalibration_linearity( void );
+
+// Load the stored divider calibration, or the built in defaults if there is none
+void AnalogCalibration_init( void );
+
+// Convert an oversampled supply reading to the voltage before the divider, V (x 1000)
+milli_t AnalogCalibration_apply( uint16_t reading );
+
+// Capture the current supply reading as a calibration point of the given voltage
+//  A third point replaces the one with the nearest reading
+bool AnalogCalibration_addPoint( milli_t voltage );
+
+// Return to the built in divider constants (not saved until AnalogCalibration_save)
+void AnalogCalibration_clear( void );
+
+// Store the divider calibration in flash
+bool AnalogCalibration_save( void );
+
+// Read the RP2040's internal temperature sensor (ADC4), C (x 1000)
+bool AnalogCalibration_chipTemperature( milli_t *temperature );
+
+// Print the current calibration
+void AnalogCalibration_show( void );
+
+// Console command handler - "adc show|point <V>|clear|save|temp"
+void AnalogCalibration_command( const char *args );
+
+#ifdef __cplusplus
+}
+
+// Convert an oversampled supply reading to the voltage before the divider
+Voltage AnalogCalibration_convert( uint16_t reading );
+
+#endif
+
+#endif      // ANALOG_CALIBRATION_H
@@ -0,0 +1,122 @@
+/*---------------------------------------------------------------------------
+
+    Analog Channel
+        Oversampled ADC readings, captured by DMA
+
+    clayton@isnotcrazy.com
+
+    The ADC free runs into its FIFO, and DMA moves the samples to a
+    buffer, so a burst of thousands of samples needs no CPU until it is
+    summed.  Averaging N samples of the noisy 12 bit ADC gives about
+    log2(N)/2 extra bits, so 4096 samples (8ms) give ~14-16 effective bits.
+    Averaging cannot remove the ADC's DNL spikes, so each sample is looked
+    up in the linearity table (already in counts x 16) as it is summed.
+    The ADC is left in single conversion mode, so adc_read() still works.
+
+---------------------------------------------------------------------------*/
+#include <stdio.h>
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "pico/time.h"
+#include "cmsis_os2.h"
+#include "analog_channel.h"
+#include "analog_calibration.h"
+
+// Macros
+
+#define ADC_FIRST_PIN       26
+#define ADC_SAMPLE_US       2           // at the full 48MHz / 96 rate
+
+// Data
+
+static uint16_t         analog_buffer[ANALOG_SAMPLES_MAX];
+static int              analog_dma_channel = -1;
+static osMutexId_t      analog_mutex;
+
+// Public Functions
+
+// Initialise the ADC
+void AnalogChannel_init( void )
+{
+    if ( analog_dma_channel>=0 )
+    {   // already done
+        return;
+    }
+    adc_init();
+    analog_dma_channel = dma_claim_unused_channel( true );
+    analog_mutex = osMutexNew( NULL );
+}
+
+// Set up a channel
+void AnalogChannel_enable( int channel )
+{
+    if ( channel==ANALOG_TEMP_SENSOR )
+    {
+        adc_set_temp_sensor_enabled( true );
+    }
+    else if ( (channel>=0) && (channel<ANALOG_TEMP_SENSOR) )
+    {
+        adc_gpio_init( ADC_FIRST_PIN + channel );
+    }
+}
+
+// Oversampled reading
+bool AnalogChannel_read( int channel, int samples, uint16_t *reading )
+{
+    dma_channel_config  config;
+    const uint16_t      *linearity;
+    uint32_t            sum;
+    int                 ii;
+
+    if ( (channel<0) || (channel>=ANALOG_CHANNELS) || (samples<1) || (samples>ANALOG_SAMPLES_MAX) ||
+         (analog_dma_channel<0) )
+    {
+        return false;
+    }
+    if ( analog_mutex!=NULL )
+    {
+        osMutexAcquire( analog_mutex, osWaitForever );
+    }
+
+    // free run into the FIFO, a DMA request per sample, no error bit or shift
+    adc_select_input( channel );
+    adc_set_round_robin( 0 );
+    adc_set_clkdiv( 0 );
+    adc_fifo_setup( true, true, 1, false, false );
+    adc_fifo_drain();
+
+    config = dma_channel_get_default_config( analog_dma_channel );
+    channel_config_set_transfer_data_size( &config, DMA_SIZE_16 );
+    channel_config_set_read_increment( &config, false );
+    channel_config_set_write_increment( &config, true );
+    channel_config_set_dreq( &config, DREQ_ADC );
+    dma_channel_configure( analog_dma_channel, &config, analog_buffer, &adc_hw->fifo, samples, true );
+    adc_run( true );
+
+    // sleep through most of the capture
+    if ( osKernelGetState()==osKernelRunning )
+    {
+        osDelay( (uint32_t)(samples * ADC_SAMPLE_US) / 1000 );
+    }
+    dma_channel_wait_for_finish_blocking( analog_dma_channel );
+
+    // back to single conversions
+    adc_run( false );
+    adc_fifo_setup( false, false, 0, false, false );
+    adc_fifo_drain();
+
+    // correct and decimate - 4096 x 4095 x 16 still fits 32 bits
+    linearity = AnalogCalibration_linearity();
+    sum = 0;
+    for ( ii=0; ii<samples; ii++ )
+    {
+        sum += linearity[analog_buffer[ii] & 0x0FFF];
+    }
+    *reading = (uint16_t)((sum + (uint32_t)samples/2) / (uint32_t)samples);
+
+    if ( analog_mutex!=NULL )
+    {
+        osMutexRelease( analog_mutex );
+    }
+    return true;
+}
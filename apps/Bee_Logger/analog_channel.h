@@ -0,0 +1,50 @@
+/*---------------------------------------------------------------------------
+
+    Analog Channel
+        Oversampled ADC readings, captured by DMA
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+
+#ifndef ANALOG_CHANNEL_H
+#define ANALOG_CHANNEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Macros
+
+#define ANALOG_CHANNELS         5           // ADC0-3 on GP26-29, ADC4 the temperature sensor
+#define ANALOG_TEMP_SENSOR      4
+#define ANALOG_SAMPLES_MAX      4096        // 8ms at the full 500k samples/s
+
+// Readings are ADC counts x 16, full scale 65520
+#define ANALOG_FRACTION_BITS    4
+#define ANALOG_FULL_SCALE       (1 << (12 + ANALOG_FRACTION_BITS))
+
+// Measured reference (nominally 3.3V)
+#define ANALOG_VREF             3.33
+
+// Functions
+
+// Initialise the ADC and claim its DMA channel
+void AnalogChannel_init( void );
+
+// Set up a channel's pin (or the temperature sensor)
+void AnalogChannel_enable( int channel );
+
+// Average samples (up to ANALOG_SAMPLES_MAX) taken back to back, in counts x 16
+//  Each sample is corrected for the ADC's differential non-linearity
+//  The calling thread sleeps while the DMA fills the buffer
+bool AnalogChannel_read( int channel, int samples, uint16_t *reading );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // ANALOG_CHANNEL_H
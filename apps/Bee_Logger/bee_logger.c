@@ -22,12 +22,15 @@
 #include "timer.h"
 #include "Driver_WiFi.h"
 #include "hardware/watchdog.h"
-#include "hardware/adc.h"
 
 #include "mqtt_client.h"
 #include "temperature_sensors.h"
 #include "weight_sensor.h"
 #include "humidity_temp_sensors.h"
+#include "supply_voltage.h"
+#include "weight_calibration.h"
+#include "acquisition.h"
+#include "schedule.h"
 
 // ----------------------------------------------------------------------------------------------------
 //  MACROS
@@ -45,7 +48,35 @@
 #define ACCESS_ID       "beehive001"
 #define ACCESS_USER     "beekeeper1"
 
-#define ADC_PIN         28
+// Jobs - each sensor read at its own rate, on wall clock boundaries
+#define JOB_WEIGHT          0
+#define JOB_HIVE_TEMP       1
+#define JOB_AMBIENT         2
+#define JOB_SUPPLY          3
+#define JOB_PUBLISH         4
+#define JOBS                5
+
+#define WEIGHT_PERIOD_MS    1000        // watched for a swarm leaving
+#define HIVE_TEMP_PERIOD_MS 20000
+#define AMBIENT_PERIOD_MS   60000
+#define SUPPLY_PERIOD_MS    60000
+#define PUBLISH_PERIOD_MS   20000       // :00, :20, :40 past the minute
+
+// A weight change this big (kg x 1000) since the last publish is published at once
+#define SWARM_WEIGHT_CHANGE 500
+
+// ----------------------------------------------------------------------------------------------------
+//  TYPES
+// ----------------------------------------------------------------------------------------------------
+
+typedef struct
+{
+    const char  *name;
+    uint32_t    period_ms;
+    int         priority;
+    uint32_t    workers;            // acquisition workers read for the job
+    void        (*action)( void );  // then run, after the readings
+} AppJob_t;
 
 // ----------------------------------------------------------------------------------------------------
 //  DATA
@@ -61,6 +92,16 @@ static volatile uint32_t msec_counter = 0;
 
 // Wifi device
 extern ARM_DRIVER_WIFI Driver_WiFi1;
+static bool wifi_ready;
+
+// Latest readings, and the workers which have read since the last publish
+static AcqSnapshot_t app_snapshot;
+static uint32_t app_fresh;
+static int publish_count;
+
+// Weight at the last publish
+static bool published_weight_valid;
+static milli_t published_weight;
 
 // ----------------------------------------------------------------------------------------------------
 //  FUNCTIONS
@@ -70,9 +111,21 @@ extern ARM_DRIVER_WIFI Driver_WiFi1;
 static void set_clock_khz(void);
 static void app_main (void *argument);
 static void application( void );
+static void weight_check( void );
+static void publish( void );
 static bool socket_check( void );
 static bool socket_startup( void );
 
+// Jobs, indexed by JOB_xxx
+static const AppJob_t app_jobs[JOBS] =
+{
+    { "weight",  WEIGHT_PERIOD_MS,    3, ACQ_WORKER_BIT(ACQ_WORKER_WEIGHT),   weight_check },
+    { "hive",    HIVE_TEMP_PERIOD_MS, 2, ACQ_ONE_WIRE_WORKERS,                NULL },
+    { "ambient", AMBIENT_PERIOD_MS,   1, ACQ_WORKER_BIT(ACQ_WORKER_HUMIDITY), NULL },
+    { "supply",  SUPPLY_PERIOD_MS,    1, ACQ_WORKER_BIT(ACQ_WORKER_SUPPLY),   NULL },
+    { "publish", PUBLISH_PERIOD_MS,   0, 0,                                   publish },
+};
+
 // Timer
 static void repeating_timer_callback(void)
 {
@@ -168,36 +221,21 @@ static void app_main (void *argument)
 
 void application( void )
 {
-    double      voltage;
-    double      scaled_voltage;
-    bool        temperature1_valid;
-    double      temperature1;
-    bool        temperature2_valid;
-    double      temperature2;
-    bool        temperature3_valid;
-    double      temperature3;
-    bool        weight_valid;
-    double      weight;
-    bool        humidity_valid;
-    double      humidity;
-    bool        ambient_temp_valid;
-    double      ambient_temp;
-    bool        retb;
-    int         cycle_count;
-    bool        wifi_ready;
-    bool        wifi_state;
-    uint16_t    reading;
+    int         due[SCHEDULE_JOBS_MAX];
+    int         count;
+    int         job;
+    int         ii;
+    uint32_t    workers;
 
     printf( "ADC - Initialise\n" );
-    adc_init();
-    adc_gpio_init( ADC_PIN );
-    adc_select_input( ADC_PIN-26 );
+    SupplyVoltage_init();
     printf( "Temperature Sensor - Initialise\n" );
     TempSensor_init();
     printf( "Weight Sensor - Initialise\n" );
     WeightSensor_init();
     printf( "Humidity/Temperature Sensor - Initialise\n" );
     HumidityTempSensor_init();
+    Acquisition_init();
 
     watchdog_update();
 
@@ -208,192 +246,247 @@ void application( void )
 
     // main loop
     printf( "Start ...\n" );
-    cycle_count = 0;
-    osDelay( 2000 );
+    for ( job=0; job<JOBS; job++ )
+    {
+        Schedule_addJob( app_jobs[job].name, app_jobs[job].period_ms, 0, app_jobs[job].priority );
+    }
     watchdog_update();
     while ( 1 )
     {
-        if ( cycle_count!=0 )
-        {   // pause between recordings
-            printf( "Pause ...\n" );
-            watchdog_update();
-            osDelay( 2000 );
-            watchdog_update();
-            osDelay( 2000 );
-            watchdog_update();
-            osDelay( 2000 );
-            watchdog_update();
-            osDelay( 2000 );
-            watchdog_update();
-            osDelay( 2000 );
-            watchdog_update();
-            osDelay( 2000 );
-            watchdog_update();
-            osDelay( 2000 );
-            watchdog_update();
-            osDelay( 2000 );
-            watchdog_update();
-            osDelay( 2000 );
-            watchdog_update();
-            osDelay( 2000 );
-        }
+        // wait for the next jobs - those due together share one wake up
+        count = Schedule_next( due );
 
-        cycle_count++;
-        printf( "\n" );
-        printf( "***********************\n" );
-        printf( "Starting Cycle %d ...\n", cycle_count );
+        // read every bus they need at once
+        workers = 0;
+        for ( ii=0; ii<count; ii++ )
+        {
+            workers |= app_jobs[due[ii]].workers;
+        }
+        if ( workers!=0 )
+        {
+            Acquisition_run( workers, &app_snapshot );
+            app_fresh |= app_snapshot.updated;
+        }
         watchdog_update();
 
-        printf( "Check Wifi ...\n" );
-        wifi_state = socket_check();
-        if ( wifi_state )
-        {   // wifi ok
-            printf( "Wifi Ok\n" );
-        }
-        else
-        {   // no wifi
-            if ( wifi_ready )
+        // then their actions, highest priority first
+        for ( ii=0; ii<count; ii++ )
+        {
+            if ( app_jobs[due[ii]].action!=NULL )
             {
-                printf( "Wifi has been lost\n" );
-                wifi_ready = false;
-            }
-            wifi_ready = socket_startup();
-            if ( !wifi_ready )
-            {   // no wifi - abort cycle
-                continue;
+                app_jobs[due[ii]].action();
             }
         }
         watchdog_update();
+    }
+}
 
-        // Vin to ADC pin = 200k
-        // ADC to GND = 22k
-        //  Vref = 3.3V
-        // however measurements give:
-        //      Vref = 3.33
-        //      Ratio = 9.728
-        //      Vdiode = 0.804
-        printf( "Read Voltage ...\n" );
-        reading = adc_read();
-        voltage = reading * 3.33 / (1 << 12);
-        scaled_voltage = (voltage * 9.728) + 0.804;        // scale for resistors and diode-drop
-        printf( "  Reading %u   Voltage %.3f  Scaled-Voltage %.2f\n", reading, voltage, scaled_voltage );
-
-        printf( "Read Temperature 1 ...\n" );
-        temperature1_valid = TempSensor_read( SENSORS_T1, &temperature1 );
-        if ( !temperature1_valid )
-        {
-            printf( "ERROR - Temperature1 Read Failed\n" );
-        }
+//
+//  Publish at once if the weight has changed by a swarm
+//
+static void weight_check( void )
+{
+    milli_t     change;
 
-        printf( "Read Temperature 2 ...\n" );
-        temperature2_valid = TempSensor_read( SENSORS_T2, &temperature2 );
-        if ( !temperature2_valid )
+    if ( !app_snapshot.weight_valid || !published_weight_valid )
+    {
+        return;
+    }
+    change = app_snapshot.weight.value - published_weight;
+    if ( (change>=SWARM_WEIGHT_CHANGE) || (change<=-SWARM_WEIGHT_CHANGE) )
+    {
+        printf( "Weight changed by " MILLI_FMT " kg - publish now\n", MILLI_ARGS(change) );
+        Schedule_trigger( JOB_PUBLISH );
+        published_weight_valid = false;     // once, until the weight is published
+    }
+}
+
+//
+//  Publish the readings taken since the last publish
+//
+static void publish( void )
+{
+    bool        supply_valid;
+    bool        ambient_temp_valid;
+    bool        humidity_valid;
+    bool        weight_valid;
+    bool        temperature_valid;
+    bool        hive_fresh;
+    int         sensor;
+    int         cell;
+    char        key[16];
+    bool        retb;
+    bool        wifi_state;
+
+    publish_count++;
+    printf( "\n" );
+    printf( "***********************\n" );
+    printf( "Publish %d ...\n", publish_count );
+    watchdog_update();
+
+    printf( "Check Wifi ...\n" );
+    wifi_state = socket_check();
+    if ( wifi_state )
+    {   // wifi ok
+        printf( "Wifi Ok\n" );
+    }
+    else
+    {   // no wifi
+        if ( wifi_ready )
         {
-            printf( "ERROR - Temperature2 Read Failed\n" );
+            printf( "Wifi has been lost\n" );
+            wifi_ready = false;
+        }
+        wifi_ready = socket_startup();
+        if ( !wifi_ready )
+        {   // no wifi - keep the readings for the next publish
+            return;
         }
+    }
+    watchdog_update();
 
-        printf( "Read Temperature 3 ...\n" );
-        temperature3_valid = TempSensor_read( SENSORS_T3, &temperature3 );
-        if ( !temperature3_valid )
+    // only readings taken since the last publish
+    supply_valid = ( (app_fresh & ACQ_WORKER_BIT(ACQ_WORKER_SUPPLY))!=0 ) && app_snapshot.supply_valid;
+    ambient_temp_valid = ( (app_fresh & ACQ_WORKER_BIT(ACQ_WORKER_HUMIDITY))!=0 ) && app_snapshot.ambient_temp_valid;
+    humidity_valid = ( (app_fresh & ACQ_WORKER_BIT(ACQ_WORKER_HUMIDITY))!=0 ) && app_snapshot.humidity_valid;
+    weight_valid = ( (app_fresh & ACQ_WORKER_BIT(ACQ_WORKER_WEIGHT))!=0 ) && app_snapshot.weight_valid;
+    hive_fresh = ( (app_fresh & ACQ_ONE_WIRE_WORKERS)!=0 );
+
+    if ( supply_valid )
+    {
+        printf( "  Reading %u   Voltage " MILLI_FMT "  Scaled-Voltage " MILLI_FMT "\n", app_snapshot.supply_reading, 
+                    MILLI_ARGS(app_snapshot.pin_voltage), MILLI_ARGS(app_snapshot.supply_voltage) );
+        if ( app_snapshot.chip_temp_valid )
         {
-            printf( "ERROR - Temperature3 Read Failed\n" );
+            printf( "  Chip Temperature " MILLI_FMT " C\n", MILLI_ARGS(app_snapshot.chip_temp) );
         }
-        watchdog_update();
+    }
 
-        printf( "Read Weight ...\n" );
-        weight_valid = WeightSensor_read( 4, &weight );
-        if ( !weight_valid )
+    if ( (app_fresh & ACQ_WORKER_BIT(ACQ_WORKER_HUMIDITY))!=0 )
+    {
+        printf( "Ambient Temperature: " MILLI_FMT " C\n", MILLI_ARGS(app_snapshot.ambient_temp) );
+        if ( !ambient_temp_valid )
         {
-            printf( "ERROR - Weight Read Failed\n" );
+            printf( "ERROR - Ambient Temperature Read Failed\n" );
         }
-        watchdog_update();
-
-        printf( "Read Humidity ...\n" );
-        humidity_valid = HumidityTempSensor_read( HUMIDITY_SENSOR, &humidity );
-        printf( "Humidity: %.2f %%\n", humidity );
+        printf( "Humidity: " MILLI_FMT " %%\n", MILLI_ARGS(app_snapshot.humidity) );
         if ( !humidity_valid )
         {
             printf( "ERROR - Humidity Read Failed\n" );
         }
+    }
 
-        printf( "Read Ambient Temperature ...\n" );
-        ambient_temp_valid = HumidityTempSensor_read( TEMP_SENSOR, &ambient_temp );
-        printf( "Ambient Temperature: %.2f C\n", ambient_temp );
-        if ( !ambient_temp_valid )
+    temperature_valid = false;
+    for ( sensor=0; hive_fresh && (sensor<app_snapshot.temperature_count); sensor++ )
+    {
+        if ( app_snapshot.temperatures_valid[sensor] )
         {
-            printf( "ERROR - Ambient Temperature Read Failed\n" );
+            temperature_valid = true;
         }
-        watchdog_update();
+        else
+        {
+            printf( "ERROR - %s Read Failed\n", TempSensor_name( sensor+1 ) );
+        }
+    }
 
-        // test for data
-        if (    !temperature1_valid && 
-                !temperature2_valid && 
-                !temperature3_valid && 
-                !weight_valid && 
-                !humidity_valid && 
-                !ambient_temp_valid )
-        {   // no valid data - try again
-            continue;
+    if ( weight_valid )
+    {
+        printf( "Weight: " MILLI_FMT " kg  (%d of %d readings rejected)\n", MILLI_ARGS(app_snapshot.weight.value), 
+                    app_snapshot.weight.rejected, app_snapshot.weight.count );
+        for ( cell=0; (cell<WEIGHT_CELLS) && (WEIGHT_CELLS>1); cell++ )
+        {
+            printf( "  Cell %d: " MILLI_FMT " kg\n", cell+1, MILLI_ARGS(app_snapshot.weight.cell_value[cell]) );
         }
+    }
+    else if ( (app_fresh & ACQ_WORKER_BIT(ACQ_WORKER_WEIGHT))!=0 )
+    {
+        printf( "ERROR - Weight Read Failed\n" );
+    }
+    app_fresh = 0;
+    watchdog_update();
 
-        // MQTT operations
-        while ( 1 )
+    // test for data
+    if (    !temperature_valid && 
+            !weight_valid && 
+            !humidity_valid && 
+            !ambient_temp_valid )
+    {   // no valid data - wait for the next
+        printf( "No new readings\n" );
+        return;
+    }
+
+    // MQTT operations
+    while ( 1 )
+    {
+        retb = mqtt_connect( ACCESS_ID, ACCESS_USER ) ;
+        watchdog_update();
+        if ( !retb )
+            break;
+        if ( supply_valid )
         {
-            retb = mqtt_connect( ACCESS_ID, ACCESS_USER ) ;
-            watchdog_update();
-            if ( !retb )
-                break;
-            retb = mqtt_send_float( "Voltage1", voltage ) ;
+            retb = mqtt_send_milli( "Voltage1", app_snapshot.pin_voltage ) ;
             if ( !retb )
                 break;
-            watchdog_update();
-            if ( temperature1_valid )
-            {
-                retb = mqtt_send_float( "Temperature1", temperature1 ) ;
-                if ( !retb )
-                    break;
-            }
-            watchdog_update();
-            if ( temperature2_valid )
-            {
-                retb = mqtt_send_float( "Temperature2", temperature2 ) ;
-                if ( !retb )
-                    break;
-            }
-            watchdog_update();
-            if ( temperature3_valid )
-            {
-                retb = mqtt_send_float( "Temperature3", temperature3 ) ;
-                if ( !retb )
-                    break;
-            }
-            watchdog_update();
-            if ( weight_valid )
-            {
-                retb = mqtt_send_float( "Weight", weight ) ;
-                if ( !retb )
-                    break;
-            }
-            watchdog_update();
-            if ( humidity_valid )
+        }
+        watchdog_update();
+        for ( sensor=0; temperature_valid && (sensor<app_snapshot.temperature_count); sensor++ )
+        {
+            if ( app_snapshot.temperatures_valid[sensor] )
             {
-                retb = mqtt_send_float( "Humidity", humidity ) ;
+                retb = mqtt_send_milli( TempSensor_name( sensor+1 ), app_snapshot.temperatures[sensor] ) ;
                 if ( !retb )
                     break;
             }
             watchdog_update();
-            if ( ambient_temp_valid )
+        }
+        if ( !retb )
+            break;
+        if ( weight_valid )
+        {
+            retb = mqtt_send_milli( "Weight", app_snapshot.weight.value ) ;
+            if ( !retb )
+                break;
+            published_weight = app_snapshot.weight.value;
+            published_weight_valid = true;
+            retb = mqtt_send_milli( "WeightRejected", app_snapshot.weight.rejected*1000 ) ;
+            if ( !retb )
+                break;
+            for ( cell=0; (cell<WEIGHT_CELLS) && (WEIGHT_CELLS>1); cell++ )
             {
-                retb = mqtt_send_float( "AmbientTemperature", ambient_temp ) ;
+                snprintf( key, sizeof(key), "Weight%d", cell+1 );
+                retb = mqtt_send_milli( key, app_snapshot.weight.cell_value[cell] ) ;
                 if ( !retb )
                     break;
             }
-            watchdog_update();
-            break;
+            if ( !retb )
+                break;
+        }
+        watchdog_update();
+        if ( humidity_valid )
+        {
+            retb = mqtt_send_milli( "Humidity", app_snapshot.humidity ) ;
+            if ( !retb )
+                break;
+        }
+        watchdog_update();
+        if ( ambient_temp_valid )
+        {
+            retb = mqtt_send_milli( "AmbientTemperature", app_snapshot.ambient_temp ) ;
+            if ( !retb )
+                break;
         }
-        mqtt_disconnect();
         watchdog_update();
+        if ( supply_valid && app_snapshot.chip_temp_valid )
+        {
+            retb = mqtt_send_milli( "ChipTemperature", app_snapshot.chip_temp ) ;
+            if ( !retb )
+                break;
+        }
+        watchdog_update();
+        break;
     }
+    mqtt_disconnect();
+    watchdog_update();
 }
 
 //
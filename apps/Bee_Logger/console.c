@@ -0,0 +1,244 @@
+/*---------------------------------------------------------------------------
+
+    Console
+        Service commands typed on the USB serial port
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "console.h"
+#include "weight_sensor.h"
+#include "weight_calibration.h"
+#include "temperature_sensors.h"
+#include "analog_calibration.h"
+#include "acquisition.h"
+#include "schedule.h"
+
+// Macros
+
+#define CONSOLE_LINE_MAX    64
+
+// Types
+
+typedef struct
+{
+    const char  *name;
+    void        (*handler)( const char *args );
+} ConsoleCommand_t;
+
+// Data
+
+static const ConsoleCommand_t console_commands[] =
+{
+    { "weight", WeightSensor_command },
+    { "cal",    WeightCalibration_command },
+    { "temp",   TempSensor_command },
+    { "adc",    AnalogCalibration_command },
+    { "acq",    Acquisition_command },
+    { "sched",  Schedule_command },
+};
+
+static char     console_line[CONSOLE_LINE_MAX];
+static int      console_length;
+
+// Private Functions
+
+static void Console_skipSpaces( const char **text )
+{
+    while ( **text==' ' )
+    {
+        (*text)++;
+    }
+}
+
+// Run a command line
+static void Console_run( const char *line )
+{
+    int     ii;
+
+    Console_skipSpaces( &line );
+    if ( *line=='\0' )
+    {
+        return;
+    }
+    for ( ii=0; ii<(int)(sizeof(console_commands)/sizeof(console_commands[0])); ii++ )
+    {
+        if ( Console_match( &line, console_commands[ii].name ) )
+        {
+            console_commands[ii].handler( line );
+            return;
+        }
+    }
+    printf( "Commands:" );
+    for ( ii=0; ii<(int)(sizeof(console_commands)/sizeof(console_commands[0])); ii++ )
+    {
+        printf( " %s", console_commands[ii].name );
+    }
+    printf( "\n" );
+}
+
+// Public Functions
+
+// Process received characters
+void Console_poll( void )
+{
+    int     ch;
+
+    while ( (ch=getchar_timeout_us( 0 ))!=PICO_ERROR_TIMEOUT )
+    {
+        if ( (ch=='\r') || (ch=='\n') )
+        {
+            console_line[console_length] = '\0';
+            console_length = 0;
+            Console_run( console_line );
+        }
+        else if ( console_length<CONSOLE_LINE_MAX-1 )
+        {
+            console_line[console_length++] = (char)ch;
+        }
+    }
+}
+
+// Match the next word
+bool Console_match( const char **text, const char *word )
+{
+    size_t  length;
+
+    Console_skipSpaces( text );
+    length = strlen( word );
+    if ( (strncmp( *text, word, length )!=0) || (((*text)[length]!=' ') && ((*text)[length]!='\0')) )
+    {
+        return false;
+    }
+    *text += length;
+    return true;
+}
+
+// Parse a decimal number as thousandths - false if it does not fit in a milli_t
+bool Console_parseMilli( const char **text, milli_t *value )
+{
+    const char  *next;
+    bool        negative;
+    bool        digits;
+    int64_t     whole;
+    int64_t     milli;
+    int32_t     fraction;
+    int32_t     scale;
+
+    Console_skipSpaces( text );
+    next = *text;
+    negative = (*next=='-');
+    if ( negative || (*next=='+') )
+    {
+        next++;
+    }
+    digits = false;
+    whole = 0;
+    while ( (*next>='0') && (*next<='9') )
+    {
+        whole = whole*10 + (*next++ - '0');
+        digits = true;
+        if ( whole>INT32_MAX/1000 )
+        {   // too big
+            return false;
+        }
+    }
+    fraction = 0;
+    if ( *next=='.' )
+    {
+        next++;
+        for ( scale=100; (*next>='0') && (*next<='9'); next++, scale/=10 )
+        {
+            fraction += (*next - '0') * scale;
+            digits = true;
+        }
+    }
+    if ( !digits || ((*next!=' ') && (*next!='\0')) )
+    {
+        return false;
+    }
+    milli = whole*1000 + fraction;
+    if ( milli>INT32_MAX )
+    {
+        return false;
+    }
+    *value = (milli_t)( negative ? -milli : milli );
+    *text = next;
+    return true;
+}
+
+// Parse a whole number
+bool Console_parseInt( const char **text, int *value )
+{
+    const char  *start;
+    milli_t     milli;
+
+    start = *text;
+    if ( !Console_parseMilli( text, &milli ) )
+    {
+        return false;
+    }
+    if ( (milli % 1000)!=0 )
+    {   // not whole
+        *text = start;
+        return false;
+    }
+    *value = milli / 1000;
+    return true;
+}
+
+// Parse an unsigned whole number - false if it does not fit in 32 bits
+bool Console_parseUnsigned( const char **text, uint32_t *value )
+{
+    const char  *next;
+    uint64_t    whole;
+
+    Console_skipSpaces( text );
+    next = *text;
+    if ( *next=='+' )
+    {
+        next++;
+    }
+    if ( (*next<'0') || (*next>'9') )
+    {
+        return false;
+    }
+    whole = 0;
+    while ( (*next>='0') && (*next<='9') )
+    {
+        whole = whole*10 + (uint64_t)(*next++ - '0');
+        if ( whole>UINT32_MAX )
+        {   // too big
+            return false;
+        }
+    }
+    if ( (*next!=' ') && (*next!='\0') )
+    {
+        return false;
+    }
+    *value = (uint32_t)whole;
+    *text = next;
+    return true;
+}
+
+// Copy out the next word
+bool Console_word( const char **text, char *word, size_t size )
+{
+    size_t  length;
+
+    Console_skipSpaces( text );
+    for ( length=0; ((*text)[length]!=' ') && ((*text)[length]!='\0'); length++ )
+    {
+    }
+    if ( (length==0) || (length>=size) )
+    {
+        return false;
+    }
+    memcpy( word, *text, length );
+    word[length] = '\0';
+    *text += length;
+    return true;
+}
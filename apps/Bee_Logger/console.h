@@ -0,0 +1,49 @@
+/*---------------------------------------------------------------------------
+
+    Console
+        Service commands typed on the USB serial port
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "fixed_point.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Functions
+
+// Process any characters received, running each complete command line
+//  Never waits - call regularly from the application thread
+void Console_poll( void );
+
+// Match the next word of a command, and step past it
+bool Console_match( const char **text, const char *word );
+
+// Parse a decimal number (eg "-12.5") as thousandths, and step past it
+// False if it is out of range of a milli_t (+/-2147483.647)
+bool Console_parseMilli( const char **text, milli_t *value );
+
+// Parse a whole number, and step past it
+bool Console_parseInt( const char **text, int *value );
+
+// Parse an unsigned whole number (eg seconds since 1970), and step past it
+// False if it is out of range of a uint32_t
+bool Console_parseUnsigned( const char **text, uint32_t *value );
+
+// Copy out the next word (up to size-1 characters), and step past it
+bool Console_word( const char **text, char *word, size_t size );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // CONSOLE_H
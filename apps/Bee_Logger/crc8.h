@@ -0,0 +1,97 @@
+/*---------------------------------------------------------------------------
+
+    CRC8
+        Table driven 8 bit CRCs for the sensor protocols
+
+    clayton@isnotcrazy.com
+
+    Crc8<Poly, Reflected> builds its lookup table at compile time, so the
+    table sits in flash and each byte costs one lookup rather than eight
+    shift and test steps.  Builds short of flash can define
+    CRC8_NIBBLE_TABLE to use a 16 entry table instead, at two lookups
+    per byte.
+
+    Reflected CRCs shift LSB first (Dallas/Maxim 1-Wire); the others shift
+    MSB first (HTU21D).
+
+---------------------------------------------------------------------------*/
+
+#ifndef CRC8_H
+#define CRC8_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+template <uint8_t Poly, bool Reflected>
+class Crc8 {
+public:
+	static uint8_t update(uint8_t crc, uint8_t byte) {
+#ifdef CRC8_NIBBLE_TABLE
+		crc ^= byte;
+		if constexpr (Reflected) {
+			crc = (uint8_t) ((crc >> 4) ^ _table.entry[crc & 0x0F]);
+			return (uint8_t) ((crc >> 4) ^ _table.entry[crc & 0x0F]);
+		} else {
+			crc = (uint8_t) ((crc << 4) ^ _table.entry[crc >> 4]);
+			return (uint8_t) ((crc << 4) ^ _table.entry[crc >> 4]);
+		}
+#else
+		return _table.entry[crc ^ byte];
+#endif
+	}
+
+	static uint8_t compute(const uint8_t *data, size_t length, uint8_t crc = 0) {
+		for (size_t i = 0; i < length; i++) {
+			crc = update(crc, data[i]);
+		}
+		return crc;
+	}
+
+private:
+#ifdef CRC8_NIBBLE_TABLE
+	static constexpr int table_bits = 4;
+#else
+	static constexpr int table_bits = 8;
+#endif
+
+	struct Table {
+		uint8_t entry[1 << table_bits];
+	};
+
+	// CRC of each index, shifted through table_bits bits
+	static constexpr Table make_table() {
+		Table table{};
+		for (int index = 0; index < (1 << table_bits); index++) {
+			uint8_t crc = Reflected ? (uint8_t) index : (uint8_t) (index << (8 - table_bits));
+			for (int bit = 0; bit < table_bits; bit++) {
+				if constexpr (Reflected) {
+					crc = (uint8_t) ((crc & 0x01) ? ((crc >> 1) ^ reflect(Poly)) : (crc >> 1));
+				} else {
+					crc = (uint8_t) ((crc & 0x80) ? ((crc << 1) ^ Poly) : (crc << 1));
+				}
+			}
+			table.entry[index] = crc;
+		}
+		return table;
+	}
+
+	static constexpr uint8_t reflect(uint8_t value) {
+		uint8_t result = 0;
+		for (int bit = 0; bit < 8; bit++) {
+			if (value & (1 << bit)) {
+				result = (uint8_t) (result | (0x80 >> bit));
+			}
+		}
+		return result;
+	}
+
+	static constexpr Table _table = make_table();
+};
+
+// Dallas/Maxim 1-Wire ROM and scratchpad CRC: x^8 + x^5 + x^4 + 1, LSB first
+using Crc8_maxim = Crc8<0x31, true>;
+
+// HTU21D measurement CRC: x^8 + x^5 + x^4 + 1, MSB first
+using Crc8_htu21d = Crc8<0x31, false>;
+
+#endif      // CRC8_H
@@ -0,0 +1,149 @@
+/*---------------------------------------------------------------------------
+
+    Fixed Point
+        Fixed point sensor values, as the RP2040 has no FPU
+
+    clayton@isnotcrazy.com
+
+    C++ code uses Fixed<Q,Unit>, a 32 bit value with Q fraction bits
+    tagged with its unit, so values in different units or formats cannot
+    be mixed by mistake.  Conversions from raw sensor counts use Linear,
+    whose double constants are folded to integers at compile time, so no
+    floating point is done at run time.
+
+    C code is handed values in thousandths of the unit (milli_t).
+
+---------------------------------------------------------------------------*/
+
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <stdint.h>
+
+// Value in thousandths of its unit, as passed to C code
+typedef int32_t milli_t;
+
+// printf support for milli_t - printf( "V=" MILLI_FMT "\n", MILLI_ARGS(value) )
+#define MILLI_FMT           "%s%ld.%03ld"
+#define MILLI_ARGS(v)       ((v)<0 ? "-" : ""), (long)(((v)<0 ? -(v) : (v))/1000), (long)(((v)<0 ? -(v) : (v))%1000)
+
+#ifdef __cplusplus
+
+// Units
+struct Celsius {};
+struct Percent {};
+struct Kilogram {};
+struct Volt {};
+
+template <int Q, typename Unit>
+class Fixed {
+	static_assert(Q >= 0 && Q <= 24, "Fixed needs 0..24 fraction bits");
+
+public:
+	static constexpr int frac_bits = Q;
+	using unit = Unit;
+
+	constexpr Fixed() : _raw(0) {}
+
+	static constexpr Fixed from_raw(int32_t raw) {
+		Fixed value;
+		value._raw = raw;
+		return value;
+	}
+
+	// only for constants - evaluated by the compiler
+	static constexpr Fixed from_double(double value) {
+		return from_raw((int32_t) (value * (1 << Q) + (value < 0 ? -0.5 : 0.5)));
+	}
+
+	constexpr int32_t raw() const { return _raw; }
+
+	// rounded to the nearest thousandth
+	constexpr milli_t to_milli() const {
+		return (milli_t) round_shift((int64_t) _raw * 1000, Q);
+	}
+
+	template <int Q2>
+	constexpr Fixed<Q2, Unit> convert() const {
+		if constexpr (Q2 >= Q) {
+			return Fixed<Q2, Unit>::from_raw(_raw * (1 << (Q2 - Q)));
+		} else {
+			return Fixed<Q2, Unit>::from_raw((int32_t) round_shift(_raw, Q - Q2));
+		}
+	}
+
+	constexpr Fixed operator+(Fixed other) const { return from_raw(_raw + other._raw); }
+	constexpr Fixed operator-(Fixed other) const { return from_raw(_raw - other._raw); }
+	constexpr Fixed operator-() const { return from_raw(-_raw); }
+	constexpr bool operator<(Fixed other) const { return _raw < other._raw; }
+	constexpr bool operator>(Fixed other) const { return _raw > other._raw; }
+	constexpr bool operator<=(Fixed other) const { return _raw <= other._raw; }
+	constexpr bool operator>=(Fixed other) const { return _raw >= other._raw; }
+	constexpr bool operator==(Fixed other) const { return _raw == other._raw; }
+	constexpr bool operator!=(Fixed other) const { return _raw != other._raw; }
+
+	static constexpr int64_t round_shift(int64_t value, int shift) {
+		return (shift == 0) ? value : ((value + ((int64_t) 1 << (shift - 1))) >> shift);
+	}
+
+private:
+	int32_t _raw;
+};
+
+// Value types used by the sensors
+using Temperature = Fixed<8, Celsius>;
+using Humidity = Fixed<8, Percent>;
+using Weight = Fixed<16, Kilogram>;
+using Voltage = Fixed<16, Volt>;
+
+/**
+ * Linear conversion from raw counts: value = counts * scale + offset
+ *
+ * The scale is held with as many fraction bits as fit in 32 bits, so
+ * declaring the conversion constexpr folds it to two integers and a shift.
+ */
+template <typename Out>
+class Linear {
+public:
+	constexpr Linear(double scale, double offset)
+			: _shift(shift_for(scale)),
+			  _scale((int32_t) round_double(scale * pow2(Out::frac_bits + _shift))),
+			  _offset(round_double(offset * pow2(Out::frac_bits + _shift)) +
+					  ((_shift > 0) ? ((int64_t) 1 << (_shift - 1)) : 0)) {
+	}
+
+	constexpr Out apply(int32_t counts) const {
+		return Out::from_raw((int32_t) (((int64_t) counts * _scale + _offset) >> _shift));
+	}
+
+private:
+	int _shift;
+	int32_t _scale;
+	int64_t _offset;
+
+	static constexpr double pow2(int bits) {
+		double value = 1.0;
+		for (int i = 0; i < bits; i++) {
+			value *= 2.0;
+		}
+		return value;
+	}
+
+	static constexpr int64_t round_double(double value) {
+		return (int64_t) (value + (value < 0 ? -0.5 : 0.5));
+	}
+
+	// extra scale bits, keeping the scaled constant within 31 bits
+	static constexpr int shift_for(double scale) {
+		double magnitude = (scale < 0) ? -scale : scale;
+		int shift = 0;
+		while (shift < 30 && magnitude * pow2(Out::frac_bits + shift + 1) < 2147483647.0) {
+			shift++;
+		}
+		return shift;
+	}
+};
+
+#endif      // __cplusplus
+
+#endif      // FIXED_POINT_H
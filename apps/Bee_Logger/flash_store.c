@@ -0,0 +1,133 @@
+/*---------------------------------------------------------------------------
+
+    Flash Store
+        Small settings records kept in reserved sectors at the top of flash
+
+    clayton@isnotcrazy.com
+
+    Each slot is one erase sector, holding a header (magic, size, checksum)
+    followed by the record.  The program image must stay clear of the
+    top FLASH_STORE_SLOTS sectors.
+
+    Nothing may run from flash while it is written, so if core1 is running
+    it is parked (in RAM) by the multicore lockout for the duration.
+
+---------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "pico/multicore.h"
+#include "flash_store.h"
+
+// Macros
+
+#define FLASH_STORE_MAGIC       0x42454531          // "BEE1"
+
+// Types
+
+typedef struct
+{
+    uint32_t    magic;
+    uint32_t    size;
+    uint32_t    checksum;
+    uint32_t    reserved;
+} FlashStoreHeader_t;
+
+// Data
+
+// sector image being programmed (flash is written in whole pages)
+static uint8_t  flash_store_buffer[FLASH_SECTOR_SIZE];
+
+// Private Functions
+
+// flash offset of a slot's sector
+static uint32_t FlashStore_offset( int slot )
+{
+    return PICO_FLASH_SIZE_BYTES - (uint32_t)(slot+1) * FLASH_SECTOR_SIZE;
+}
+
+// FNV-1a hash of the record
+static uint32_t FlashStore_checksum( const uint8_t *data, size_t size )
+{
+    uint32_t    hash;
+    size_t      ii;
+
+    hash = 2166136261u;
+    for ( ii=0; ii<size; ii++ )
+    {
+        hash = (hash ^ data[ii]) * 16777619u;
+    }
+    return hash;
+}
+
+// Public Functions
+
+// Read a record
+bool FlashStore_read( int slot, void *data, size_t size )
+{
+    const FlashStoreHeader_t    *header;
+    const uint8_t               *record;
+
+    if ( (slot<0) || (slot>=FLASH_STORE_SLOTS) || (size>FLASH_STORE_MAX_SIZE) )
+    {
+        return false;
+    }
+    // flash is memory mapped
+    header = (const FlashStoreHeader_t *)( XIP_BASE + FlashStore_offset( slot ) );
+    record = (const uint8_t *)( header + 1 );
+    if ( (header->magic!=FLASH_STORE_MAGIC) || (header->size!=size) )
+    {
+        return false;
+    }
+    if ( header->checksum!=FlashStore_checksum( record, size ) )
+    {
+        printf( "Flash store slot %d is corrupt\n", slot );
+        return false;
+    }
+    memcpy( data, record, size );
+    return true;
+}
+
+// Write a record
+bool FlashStore_write( int slot, const void *data, size_t size )
+{
+    FlashStoreHeader_t  *header;
+    uint32_t            offset;
+    uint32_t            length;
+    uint32_t            interrupts;
+    bool                core1;
+
+    if ( (slot<0) || (slot>=FLASH_STORE_SLOTS) || (size>FLASH_STORE_MAX_SIZE) )
+    {
+        return false;
+    }
+    memset( flash_store_buffer, 0xFF, sizeof(flash_store_buffer) );
+    header = (FlashStoreHeader_t *)flash_store_buffer;
+    header->magic = FLASH_STORE_MAGIC;
+    header->size = size;
+    header->checksum = FlashStore_checksum( data, size );
+    header->reserved = 0;
+    memcpy( header+1, data, size );
+
+    // round up to whole pages
+    length = ( (sizeof(FlashStoreHeader_t) + size + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE ) * FLASH_PAGE_SIZE;
+    offset = FlashStore_offset( slot );
+
+    // nothing may run from flash while it is being written
+    core1 = multicore_lockout_victim_is_initialized( 1 );
+    if ( core1 )
+    {
+        multicore_lockout_start_blocking();
+    }
+    interrupts = save_and_disable_interrupts();
+    flash_range_erase( offset, FLASH_SECTOR_SIZE );
+    flash_range_program( offset, flash_store_buffer, length );
+    restore_interrupts( interrupts );
+    if ( core1 )
+    {
+        multicore_lockout_end_blocking();
+    }
+
+    return FlashStore_read( slot, flash_store_buffer, size );
+}
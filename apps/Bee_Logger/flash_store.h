@@ -0,0 +1,43 @@
+/*---------------------------------------------------------------------------
+
+    Flash Store
+        Small settings records kept in reserved sectors at the top of flash
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+
+#ifndef FLASH_STORE_H
+#define FLASH_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Record slots - each has its own flash sector, counting down from the top of flash
+#define FLASH_STORE_WEIGHT_CALIBRATION      0
+#define FLASH_STORE_TEMP_INVENTORY          1
+#define FLASH_STORE_ANALOG_CALIBRATION      2
+#define FLASH_STORE_SLOTS                   3
+
+// Largest record (one sector, less the header)
+#define FLASH_STORE_MAX_SIZE                (4096 - 16)
+
+// Functions
+
+// Read a record - false if the slot is empty, corrupt, or a different size
+bool FlashStore_read( int slot, void *data, size_t size );
+
+// Write a record, replacing any previous one in the slot
+//  Interrupts are disabled while the sector is erased and programmed
+bool FlashStore_write( int slot, const void *data, size_t size );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // FLASH_STORE_H
@@ -20,19 +20,57 @@
 // Data
 static HTU21D myHumidity;
 
+// User register settings for each HUMIDITY_RES_...
+static const uint8_t humidity_resolutions[] =
+{
+    USER_REGISTER_RESOLUTION_RH12_TEMP14,
+    USER_REGISTER_RESOLUTION_RH8_TEMP12,
+    USER_REGISTER_RESOLUTION_RH10_TEMP13,
+    USER_REGISTER_RESOLUTION_RH11_TEMP11
+};
+
 // Initialise the sensor
 void HumidityTempSensor_init( void )
 {
     myHumidity.begin( HTU21D_IC2_PORT, HTU21D_SDA_PIN, HTU21D_SCL_PIN );
 }
 
+// Set the resolution
+bool HumidityTempSensor_setResolution( int resolution )
+{
+    if ( (resolution<0) || (resolution>=(int)sizeof(humidity_resolutions)) )
+    {
+        return false;
+    }
+    return myHumidity.setResolution( humidity_resolutions[resolution] );
+}
+
+// Start a measurement
+bool HumidityTempSensor_start( int sensor_id )
+{
+    if ( sensor_id==HUMIDITY_SENSOR )
+    {
+        return myHumidity.startHumidity();
+    }
+    return myHumidity.startTemperature();
+}
+
 // Read a sensor
-bool HumidityTempSensor_read( int sensor_id, double *result )
+bool HumidityTempSensor_read( int sensor_id, milli_t *result )
 {
-    bool retb;
+    bool        retb;
+    Humidity    humidity;
+    Temperature temperature;
+
     if ( sensor_id==HUMIDITY_SENSOR )
-        retb = myHumidity.readHumidity( result );
+    {
+        retb = myHumidity.readHumidity( &humidity );
+        *result = humidity.to_milli();
+    }
     else
-        retb = myHumidity.readTemperature( result );
+    {
+        retb = myHumidity.readTemperature( &temperature );
+        *result = temperature.to_milli();
+    }
   return retb;
 }
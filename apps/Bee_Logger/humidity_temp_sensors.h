@@ -11,6 +11,7 @@
 #define HUMIDITY_TEMP_SENSORS_H
 
 #include <stdbool.h>
+#include "fixed_point.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,13 +21,27 @@ extern "C" {
 #define HUMIDITY_SENSOR     1
 #define TEMP_SENSOR         2
 
+// Resolutions - humidity and temperature bits, with the longest conversion times
+#define HUMIDITY_RES_RH12_T14       0       // 16ms / 50ms (power on default)
+#define HUMIDITY_RES_RH8_T12        1       //  3ms / 13ms
+#define HUMIDITY_RES_RH10_T13       2       //  5ms / 25ms
+#define HUMIDITY_RES_RH11_T11       3       //  8ms /  7ms
+
 // Functions
 
 // Initialise the sensor
 void HumidityTempSensor_init( void );
 
-// Read a sensor
-bool HumidityTempSensor_read( int sensor_id, double *result );
+// Set the resolution of both measurements (HUMIDITY_RES_...)
+bool HumidityTempSensor_setResolution( int resolution );
+
+// Start a measurement, so that other work can be done while it converts
+//  Only one can be in progress at a time
+bool HumidityTempSensor_start( int sensor_id );
+
+// Read a sensor, producing a result in % or C (x 1000)
+//  Collects the measurement started, or starts one and waits for it
+bool HumidityTempSensor_read( int sensor_id, milli_t *result );
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,277 @@
+/*---------------------------------------------------------------------------
+
+    I2C Bus
+        Shared I2C0/I2C1 buses, with queued DMA transactions
+
+    clayton@isnotcrazy.com
+
+    Drivers on the same bus do not lock it.  They post their transactions
+    to the bus's message queue, and a thread for each bus runs them in
+    turn.  The bytes to send and the read commands are fed to the I2C
+    block by one DMA channel and the bytes read are taken by another,
+    so the bus thread just sleeps until the STOP (or an abort) raises
+    the I2C interrupt.
+
+---------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "hardware/i2c.h"
+#include "hardware/gpio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "i2c_bus.h"
+
+// Macros
+
+#define I2C_BUS_QUEUE_SIZE      8           // transactions waiting on each bus
+#define I2C_BUS_DONE_FLAG       0x0001      // event flag set by the I2C interrupt
+#define I2C_BUS_TIMEOUT_MS      20          // longest transaction, with clock stretching
+#define I2C_BUS_STACK_SIZE      1024U       // printf, and the completion callbacks
+
+// Types
+
+typedef struct
+{
+    i2c_inst_t          *i2c;
+    osMessageQueueId_t  queue;              // of I2cTransaction_t pointers
+    osEventFlagsId_t    events;
+    int                 tx_channel;
+    int                 rx_channel;
+    uint16_t            commands[I2C_BUS_TRANSFER_MAX];     // DATA_CMD words of the transaction running
+} I2cBus_t;
+
+// Data
+
+static const osThreadAttr_t i2c_bus_attr =
+{
+    .name = "i2c",
+    .stack_size = I2C_BUS_STACK_SIZE,
+    .priority = osPriorityAboveNormal
+};
+
+static I2cBus_t     i2c_buses[I2C_BUS_COUNT];
+
+// Private Functions
+
+// STOP detected or transfer aborted - wake the bus thread
+static void I2cBus_irq( I2cBus_t *bus )
+{
+    i2c_get_hw( bus->i2c )->intr_mask = 0;
+    osEventFlagsSet( bus->events, I2C_BUS_DONE_FLAG );
+}
+
+static void I2cBus_irq0( void )
+{
+    I2cBus_irq( &i2c_buses[0] );
+}
+
+static void I2cBus_irq1( void )
+{
+    I2cBus_irq( &i2c_buses[1] );
+}
+
+// Run one transaction
+static I2cStatus_t I2cBus_execute( I2cBus_t *bus, I2cTransaction_t *transaction )
+{
+    i2c_hw_t            *hw;
+    dma_channel_config  config;
+    uint32_t            flags;
+    uint32_t            abort_source;
+    int                 count;
+    int                 ii;
+
+    hw = i2c_get_hw( bus->i2c );
+    count = transaction->tx_len + transaction->rx_len;
+    if ( (count==0) || (count>I2C_BUS_TRANSFER_MAX) || (transaction->address>0x7F) )
+    {
+        return I2C_BUS_ERROR;
+    }
+
+    // bytes to write, then a read command for each byte to read, with a
+    // repeated start between them and a stop after the last
+    count = 0;
+    for ( ii=0; ii<transaction->tx_len; ii++ )
+    {
+        bus->commands[count++] = transaction->tx[ii];
+    }
+    for ( ii=0; ii<transaction->rx_len; ii++ )
+    {
+        bus->commands[count++] = I2C_IC_DATA_CMD_CMD_BITS |
+                    (((ii==0) && (transaction->tx_len>0)) ? I2C_IC_DATA_CMD_RESTART_BITS : 0);
+    }
+    bus->commands[count-1] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+    // the target address can only be changed with the block disabled
+    hw->enable = 0;
+    hw->tar = transaction->address;
+    hw->enable = 1;
+    (void)hw->clr_tx_abrt;
+    (void)hw->clr_stop_det;
+    osEventFlagsClear( bus->events, I2C_BUS_DONE_FLAG );
+    hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+
+    if ( transaction->rx_len>0 )
+    {
+        config = dma_channel_get_default_config( bus->rx_channel );
+        channel_config_set_transfer_data_size( &config, DMA_SIZE_8 );
+        channel_config_set_read_increment( &config, false );
+        channel_config_set_write_increment( &config, true );
+        channel_config_set_dreq( &config, i2c_get_dreq( bus->i2c, false ) );
+        dma_channel_configure( bus->rx_channel, &config, transaction->rx, &hw->data_cmd, transaction->rx_len, true );
+    }
+    config = dma_channel_get_default_config( bus->tx_channel );
+    channel_config_set_transfer_data_size( &config, DMA_SIZE_16 );
+    channel_config_set_read_increment( &config, true );
+    channel_config_set_write_increment( &config, false );
+    channel_config_set_dreq( &config, i2c_get_dreq( bus->i2c, true ) );
+    dma_channel_configure( bus->tx_channel, &config, &hw->data_cmd, bus->commands, count, true );
+
+    flags = osEventFlagsWait( bus->events, I2C_BUS_DONE_FLAG, osFlagsWaitAny, I2C_BUS_TIMEOUT_MS );
+    hw->intr_mask = 0;
+
+    if ( (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS)!=0 )
+    {   // stop feeding it before the abort is cleared
+        dma_channel_abort( bus->tx_channel );
+        dma_channel_abort( bus->rx_channel );
+        abort_source = hw->tx_abrt_source;
+        (void)hw->clr_tx_abrt;
+        (void)hw->clr_stop_det;
+        return ( (abort_source & I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS)!=0 ) ? I2C_BUS_NAK : I2C_BUS_ERROR;
+    }
+    if ( (flags & osFlagsError)!=0 )
+    {   // held up - reset the block
+        dma_channel_abort( bus->tx_channel );
+        dma_channel_abort( bus->rx_channel );
+        hw->enable = 0;
+        printf( "I2C transaction with 0x%02x timed out\n", transaction->address );
+        return I2C_BUS_TIMEOUT;
+    }
+
+    // the last byte read may still be on its way
+    while ( (transaction->rx_len>0) && dma_channel_is_busy( bus->rx_channel ) )
+    {
+    }
+    (void)hw->clr_stop_det;
+    return I2C_BUS_DONE;
+}
+
+// Tell the submitter a transaction has completed
+//  It may be reused as soon as it is signalled, so take what is needed first
+static void I2cBus_complete( I2cTransaction_t *transaction )
+{
+    osEventFlagsId_t    event;
+    uint32_t            flags;
+    osThreadId_t        waiter;
+
+    event = transaction->event;
+    flags = transaction->flags;
+    waiter = transaction->waiter;
+    if ( transaction->callback!=NULL )
+    {
+        transaction->callback( transaction );
+    }
+    if ( event!=NULL )
+    {
+        osEventFlagsSet( event, flags );
+    }
+    if ( waiter!=NULL )
+    {
+        osThreadFlagsSet( waiter, I2C_BUS_THREAD_FLAG );
+    }
+}
+
+// Bus thread - runs the queued transactions in turn
+static void I2cBus_thread( void *argument )
+{
+    I2cBus_t            *bus;
+    I2cTransaction_t    *transaction;
+
+    bus = (I2cBus_t *)argument;
+    while ( 1 )
+    {
+        if ( osMessageQueueGet( bus->queue, &transaction, NULL, osWaitForever )!=osOK )
+        {
+            continue;
+        }
+        transaction->status = I2cBus_execute( bus, transaction );
+        I2cBus_complete( transaction );
+    }
+}
+
+// Public Functions
+
+// Set up a bus
+bool I2cBus_init( int bus_id, uint32_t baudrate, unsigned int sda_pin, unsigned int scl_pin )
+{
+    I2cBus_t    *bus;
+    uint        actual;
+
+    if ( (bus_id<0) || (bus_id>=I2C_BUS_COUNT) )
+    {
+        return false;
+    }
+    bus = &i2c_buses[bus_id];
+    if ( bus->queue!=NULL )
+    {   // already set up by another driver
+        return true;
+    }
+
+    // init port and pins
+    bus->i2c = ( bus_id==1 ) ? i2c1 : i2c0;
+    actual = i2c_init( bus->i2c, baudrate );
+    printf( "I2C%d at %u Hz\n", bus_id, actual );
+    gpio_set_function( sda_pin, GPIO_FUNC_I2C );
+    gpio_pull_up( sda_pin );
+    gpio_set_function( scl_pin, GPIO_FUNC_I2C );
+    gpio_pull_up( scl_pin );
+
+    bus->tx_channel = dma_claim_unused_channel( true );
+    bus->rx_channel = dma_claim_unused_channel( true );
+    bus->events = osEventFlagsNew( NULL );
+    bus->queue = osMessageQueueNew( I2C_BUS_QUEUE_SIZE, sizeof(I2cTransaction_t *), NULL );
+    if ( (bus->events==NULL) || (bus->queue==NULL) )
+    {
+        printf( "I2C%d - no memory\n", bus_id );
+        return false;
+    }
+
+    i2c_get_hw( bus->i2c )->intr_mask = 0;
+    irq_set_exclusive_handler( (bus_id==1) ? I2C1_IRQ : I2C0_IRQ, (bus_id==1) ? I2cBus_irq1 : I2cBus_irq0 );
+    irq_set_enabled( (bus_id==1) ? I2C1_IRQ : I2C0_IRQ, true );
+
+    osThreadNew( I2cBus_thread, bus, &i2c_bus_attr );
+    return true;
+}
+
+// Queue a transaction
+bool I2cBus_submit( int bus_id, I2cTransaction_t *transaction )
+{
+    if ( (bus_id<0) || (bus_id>=I2C_BUS_COUNT) || (i2c_buses[bus_id].queue==NULL) )
+    {
+        return false;
+    }
+    transaction->status = I2C_BUS_PENDING;
+    return ( osMessageQueuePut( i2c_buses[bus_id].queue, &transaction, 0, 0 )==osOK );
+}
+
+// Run a transaction and wait for it
+I2cStatus_t I2cBus_transfer( int bus_id, uint8_t address, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len )
+{
+    I2cTransaction_t    transaction;
+
+    memset( &transaction, 0, sizeof(transaction) );
+    transaction.address = address;
+    transaction.tx = tx;
+    transaction.tx_len = (uint16_t)tx_len;
+    transaction.rx = rx;
+    transaction.rx_len = (uint16_t)rx_len;
+    transaction.waiter = osThreadGetId();
+    osThreadFlagsClear( I2C_BUS_THREAD_FLAG );
+    if ( !I2cBus_submit( bus_id, &transaction ) )
+    {
+        return I2C_BUS_ERROR;
+    }
+    // the bus thread always completes it (each transaction has its own timeout)
+    osThreadFlagsWait( I2C_BUS_THREAD_FLAG, osFlagsWaitAny, osWaitForever );
+    return transaction.status;
+}
@@ -0,0 +1,86 @@
+/*---------------------------------------------------------------------------
+
+    I2C Bus
+        Shared I2C0/I2C1 buses, with queued DMA transactions
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "cmsis_os2.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Macros
+
+#define I2C_BUS_COUNT           2           // I2C0 and I2C1
+#define I2C_BUS_STANDARD_MODE   100000      // Hz
+#define I2C_BUS_FAST_MODE       400000
+#define I2C_BUS_TRANSFER_MAX    32          // bytes written plus bytes read in one transaction
+
+// Types
+
+typedef enum
+{
+    I2C_BUS_PENDING,                        // queued or in progress
+    I2C_BUS_DONE,
+    I2C_BUS_NAK,                            // the device did not acknowledge its address
+    I2C_BUS_TIMEOUT,
+    I2C_BUS_ERROR                           // arbitration lost, or a bad request
+} I2cStatus_t;
+
+typedef struct I2cTransaction_s I2cTransaction_t;
+
+// Completion callback - runs on the bus thread, whose 1 KB stack is sized
+// for its own printf, so a callback should just note the result and signal
+// a thread rather than print or do the work itself
+typedef void (*I2cCallback_t)( I2cTransaction_t *transaction );
+
+// A write then read (either may be empty) with a repeated start between
+//  The transaction and its buffers must stay valid until it completes
+struct I2cTransaction_s
+{
+    uint8_t             address;            // 7 bit
+    const uint8_t       *tx;
+    uint16_t            tx_len;
+    uint8_t             *rx;
+    uint16_t            rx_len;
+    volatile I2cStatus_t status;
+
+    // completion - any, all or none of these
+    I2cCallback_t       callback;           // run on the bus thread
+    void                *context;           // for the callback
+    osEventFlagsId_t    event;
+    uint32_t            flags;              // set in event
+    osThreadId_t        waiter;             // woken with I2C_BUS_THREAD_FLAG
+};
+
+// Thread flag used by I2cBus_transfer
+#define I2C_BUS_THREAD_FLAG     0x40000000u
+
+// Functions
+
+// Set up a bus - later calls for the same bus just share it
+//  Must be called from a thread
+bool I2cBus_init( int bus, uint32_t baudrate, unsigned int sda_pin, unsigned int scl_pin );
+
+// Queue a transaction without waiting
+//  Transactions on a bus run one at a time, in the order queued
+bool I2cBus_submit( int bus, I2cTransaction_t *transaction );
+
+// Run a transaction, sleeping until it completes
+I2cStatus_t I2cBus_transfer( int bus, uint8_t address, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // I2C_BUS_H
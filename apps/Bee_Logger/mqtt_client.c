@@ -315,25 +315,15 @@ void mqtt_disconnect( void )
 }
 
 //
-//  Sends MQTT float telementry
+//  Sends the telementry message built in payload_buf
 //
-bool mqtt_send_float( const char *key, double value ) 
+static bool send_telemetry( void ) 
 {
     uint16_t    length;
     uint16_t    header_length;
     uint8_t     *msg_ptr;
-    uint16_t    ii;
-    char        ch;
     int32_t     retval;
 
-    if ( !connected )
-    {
-        printf("Attended to send data when not connected\n" );
-        return false;
-    }
-
-    // Build message
-    sprintf( payload_buf, "{\"%s\":%.6f}", key, value );
     length = MQTT_MAX_HEADER_SIZE;
     length = append_string_field( mqtt_telemetry_topic, mqtt_tx_buf,length );
     msg_ptr = payload_buf;
@@ -358,3 +348,35 @@ bool mqtt_send_float( const char *key, double value )
     }
     return true;
 }
+
+//
+//  Sends MQTT float telementry
+//
+bool mqtt_send_float( const char *key, double value ) 
+{
+    if ( !connected )
+    {
+        printf("Attended to send data when not connected\n" );
+        return false;
+    }
+
+    // Build message
+    sprintf( payload_buf, "{\"%s\":%.6f}", key, value );
+    return send_telemetry();
+}
+
+//
+//  Sends MQTT fixed point telementry (value x 1000)
+//
+bool mqtt_send_milli( const char *key, milli_t value ) 
+{
+    if ( !connected )
+    {
+        printf("Attended to send data when not connected\n" );
+        return false;
+    }
+
+    // Build message
+    sprintf( payload_buf, "{\"%s\":" MILLI_FMT "}", key, MILLI_ARGS(value) );
+    return send_telemetry();
+}
@@ -12,6 +12,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "fixed_point.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -32,6 +33,11 @@ void mqtt_disconnect( void ) ;
 //
 bool mqtt_send_float( const char *key, double value ) ;
 
+//
+//  Sends MQTT fixed point telementry (value x 1000)
+//
+bool mqtt_send_milli( const char *key, milli_t value ) ;
+
 #ifdef __cplusplus
 }
 #endif
@@ -2,27 +2,38 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <vector>
 
 #include "one_wire.h"
+#include "crc8.h"
 
 #ifdef MOCK_PICO_PI
 
-#include "../test/pico_pi_mocks.h"
+#include "test/mocks/pico_pi_mocks.h"
 
 #else
 
 #include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "one_wire.pio.h"
 
 #endif
 
-std::vector<rom_address_t> found_addresses;
+int One_wire::_program_offset = -1;
+One_wire *One_wire::_dma_owner[NUM_DMA_CHANNELS];
 
 One_wire::One_wire(uint data_pin, uint power_pin, bool power_polarity)
+		: One_wire(data_pin, power_pin, power_polarity, nullptr, nullptr, 0) {
+}
+
+One_wire::One_wire(uint data_pin, uint power_pin, bool power_polarity, rom_address_t *addresses, Speed *speeds, int capacity)
 		: _data_pin(data_pin),
 		  _parasite_pin(power_pin),
 		  _power_polarity(power_polarity),
-		  _power_mosfet(power_pin != not_controllable) {
+		  _power_mosfet(power_pin != not_controllable),
+		  _addresses(addresses),
+		  _speeds(speeds),
+		  _capacity(capacity) {
 }
 
 void One_wire::init() {
@@ -34,79 +45,214 @@ void One_wire::init() {
 		byte_counter = 0x00;
 	}
 
+	// all buses share one copy of the program and the DMA completion interrupt
+	_pio = pio0;
+	if (_program_offset < 0) {
+		_program_offset = (int) pio_add_program(_pio, &one_wire_program);
+		irq_add_shared_handler(DMA_IRQ_0, dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+		irq_set_enabled(DMA_IRQ_0, true);
+	}
+	_sm = (uint) pio_claim_unused_sm(_pio, true);
+	_events = osEventFlagsNew(nullptr);
+	_bits = 8;
+	one_wire_program_init(_pio, _sm, (uint) _program_offset, _data_pin, _bits);
+	_tx_channel = dma_claim_unused_channel(true);
+	_rx_channel = dma_claim_unused_channel(true);
+	_dma_owner[_rx_channel] = this;
+	dma_channel_set_irq0_enabled(_rx_channel, true);
+
 	rom_address_t address{};
 	_parasite_power = !power_supply_available(address, true);
 }
 
 One_wire::~One_wire() {
-	found_addresses.clear();
+	if (_rx_channel >= 0) {
+		dma_channel_set_irq0_enabled(_rx_channel, false);
+		_dma_owner[_rx_channel] = nullptr;
+		dma_channel_unclaim(_rx_channel);
+		dma_channel_unclaim(_tx_channel);
+		pio_sm_set_enabled(_pio, _sm, false);
+		pio_sm_unclaim(_pio, _sm);
+	}
+}
+
+void One_wire::dma_irq_handler() {
+	for (uint channel = 0; channel < NUM_DMA_CHANNELS; channel++) {
+		if (_dma_owner[channel] != nullptr && dma_channel_get_irq0_status(channel)) {
+			dma_channel_acknowledge_irq0(channel);
+			_dma_owner[channel]->_transfer_done = true;
+			if (_dma_owner[channel]->_events != nullptr) {
+				osEventFlagsSet(_dma_owner[channel]->_events, TransferDoneFlag);
+			}
+		}
+	}
+}
+
+void One_wire::set_bit_mode(uint bits) {
+	// autopull/autopush threshold - 8 for whole bytes, 1 for single bits
+	if (bits == _bits) {
+		return;
+	}
+	pio_sm_set_enabled(_pio, _sm, false);
+	hw_write_masked(&_pio->sm[_sm].shiftctrl,
+					(bits << PIO_SM0_SHIFTCTRL_PULL_THRESH_LSB) | (bits << PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB),
+					PIO_SM0_SHIFTCTRL_PULL_THRESH_BITS | PIO_SM0_SHIFTCTRL_PUSH_THRESH_BITS);
+	// restart empties the shift registers so the counts match the new threshold
+	pio_sm_clear_fifos(_pio, _sm);
+	pio_sm_restart(_pio, _sm);
+	pio_sm_exec(_pio, _sm, pio_encode_jmp((uint) _program_offset + one_wire_offset_fetch_bit));
+	pio_sm_set_enabled(_pio, _sm, true);
+	_bits = bits;
+}
+
+void One_wire::start_receive(uint8_t *rx, uint count, uint byte_lane) {
+	static uint8_t discard;
+	dma_channel_config config = dma_channel_get_default_config(_rx_channel);
+	channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+	channel_config_set_read_increment(&config, false);
+	channel_config_set_write_increment(&config, rx != nullptr);
+	channel_config_set_dreq(&config, pio_get_dreq(_pio, _sm, false));
+	_transfer_done = false;
+	if (_events != nullptr) {
+		osEventFlagsClear(_events, TransferDoneFlag);
+	}
+	dma_channel_configure(_rx_channel, &config, (rx != nullptr) ? rx : &discard,
+						  (io_rw_8 *) &_pio->rxf[_sm] + byte_lane, count, true);
+}
+
+void One_wire::transfer(const uint8_t *tx, uint8_t *rx, uint count) {
+	// the bits sampled in each slot are shifted in from the top of the ISR
+	start_receive(rx, count, 3);
+	dma_channel_config config = dma_channel_get_default_config(_tx_channel);
+	channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+	channel_config_set_read_increment(&config, true);
+	channel_config_set_write_increment(&config, false);
+	channel_config_set_dreq(&config, pio_get_dreq(_pio, _sm, true));
+	dma_channel_configure(_tx_channel, &config, &_pio->txf[_sm], tx, count, true);
+	wait_for_transfer();
 }
 
-bool One_wire::reset_check_for_device() const {
+void One_wire::wait_for_transfer() {
+	// the receive channel finishes last, and its interrupt wakes us
+	while (!_transfer_done) {
+		if (can_block()) {
+			osEventFlagsWait(_events, TransferDoneFlag, osFlagsWaitAny, TransferTimeoutMs);
+		} else {
+			__wfe();
+		}
+	}
+}
+
+void One_wire::set_speed(bool overdrive) {
+	if (overdrive != _overdrive) {
+		one_wire_program_set_speed(_pio, _sm, overdrive);
+		_overdrive = overdrive;
+	}
+}
+
+bool One_wire::reset_check_for_device() {
+	// a standard speed reset, which returns every device to standard speed
+	set_speed(false);
+	_overdrive_device = -1;
+	return reset_pulse();
+}
+
+bool One_wire::reset_pulse() {
 	// This will return false if no devices are present on the data bus
-	bool presence = false;
-	gpio_set_dir(_data_pin, GPIO_OUT);
-	gpio_put(_data_pin, false); // bring low for 480us
-	sleep_us(480);
-	gpio_set_dir(_data_pin, GPIO_IN); // let the data line float high
-	sleep_us(70); // wait 70us
-	if (!gpio_get(_data_pin)) {
-		// see if any devices are pulling the data line low
-		presence = true;
-	}
-	sleep_us(410);
-	return presence;
-}
-
-void One_wire::onewire_bit_out(bool bit_data) const {
-	gpio_set_dir(_data_pin, GPIO_OUT);
-	gpio_put(_data_pin, false);
-	sleep_us(3);// (spec 1-15us)
-	if (bit_data) {
-		gpio_put(_data_pin, true);
-		sleep_us(55);
-	} else {
-		sleep_us(60);// (spec 60-120us)
-		gpio_put(_data_pin, true);
-		sleep_us(5);// allow bus to float high before next bit_out
+	uint8_t sample = 0xFF;
+	// nothing may use the bus while a strong pull-up is powering a conversion
+	if (_strong_pullup) {
+		wait_for_conversion();
 	}
+	start_receive(&sample, 1, 0);
+	pio_sm_exec(_pio, _sm, pio_encode_jmp((uint) _program_offset + one_wire_offset_reset_bus));
+	wait_for_transfer();
+	// see if any devices pulled the data line low
+	return (sample & 0x01) == 0;
+}
+
+void One_wire::onewire_bit_out(bool bit_data) {
+	uint8_t data = bit_data ? 0x01 : 0x00;
+	set_bit_mode(1);
+	transfer(&data, nullptr, 1);
 }
 
 void One_wire::onewire_byte_out(uint8_t data) {
-	int n;
-	for (n = 0; n < 8; n++) {
-		onewire_bit_out((bool) (data & 0x01));
-		data = data >> 1;// now the next bit is in the least sig bit position.
-	}
-}
-
-bool One_wire::onewire_bit_in() const {
-	bool answer;
-	gpio_set_dir(_data_pin, GPIO_OUT);
-	gpio_put(_data_pin, false);
-	sleep_us(3);// (spec 1-15us)
-	gpio_set_dir(_data_pin, GPIO_IN);
-	sleep_us(3);// (spec read within 15us)
-	answer = gpio_get(_data_pin);
-	sleep_us(45);
-	return answer;
+	set_bit_mode(8);
+	transfer(&data, nullptr, 1);
+}
+
+bool One_wire::onewire_bit_in() {
+	// a read slot is a written 1 that the slave may hold low
+	uint8_t data = 0x01;
+	uint8_t answer;
+	set_bit_mode(1);
+	transfer(&data, &answer, 1);
+	return (answer & 0x80) != 0;
 }
 
 uint8_t One_wire::onewire_byte_in() {
-	uint8_t answer = 0x00;
-	int i;
-	for (i = 0; i < 8; i++) {
-		answer = answer >> 1;// shift over to make room for the next bit
-		if (onewire_bit_in())
-			answer = (uint8_t) (answer | 0x80);// if the data port is high, make this bit a 1
-	}
+	uint8_t data = 0xFF;
+	uint8_t answer;
+	set_bit_mode(8);
+	transfer(&data, &answer, 1);
 	return answer;
 }
 
+void One_wire::onewire_transaction(const uint8_t *out, uint out_count, uint8_t *in, uint in_count) {
+	// write the command bytes then read the reply in one DMA transfer
+	uint8_t buffer[TransactionSize];
+	uint count = out_count + in_count;
+	if (count > TransactionSize) {
+		printf("one wire transaction too long\n");
+		return;
+	}
+	memcpy(buffer, out, out_count);
+	memset(&buffer[out_count], 0xFF, in_count);
+	set_bit_mode(8);
+	transfer(buffer, buffer, count);
+	if (in != nullptr) {
+		memcpy(in, &buffer[out_count], in_count);
+	}
+}
+
 int One_wire::find_and_count_devices_on_bus() {
-	while (search_rom_find_next()) {
+	rom_address_t address{};
+	bool found;
+	_found = 0;
+	for (found = search_rom_find_next(SearchROMCommand, true, address); found;
+		 found = search_rom_find_next(SearchROMCommand, false, address)) {
+		if (add_device(address) < 0) {
+			break;
+		}
+	}
+	return _found;
+}
+
+int One_wire::add_device(const rom_address_t &address) {
+	for (int i = 0; i < _found; i++) {
+		if (memcmp(_addresses[i].rom, address.rom, ROMSize) == 0) {
+			return i;
+		}
+	}
+	if (_found >= _capacity) {
+		printf("address table full\r\n");
+		return -1;
 	}
-	return (int) found_addresses.size();
+	_speeds[_found] = overdrive_capable(address) ? Speed::overdrive : Speed::standard;
+	_addresses[_found] = address;
+	return _found++;
+}
+
+int One_wire::find_alarmed_devices(rom_address_t *addresses, int capacity) {
+	rom_address_t address{};
+	bool found;
+	int count = 0;
+	for (found = search_rom_find_next(AlarmSearchCommand, true, address); found && (count < capacity);
+		 found = search_rom_find_next(AlarmSearchCommand, false, address)) {
+		addresses[count++] = address;
+	}
+	return _search_failed ? -1 : count;
 }
 
 rom_address_t One_wire::address_from_hex(const char *hex_address) {
@@ -121,7 +267,15 @@ rom_address_t One_wire::address_from_hex(const char *hex_address) {
 }
 
 rom_address_t &One_wire::get_address(int index) {
-	return found_addresses[index];
+	return _addresses[index];
+}
+
+One_wire::Speed One_wire::get_speed(int index) const {
+	return _speeds[index];
+}
+
+void One_wire::allow_overdrive(bool allow) {
+	_overdrive_allowed = allow;
 }
 
 void One_wire::bit_write(uint8_t &value, int bit, bool set) {
@@ -138,124 +292,97 @@ bool One_wire::single_device_read_rom(rom_address_t &rom_address) {
 	if (!reset_check_for_device()) {
 		return false;
 	} else {
-		onewire_byte_out(ReadROMCommand);
-		for (int bit_index = 0; bit_index < 64; bit_index++) {
-			bool bit = onewire_bit_in();
-			bit_write((uint8_t &) rom_address.rom[bit_index / 8], (bit_index % 8), bit);
-		}
+		// the 64 ROM bits arrive LSB first, so read them as whole bytes
+		const uint8_t command = ReadROMCommand;
+		onewire_transaction(&command, 1, rom_address.rom, ROMSize);
 	}
-	return true;
+	return !rom_checksum_error(rom_address.rom);
 }
 
-bool One_wire::search_rom_find_next() {
-	bool done_flag = false;
-	int last_discrepancy = 0;
-	uint8_t search_ROM[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+void One_wire::set_single_device(bool single) {
+	_single_device = single;
+}
 
+bool One_wire::search_rom_find_next(uint8_t command, bool first, rom_address_t &address) {
 	int discrepancy_marker, rom_bit_index;
-	bool return_value, bitA, bitB;
+	bool bitA, bitB, direction;
 	uint8_t byte_counter, bit_mask;
 
-	return_value = false;
-	while (!done_flag) {
-		if (!reset_check_for_device()) {
-			printf("Failed to reset one wire bus\n");
+	// each call follows the branch after the last one taken, so finding
+	// n devices takes n passes
+	if (first) {
+		_last_discrepancy = 0;
+		_last_device = false;
+		_search_failed = false;
+	}
+	if (_last_device) {
+		return false;
+	}
+	if (!reset_check_for_device()) {
+		printf("Failed to reset one wire bus\n");
+		_search_failed = true;
+		return false;
+	}
+	onewire_byte_out(command);
+	discrepancy_marker = 0;
+	byte_counter = 0;
+	bit_mask = 0x01;
+	for (rom_bit_index = 1; rom_bit_index <= 64; rom_bit_index++) {
+		bitA = onewire_bit_in();
+		bitB = onewire_bit_in();
+		if (bitA & bitB) {
+			// no device answered - normal when no device is alarmed
+			if ((command == SearchROMCommand) || (rom_bit_index > 1)) {
+				printf("Data read error - no devices on bus?\r\n");
+				_search_failed = true;
+			}
+			_last_device = true;
 			return false;
+		}
+		if (bitA | bitB) {
+			direction = bitA;// all remaining devices agree
 		} else {
-			rom_bit_index = 1;
-			discrepancy_marker = 0;
-			onewire_byte_out(SearchROMCommand);
-			byte_counter = 0;
-			bit_mask = 0x01;
-			while (rom_bit_index <= 64) {
-				bitA = onewire_bit_in();
-				bitB = onewire_bit_in();
-				if (bitA & bitB) {
-					discrepancy_marker = 0;// data read error, this should never happen
-					rom_bit_index = 0xFF;
-					printf("Data read error - no devices on bus?\r\n");
-				} else {
-					if (bitA | bitB) {
-						// Set ROM bit to Bit_A
-						if (bitA) {
-							search_ROM[byte_counter] =
-									search_ROM[byte_counter] | bit_mask;// Set ROM bit to one
-						} else {
-							search_ROM[byte_counter] =
-									search_ROM[byte_counter] & ~bit_mask;// Set ROM bit to zero
-						}
-					} else {
-						// both bits A and B are low, so there are two or more devices present
-						if (rom_bit_index == last_discrepancy) {
-							search_ROM[byte_counter] =
-									search_ROM[byte_counter] | bit_mask;// Set ROM bit to one
-						} else {
-							if (rom_bit_index > last_discrepancy) {
-								search_ROM[byte_counter] =
-										search_ROM[byte_counter] & ~bit_mask;// Set ROM bit to zero
-								discrepancy_marker = rom_bit_index;
-							} else {
-								if ((search_ROM[byte_counter] & bit_mask) == 0x00)
-									discrepancy_marker = rom_bit_index;
-							}
-						}
-					}
-					onewire_bit_out(search_ROM[byte_counter] & bit_mask);
-					rom_bit_index++;
-					if (bit_mask & 0x80) {
-						byte_counter++;
-						bit_mask = 0x01;
-					} else {
-						bit_mask = bit_mask << 1;
-					}
-				}
+			// both bits A and B are low, so there are two or more devices present
+			if (rom_bit_index < _last_discrepancy) {
+				direction = (_search_address.rom[byte_counter] & bit_mask) != 0;
+			} else {
+				direction = (rom_bit_index == _last_discrepancy);
 			}
-			last_discrepancy = discrepancy_marker;
-			if (rom_bit_index != 0xFF) {
-				uint8_t i = 0;
-				while (true) {
-					if (i >= found_addresses.size()) {       //End of list, or empty list
-						if (rom_checksum_error(search_ROM)) {// Check the CRC
-							printf("failed crc\r\n");
-							return false;
-						}
-						rom_address_t address{};
-						for (byte_counter = 0; byte_counter < 8; byte_counter++) {
-							address.rom[byte_counter] = search_ROM[byte_counter];
-						}
-						found_addresses.push_back(address);
-
-						return true;
-					} else {//Otherwise, check if ROM is already known
-						bool equal = true;
-						uint8_t *ROM_compare = found_addresses[i].rom;
-
-						for (byte_counter = 0; (byte_counter < 8) && equal; byte_counter++) {
-							if (ROM_compare[byte_counter] != search_ROM[byte_counter]) {
-								equal = false;
-							}
-						}
-						if (equal)
-							break;
-						else
-							i++;
-					}
-				}
+			if (!direction) {
+				discrepancy_marker = rom_bit_index;
 			}
 		}
-		if (last_discrepancy == 0)
-			done_flag = true;
+		if (direction) {
+			_search_address.rom[byte_counter] |= bit_mask;// Set ROM bit to one
+		} else {
+			_search_address.rom[byte_counter] &= ~bit_mask;// Set ROM bit to zero
+		}
+		onewire_bit_out(direction);
+		if (bit_mask & 0x80) {
+			byte_counter++;
+			bit_mask = 0x01;
+		} else {
+			bit_mask = bit_mask << 1;
+		}
+	}
+	_last_discrepancy = discrepancy_marker;
+	_last_device = (_last_discrepancy == 0);
+	if (rom_checksum_error(_search_address.rom)) {// Check the CRC
+		printf("failed crc\r\n");
+		_search_failed = true;
+		_last_device = true;
+		return false;
 	}
-	return return_value;
+	address = _search_address;
+	return true;
 }
 
 void One_wire::match_rom(rom_address_t &address) {
-	int i;
+	uint8_t command[1 + ROMSize];
 	if (reset_check_for_device()) {
-		onewire_byte_out(MatchROMCommand);
-		for (i = 0; i < 8; i++) {
-			onewire_byte_out(address.rom[i]);
-		}
+		command[0] = MatchROMCommand;
+		memcpy(&command[1], address.rom, ROMSize);
+		onewire_transaction(command, sizeof(command), nullptr, 0);
 	} else {
 		printf("match_rom failed\n");
 	}
@@ -269,74 +396,88 @@ void One_wire::skip_rom() {
 	}
 }
 
-bool One_wire::rom_checksum_error(uint8_t *address) {
-	uint8_t crc = 0x00;
-	int i;
-	for (i = 0; i < 7; i++) {// Only going to shift the lower 7 bytes
-		crc = crc_byte(crc, address[i]);
+void One_wire::select_device(rom_address_t &address) {
+	if (overdrive_select(address)) {
+		return;
+	}
+	// the only device on the bus needs no address
+	if (_single_device) {
+		skip_rom();
+	} else {
+		match_rom(address);
 	}
-	// After 7 bytes CRC should equal the 8th byte (ROM CRC)
-	return (crc != address[7]);// will return true if there is a CRC checksum mis-match
 }
 
-bool One_wire::ram_checksum_error() {
-	uint8_t crc = 0x00;
-	int i;
-	for (i = 0; i < 8; i++) {// Only going to shift the lower 8 bytes
-		crc = crc_byte(crc, ram[i]);
+bool One_wire::overdrive_select(rom_address_t &address) {
+	uint8_t command[1 + ROMSize];
+	int index = overdrive_index(address);
+	if (index < 0) {
+		return false;
 	}
-	// After 8 bytes CRC should equal the 9th byte (RAM CRC)
-	return (crc != ram[8]);// will return true if there is a CRC checksum mis-match
-}
-
-uint8_t One_wire::crc_byte(uint8_t crc, uint8_t byte) {
-	int j;
-	for (j = 0; j < 8; j++) {
-		if ((byte & 0x01) ^ (crc & 0x01)) {
-			// DATA ^ LSB CRC = 1
-			crc = crc >> 1;
-			// Set the MSB to 1
-			crc = (uint8_t) (crc | 0x80);
-			// Check bit 3
-			if (crc & 0x04) {
-				crc = (uint8_t) (crc & 0xFB);// Bit 3 is set, so clear it
-			} else {
-				crc = (uint8_t) (crc | 0x04);// Bit 3 is clear, so set it
-			}
-			// Check bit 4
-			if (crc & 0x08) {
-				crc = (uint8_t) (crc & 0xF7);// Bit 4 is set, so clear it
-			} else {
-				crc = (uint8_t) (crc | 0x08);// Bit 4 is clear, so set it
-			}
+	if (!_overdrive || (_overdrive_device != index)) {
+		// move just this device to overdrive (the address goes at overdrive speed)
+		if (!reset_check_for_device()) {
+			return false;
+		}
+		if (_single_device) {
+			onewire_byte_out(OverdriveSkipROMCommand);
+			set_speed(true);
 		} else {
-			// DATA ^ LSB CRC = 0
-			crc = crc >> 1;
-			// clear MSB
-			crc = (uint8_t) (crc & 0x7F);
-			// No need to check bits, with DATA ^ LSB CRC = 0, they will remain unchanged
+			onewire_byte_out(OverdriveMatchROMCommand);
+			set_speed(true);
+			memcpy(command, address.rom, ROMSize);
+			onewire_transaction(command, ROMSize, nullptr, 0);
 		}
-		byte = byte >> 1;
+		_overdrive_device = index;
+	}
+	// the only device at overdrive answers an overdrive reset
+	if (reset_pulse()) {
+		onewire_byte_out(SkipROMCommand);
+		return true;
 	}
-	return crc;
+	printf("No answer at overdrive - using standard speed\n");
+	_speeds[index] = Speed::standard;
+	return false;
 }
 
-int One_wire::convert_temperature(rom_address_t &address, bool wait, bool all) {
+int One_wire::overdrive_index(const rom_address_t &address) const {
+	if (!_overdrive_allowed) {
+		return -1;
+	}
+	for (int i = 0; i < _found; i++) {
+		if ((_speeds[i] == Speed::overdrive) && (memcmp(_addresses[i].rom, address.rom, ROMSize) == 0)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool One_wire::overdrive_capable(const rom_address_t &address) {
+	return (FAMILY_CODE == FAMILY_CODE_DS2431) || (FAMILY_CODE == FAMILY_CODE_DS28EA00);
+}
+
+bool One_wire::rom_checksum_error(uint8_t *address) {
+	// After 7 bytes CRC should equal the 8th byte (ROM CRC)
+	return Crc8_maxim::compute(address, 7) != address[7];// will return true if there is a CRC checksum mis-match
+}
+
+bool One_wire::ram_checksum_error() {
+	// After 8 bytes CRC should equal the 9th byte (RAM CRC)
+	return Crc8_maxim::compute(ram, 8) != ram[8];// will return true if there is a CRC checksum mis-match
+}
+
+int One_wire::start_convert_temperature(rom_address_t &address, bool all, osEventFlagsId_t event, uint32_t flags) {
 	int delay_time = 750;// Default delay time
-	uint8_t resolution;
-	if (all)
-		skip_rom();// Skip ROM command, will convert for ALL devices, wait maximum time
-	else {
-		match_rom(address);
-		if ((FAMILY_CODE == FAMILY_CODE_DS18B20) || (FAMILY_CODE == FAMILY_CODE_DS1822)) {
-			resolution = (uint8_t) (ram[4] & 0x60);
-			if (resolution == 0x00) // 9 bits
-				delay_time = 94;
-			if (resolution == 0x20) // 10 bits
-				delay_time = 188;
-			if (resolution == 0x40) // 11 bits.
-				delay_time = 375;
-			//Note 12bits uses the 750ms default
+	// the previous conversion must finish first
+	wait_for_conversion();
+	if (all) {
+		skip_rom();// Skip ROM command, will convert for ALL devices, wait for the slowest
+		delay_time = conversion_time(_conversion_resolution);
+	} else {
+		select_device(address);
+		if ((FAMILY_CODE == FAMILY_CODE_DS18B20) || (FAMILY_CODE == FAMILY_CODE_DS1822) ||
+			(FAMILY_CODE == FAMILY_CODE_DS28EA00)) {
+			delay_time = conversion_time(resolution());
 		}
 		if (FAMILY_CODE == FAMILY_CODE_MAX31826) {
 			delay_time = 150;// 12bit conversion
@@ -344,34 +485,91 @@ int One_wire::convert_temperature(rom_address_t &address, bool wait, bool all) {
 	}
 
 	onewire_byte_out(ConvertTempCommand);// perform temperature conversion
+	_notify_event = event;
+	_notify_flags = flags;
 	if (_parasite_power) {
 		if (_power_mosfet) {
 			gpio_put(_parasite_pin, _power_polarity);// Parasite power strong pull up
-			sleep_ms(delay_time);
-			gpio_put(_parasite_pin, !_power_polarity);
-			delay_time = 0;
 		} else {
+			// take the pin from the PIO to drive it high
+			gpio_set_function(_data_pin, GPIO_FUNC_SIO);
 			gpio_set_dir(_data_pin, GPIO_OUT);
 			gpio_put(_data_pin, true);
-			sleep_ms(delay_time);
+		}
+		_strong_pullup = true;
+	}
+
+	// a hardware alarm ends the conversion, without holding up the caller
+	_converting = true;
+	if (_events != nullptr) {
+		osEventFlagsClear(_events, ConversionDoneFlag);
+	}
+	if (add_alarm_in_ms(delay_time, conversion_alarm, this, true) < 0) {
+		// no alarm free - time it here instead
+		sleep_ms(delay_time);
+		end_conversion();
+		delay_time = 0;
+	}
+	return delay_time;
+}
+
+int One_wire::convert_temperature(rom_address_t &address, bool wait, bool all) {
+	int delay_time = start_convert_temperature(address, all, nullptr, 0);
+	if (wait) {
+		wait_for_conversion();
+		delay_time = 0;
+	}
+	return delay_time;
+}
+
+int64_t One_wire::conversion_alarm(alarm_id_t id, void *user_data) {
+	static_cast<One_wire *>(user_data)->end_conversion();
+	return 0;// not repeated
+}
+
+void One_wire::end_conversion() {
+	// runs in the alarm interrupt
+	if (_strong_pullup) {
+		if (_power_mosfet) {
+			gpio_put(_parasite_pin, !_power_polarity);
+		} else {
 			gpio_set_dir(_data_pin, GPIO_IN);
+			pio_gpio_init(_pio, _data_pin);
 		}
-	} else {
-		if (wait) {
-			sleep_ms(delay_time);
-			delay_time = 0;
+		_strong_pullup = false;
+	}
+	_converting = false;
+	if (_events != nullptr) {
+		osEventFlagsSet(_events, ConversionDoneFlag);
+	}
+	if (_notify_event != nullptr) {
+		osEventFlagsSet(_notify_event, _notify_flags);
+	}
+}
+
+bool One_wire::conversion_pending() const {
+	return _converting;
+}
+
+void One_wire::wait_for_conversion() {
+	while (_converting) {
+		if (can_block()) {
+			osEventFlagsWait(_events, ConversionDoneFlag, osFlagsWaitAny, ConversionTimeoutMs);
+		} else {
+			__wfe();
 		}
 	}
-	return delay_time;
+}
+
+bool One_wire::can_block() const {
+	// yield to other threads once the RTOS is running
+	return (_events != nullptr) && (osKernelGetState() == osKernelRunning);
 }
 
 void One_wire::read_scratch_pad(rom_address_t &address) {
-	int i;
-	match_rom(address);
-	onewire_byte_out(ReadScratchPadCommand);
-	for (i = 0; i < 9; i++) {
-		ram[i] = onewire_byte_in();
-	}
+	const uint8_t command = ReadScratchPadCommand;
+	select_device(address);
+	onewire_transaction(&command, 1, ram, sizeof(ram));
 }
 
 bool One_wire::set_resolution(rom_address_t &address, unsigned int resolution) {
@@ -380,10 +578,11 @@ bool One_wire::set_resolution(rom_address_t &address, unsigned int resolution) {
 		case FAMILY_CODE_DS18B20:
 		case FAMILY_CODE_DS18S20:
 		case FAMILY_CODE_DS1822:
+		case FAMILY_CODE_DS28EA00:
 			resolution = resolution - 9;
 			if (resolution < 4) {
 				resolution = resolution << 5;                    // align the bits
-				ram[4] = (uint8_t) ((ram[4] & 0x60) | resolution);// mask out old data, insert new
+				ram[4] = (uint8_t) ((ram[4] & ~0x60) | resolution);// mask out old data, insert new
 				write_scratch_pad(address, (ram[2] << 8) + ram[3]);
 				answer = true;
 			}
@@ -394,16 +593,52 @@ bool One_wire::set_resolution(rom_address_t &address, unsigned int resolution) {
 	return answer;
 }
 
+unsigned int One_wire::resolution() const {
+	return ((ram[4] >> 5) & 0x03) + 9;
+}
+
+void One_wire::set_conversion_resolution(unsigned int resolution) {
+	_conversion_resolution = resolution;
+}
+
+int One_wire::conversion_time(unsigned int resolution) {
+	switch (resolution) {
+		case 9:
+			return 94;
+		case 10:
+			return 188;
+		case 11:
+			return 375;
+		default:
+			return 750;
+	}
+}
+
+bool One_wire::set_alarm_band(rom_address_t &address, int low, int high) {
+	switch (FAMILY_CODE) {
+		case FAMILY_CODE_DS18B20:
+		case FAMILY_CODE_DS18S20:
+		case FAMILY_CODE_DS1822:
+		case FAMILY_CODE_DS28EA00:
+			if (((int8_t) ram[2] != high) || ((int8_t) ram[3] != low)) {
+				write_scratch_pad(address, ((high & 0xFF) << 8) | (low & 0xFF));// T(H), T(L)
+			}
+			return true;
+		default:
+			return false;
+	}
+}
+
 void One_wire::write_scratch_pad(rom_address_t &address, int data) {
 	ram[3] = (uint8_t) data;
 	ram[2] = (uint8_t) (data >> 8);
-	match_rom(address);
-	onewire_byte_out(WriteScratchPadCommand);
-	onewire_byte_out(ram[2]);// T(H)
-	onewire_byte_out(ram[3]);// T(L)
+	uint8_t command[4] = {WriteScratchPadCommand, ram[2], ram[3], ram[4]};// T(H), T(L), configuration
+	select_device(address);
 	if ((FAMILY_CODE == FAMILY_CODE_DS18S20) || (FAMILY_CODE == FAMILY_CODE_DS18B20) ||
-		(FAMILY_CODE == FAMILY_CODE_DS1822)) {
-		onewire_byte_out(ram[4]);// Configuration register
+		(FAMILY_CODE == FAMILY_CODE_DS1822) || (FAMILY_CODE == FAMILY_CODE_DS28EA00)) {
+		onewire_transaction(command, 4, nullptr, 0);// Configuration register
+	} else {
+		onewire_transaction(command, 3, nullptr, 0);
 	}
 }
 
@@ -426,6 +661,7 @@ float One_wire::temperature(rom_address_t &address, bool convert_to_fahrenheit)
 			case FAMILY_CODE_MAX31826:
 			case FAMILY_CODE_DS18B20:
 			case FAMILY_CODE_DS1822:
+			case FAMILY_CODE_DS28EA00:
 				answer = answer / 16.0f;
 				break;
 			case FAMILY_CODE_DS18S20:
@@ -446,11 +682,43 @@ float One_wire::temperature(rom_address_t &address, bool convert_to_fahrenheit)
 	return answer;
 }
 
+bool One_wire::temperature(rom_address_t &address, Fixed<4, Celsius> &value) {
+	int reading;
+	int remaining_count, count_per_degree;
+	read_scratch_pad(address);
+	if (ram_checksum_error()) {
+		return false;
+	}
+	reading = (int16_t) ((ram[1] << 8) + ram[0]);
+	switch (FAMILY_CODE) {
+		case FAMILY_CODE_MAX31826:
+		case FAMILY_CODE_DS18B20:
+		case FAMILY_CODE_DS1822:
+		case FAMILY_CODE_DS28EA00:
+			// already 1/16 degC
+			break;
+		case FAMILY_CODE_DS18S20:
+			// half degrees, extended with the count remain register
+			remaining_count = ram[6];
+			count_per_degree = ram[7];
+			if (count_per_degree == 0) {
+				return false;
+			}
+			reading = ((reading >> 1) << 4) - 4 + ((count_per_degree - remaining_count) << 4) / count_per_degree;
+			break;
+		default:
+			printf("Unsupported device family\n");
+			break;
+	}
+	value = Fixed<4, Celsius>::from_raw(reading);
+	return true;
+}
+
 bool One_wire::power_supply_available(rom_address_t &address, bool all) {
 	if (all) {
 		skip_rom();
 	} else {
-		match_rom(address);
+		select_device(address);
 	}
 	onewire_byte_out(ReadPowerSupplyCommand);
 	return onewire_bit_in();
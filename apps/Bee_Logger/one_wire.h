@@ -33,15 +33,20 @@
 
 #ifdef MOCK_PICO_PI
 
-#include "../test/pico_pi_mocks.h"
+#include "test/mocks/pico_pi_mocks.h"
 
 #else
 
 #include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
 #include "pico/time.h"
+#include "cmsis_os2.h"
 
 #endif
 
+#include "fixed_point.h"
+
 #define FAMILY_CODE address.rom[0]
 #define FAMILY_CODE_DS18S20 0x10 //9bit temp
 #define FAMILY_CODE_DS18B20 0x28 //9-12bit temp also known as MAX31820
@@ -51,6 +56,8 @@
 #define FAMILY_CODE_DS2417 0x27  //RTC
 #define FAMILY_CODE_DS2740 0x36  //Current measurement
 #define FAMILY_CODE_DS2502 0x09  //1k EEPROM
+#define FAMILY_CODE_DS2431 0x2D  //1k EEPROM, overdrive
+#define FAMILY_CODE_DS28EA00 0x42//9-12bit temp, overdrive
 
 static const int ReadScratchPadCommand = 0xBE;
 static const int ReadPowerSupplyCommand = 0xB4;
@@ -58,9 +65,17 @@ static const int ConvertTempCommand = 0x44;
 static const int MatchROMCommand = 0x55;
 static const int ReadROMCommand = 0x33;
 static const int SearchROMCommand = 0xF0;
+static const int AlarmSearchCommand = 0xEC;
 static const int SkipROMCommand = 0xCC;
+static const int OverdriveSkipROMCommand = 0x3C;
+static const int OverdriveMatchROMCommand = 0x69;
 static const int WriteScratchPadCommand = 0x4E;
 static const int ROMSize = 8;
+static const int TransactionSize = 16; // largest single DMA transaction in bytes
+static const uint32_t TransferDoneFlag = 0x0001;  // event flags for each bus
+static const uint32_t ConversionDoneFlag = 0x0002;
+static const uint32_t TransferTimeoutMs = 10;      // longest single wait, before checking again
+static const uint32_t ConversionTimeoutMs = 1000;
 struct rom_address_t {
 	uint8_t rom[ROMSize];
 };
@@ -68,6 +83,19 @@ struct rom_address_t {
 /**
  * OneWire with DS1820 Dallas 1-Wire Temperature Probe
  *
+ * The bus timing is generated by a PIO state machine (see one_wire.pio), with
+ * whole transactions fed to it by DMA. The calling thread waits on an event
+ * flag set by the DMA completion interrupt rather than bit-banging the bus.
+ * Temperature conversions are timed by hardware alarms, so they run while
+ * the caller gets on with other work.
+ *
+ * Devices in the address table (found by a search, or added with
+ * add_device) that support overdrive are addressed at overdrive speed: the
+ * device is sent Overdrive Match ROM, and while it stays selected each
+ * transaction needs only an overdrive reset and Skip ROM.  Any standard
+ * speed reset returns every device to standard speed.  A device that does
+ * not answer at overdrive is used at standard speed from then on.
+ *
  * Example:
  * @code
  * #include "one_wire.h"
@@ -93,6 +121,11 @@ public:
 		not_controllable = 0xFFFFFFFF
 	};
 
+	enum class Speed : uint8_t {
+		standard,
+		overdrive
+	};
+
 	/** Create a one wire bus object connected to the specified pins
 	 *
 	 * The bus might either by regular powered or parasite powered. If it is parasite
@@ -108,6 +141,9 @@ public:
 	One_wire(uint data_pin, uint power_pin = not_controllable, bool power_polarity = false);
 	~One_wire();
 
+	One_wire(const One_wire &) = delete;
+	One_wire &operator=(const One_wire &) = delete;
+
 	/**
 	 * Initialise and determine if any devices are using parasitic power
 	 */
@@ -116,17 +152,56 @@ public:
 	/**
 	 * Finds all one wire devices and returns the count
 	 *
+	 * The devices found replace those from any earlier search on this bus.
+	 * Only as many as the address table holds are kept (see One_wire_bus);
+	 * a plain One_wire has no table, so finds none.
+	 *
 	 * @return - number of devices found
 	 */
 	int find_and_count_devices_on_bus();
 
 	/**
-	 * Get address of devices previously found
+	 * Add a device found by an earlier search (eg kept in flash) to the
+	 * address table without searching the bus, so it is addressed at
+	 * overdrive if it can be.  A device already in the table is not added
+	 * again.
+	 *
+	 * @param address the device's ROM address
+	 * @return - index of the device, or -1 if the table is full
+	 */
+	int add_device(const rom_address_t &address);
+
+	/**
+	 * Get the speed a device previously found on this bus is addressed at
+	 *
+	 * @param index the index into found devices
+	 */
+	Speed get_speed(int index) const;
+
+	/**
+	 * Allow overdrive on this bus (the default) - long or heavily loaded
+	 * buses may only work at standard speed
+	 */
+	void allow_overdrive(bool allow);
+
+	/**
+	 * Finds the devices whose last temperature conversion fell outside
+	 * their alarm band, with an Alarm Search.  The bus is searched once
+	 * for each device found, and not at all for the others.
+	 *
+	 * @param addresses filled with the addresses found
+	 * @param capacity most addresses to find
+	 * @return number of devices found, or -1 if the search failed
+	 */
+	int find_alarmed_devices(rom_address_t *addresses, int capacity);
+
+	/**
+	 * Get address of devices previously found on this bus
 	 *
 	 * @param index the index into found devices
 	 * @return the address of
 	 */
-	static rom_address_t &get_address(int index);
+	rom_address_t &get_address(int index);
 
 	/**
 	 * This routine will initiate the temperature conversion within
@@ -140,6 +215,31 @@ public:
 	 */
 	int convert_temperature(rom_address_t &address, bool wait, bool all);
 
+	/**
+	 * Start a temperature conversion without waiting for it, even when
+	 * parasite powered.
+	 *
+	 * A hardware alarm ends the conversion, releasing any strong pull-up and
+	 * setting flags in event. Anything that needs the bus meanwhile waits
+	 * (yielding to other threads) until the strong pull-up is released.
+	 *
+	 * @param event (optional) event flags object to signal on completion
+	 * @param flags the flags to set in event
+	 * @returns milliseconds until conversion will complete.
+	 */
+	int start_convert_temperature(rom_address_t &address, bool all, osEventFlagsId_t event, uint32_t flags);
+
+	/**
+	 * Whether a conversion started on this bus is still running
+	 */
+	bool conversion_pending() const;
+
+	/**
+	 * Wait for a conversion started on this bus to complete, yielding to
+	 * other threads
+	 */
+	void wait_for_conversion();
+
 	/**
 	 * This function will return the temperature measured by the specific device.
 	 *
@@ -148,22 +248,80 @@ public:
 	 */
 	float temperature(rom_address_t &address, bool convert_to_fahrenheit = false);
 
+	/**
+	 * This function reads the temperature measured by the specific device
+	 * without any floating point, in the devices' native 1/16 degC steps.
+	 *
+	 * @param value the temperature in degC
+	 * @returns true if successful, false if a CRC error was detected
+	 */
+	bool temperature(rom_address_t &address, Fixed<4, Celsius> &value);
+
 	/**
 	 * This function sets the temperature resolution for supported devices
-	 * in the configuration register.
+	 * in the configuration register.  The alarm registers are written back
+	 * from the last scratchpad read, which must be this device's.
 	 *
 	 * @param resolution number between 9 and 12 to specify resolution
 	 * @returns true if successful
 	 */
 	bool set_resolution(rom_address_t &address, unsigned int resolution);
 
+	/**
+	 * Set the alarm band of supported devices, in the TH and TL registers.
+	 * A conversion at or above high, or at or below low (whole degrees C)
+	 * flags the device for find_alarmed_devices().  The configuration
+	 * register is written back from the last scratchpad read, which must
+	 * be this device's; nothing is written if the band is unchanged.
+	 *
+	 * @param low TL, -128 to 127
+	 * @param high TH, -128 to 127
+	 * @returns true if the device has alarm registers
+	 */
+	bool set_alarm_band(rom_address_t &address, int low, int high);
+
+	/**
+	 * The resolution held in the configuration register of the device
+	 * whose scratchpad was read last
+	 *
+	 * @returns number between 9 and 12
+	 */
+	[[nodiscard]] unsigned int resolution() const;
+
+	/**
+	 * Set the resolution used to time conversions of all the devices on
+	 * the bus at once - that of the slowest device
+	 *
+	 * @param resolution number between 9 and 12
+	 */
+	void set_conversion_resolution(unsigned int resolution);
+
+	/**
+	 * Conversion time of a DS18B20 at the given resolution
+	 *
+	 * @param resolution number between 9 and 12
+	 * @returns milliseconds
+	 */
+	static int conversion_time(unsigned int resolution);
+
 	/**
 	 * Assuming a single device is attached, do a Read ROM
 	 *
 	 * @param rom_address the address will be filled into this parameter
+	 * @returns false if no device answered or the address failed its CRC
 	 */
 	bool single_device_read_rom(rom_address_t &rom_address);
 
+	/**
+	 * Declare that only one device is attached to the bus, so it can be
+	 * addressed with Skip ROM rather than sending its 64 bit address with
+	 * Match ROM.  The address passed to other methods is then only used
+	 * for its family code.
+	 *
+	 * @param single true if the bus has a single device
+	 */
+	void set_single_device(bool single);
+
 	/**
 	 * Static utility method for easy conversion from previously stored addresses
 	 *
@@ -172,6 +330,13 @@ public:
 	 */
 	static rom_address_t address_from_hex(const char *hex_address);
 
+protected:
+	/**
+	 * Create a bus object that keeps the addresses found by searching in
+	 * the given table
+	 */
+	One_wire(uint data_pin, uint power_pin, bool power_polarity, rom_address_t *addresses, Speed *speeds, int capacity);
+
 private:
 	uint _data_pin;
 	uint _parasite_pin;
@@ -180,29 +345,88 @@ private:
 	bool _power_polarity;
 	uint8_t ram[9]{};
 
-	static uint8_t crc_byte(uint8_t crc, uint8_t byte);
+	PIO _pio{};
+	uint _sm{};
+	uint _bits{};
+	int _tx_channel{-1};
+	int _rx_channel{-1};
+	volatile bool _transfer_done{};
+	bool _single_device{};
+	unsigned int _conversion_resolution{12};
+	bool _overdrive_allowed{true};
+	bool _overdrive{};// state machine timing
+	int _overdrive_device{-1};// index of the device selected at overdrive
+
+	osEventFlagsId_t _events{};
+	volatile bool _converting{};
+	volatile bool _strong_pullup{};
+	osEventFlagsId_t _notify_event{};
+	uint32_t _notify_flags{};
+
+	rom_address_t *_addresses;
+	Speed *_speeds;
+	int _capacity;
+	int _found{};
+
+	rom_address_t _search_address{};
+	int _last_discrepancy{};
+	bool _last_device{};
+	bool _search_failed{};
+
+	static int _program_offset;
+	static One_wire *_dma_owner[NUM_DMA_CHANNELS];
+
+	static void dma_irq_handler();
+
+	void set_bit_mode(uint bits);
+
+	void start_receive(uint8_t *rx, uint count, uint byte_lane);
+
+	void transfer(const uint8_t *tx, uint8_t *rx, uint count);
+
+	void wait_for_transfer();
+
+	[[nodiscard]] bool can_block() const;
+
+	static int64_t conversion_alarm(alarm_id_t id, void *user_data);
+
+	void end_conversion();
 
 	static void bit_write(uint8_t &value, int bit, bool set);
 
-	[[nodiscard]] bool reset_check_for_device() const;
+	void set_speed(bool overdrive);
+
+	[[nodiscard]] bool reset_check_for_device();
+
+	[[nodiscard]] bool reset_pulse();
 
 	void match_rom(rom_address_t &address);
 
 	void skip_rom();
 
-	void onewire_bit_out(bool bit_data) const;
+	void select_device(rom_address_t &address);
+
+	bool overdrive_select(rom_address_t &address);
+
+	int overdrive_index(const rom_address_t &address) const;
+
+	static bool overdrive_capable(const rom_address_t &address);
+
+	void onewire_bit_out(bool bit_data);
 
 	void onewire_byte_out(uint8_t data);
 
-	[[nodiscard]] bool onewire_bit_in() const;
+	[[nodiscard]] bool onewire_bit_in();
 
 	uint8_t onewire_byte_in();
 
+	void onewire_transaction(const uint8_t *out, uint out_count, uint8_t *in, uint in_count);
+
 	static bool rom_checksum_error(uint8_t *address);
 
 	bool ram_checksum_error();
 
-	bool search_rom_find_next();
+	bool search_rom_find_next(uint8_t command, bool first, rom_address_t &address);
 
 	void read_scratch_pad(rom_address_t &address);
 
@@ -211,5 +435,34 @@ private:
 	bool power_supply_available(rom_address_t &address, bool all);
 };
 
+/**
+ * One wire bus with its own table for up to Capacity device addresses
+ *
+ * The table is part of the object, so searching never allocates and each
+ * bus's devices are independent of every other bus.
+ *
+ * Example:
+ * @code
+ * One_wire_bus<16> one_wire(15); //GP15, up to 16 devices
+ *
+ *     int count = one_wire.find_and_count_devices_on_bus();
+ *     rom_address_t &address = one_wire.get_address(0);
+ * @endcode
+ */
+template <int Capacity>
+class One_wire_bus : public One_wire {
+	static_assert(Capacity > 0, "One_wire_bus needs room for at least one device");
+
+public:
+	explicit One_wire_bus(uint data_pin, uint power_pin = not_controllable, bool power_polarity = false)
+			: One_wire(data_pin, power_pin, power_polarity, _table, _speeds, Capacity) {
+	}
+
+private:
+	// only their addresses are used until the base is constructed
+	rom_address_t _table[Capacity]{};
+	Speed _speeds[Capacity]{};
+};
+
 
 #endif// PICO_PI_ONEWIRE_H
\ No newline at end of file
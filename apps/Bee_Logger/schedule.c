@@ -0,0 +1,441 @@
+/*---------------------------------------------------------------------------
+
+    Schedule
+        Periodic jobs, each at its own rate, on absolute deadlines
+
+    clayton@isnotcrazy.com
+
+    Each job's next deadline is its last one plus its period, in kernel
+    ticks, and the application sleeps until the earliest with osDelayUntil
+    - so however long the jobs take, they do not drift.  A job that could
+    not run on time skips the slots it missed rather than running late,
+    which keeps its samples on their slots.
+
+    The deadlines are kept in a small binary min-heap of job ids, so the
+    next job due is always at the top.  Every job due within
+    SCHEDULE_COALESCE_MS of the first is taken at the same wake up, so jobs
+    with related periods (1s, 20s, 60s) wake the application once.
+
+    Deadlines are aligned to the wall clock (or to the uptime until the
+    clock is set), and again whenever a period or the clock is changed.
+    A job run by hand is run once at the next wake up, apart from its
+    slots, which stay where they were.
+
+---------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hardware/watchdog.h"
+#include "cmsis_os2.h"
+#include "console.h"
+#include "schedule.h"
+
+// Macros
+
+#define SCHEDULE_STEP_MS        100         // console poll and watchdog feed while waiting
+#define SCHEDULE_PERIOD_MIN_MS  100
+#define SCHEDULE_NAME_SIZE      12
+
+// Types
+
+typedef struct
+{
+    const char          *name;
+    uint32_t            period_ms;
+    uint32_t            phase_ms;
+    int                 priority;
+    uint32_t            deadline;           // tick the job is next due
+    bool                triggered;          // run once, off its slots
+    ScheduleStats_t     stats;
+} ScheduleJob_t;
+
+// Data
+
+static ScheduleJob_t    schedule_jobs[SCHEDULE_JOBS_MAX];
+static int              schedule_job_count;
+
+// min-heap of job ids, by deadline
+static int              schedule_heap[SCHEDULE_JOBS_MAX];
+static int              schedule_heap_size;
+
+static volatile bool    schedule_realign;           // a period or the clock changed
+static volatile bool    schedule_triggered;         // a job was run by hand
+
+// wall clock = base + ticks since the base tick
+static uint64_t         schedule_wall_base_ms;
+static uint32_t         schedule_wall_base_tick;
+static bool             schedule_wall_set;
+
+// Private Functions
+
+// Kernel ticks to ms, and back
+static uint32_t Schedule_toMs( uint32_t ticks )
+{
+    return (uint32_t)( (uint64_t)ticks * 1000 / osKernelGetTickFreq() );
+}
+
+static uint32_t Schedule_toTicks( uint32_t ms )
+{
+    return (uint32_t)( (uint64_t)ms * osKernelGetTickFreq() / 1000 );
+}
+
+// Wall clock (or uptime) in ms at a tick
+static uint64_t Schedule_wallMs( uint32_t tick )
+{
+    return schedule_wall_base_ms + Schedule_toMs( tick - schedule_wall_base_tick );
+}
+
+// Deadline a is before deadline b (they are always within 2^31 ticks)
+static bool Schedule_before( int a, int b )
+{
+    return ( (int32_t)(schedule_jobs[a].deadline - schedule_jobs[b].deadline) < 0 );
+}
+
+// Heap - move the entry at index up, or down, to its place
+static void Schedule_siftUp( int index )
+{
+    int     parent;
+    int     job;
+
+    job = schedule_heap[index];
+    while ( index>0 )
+    {
+        parent = (index-1) / 2;
+        if ( !Schedule_before( job, schedule_heap[parent] ) )
+        {
+            break;
+        }
+        schedule_heap[index] = schedule_heap[parent];
+        index = parent;
+    }
+    schedule_heap[index] = job;
+}
+
+static void Schedule_siftDown( int index )
+{
+    int     child;
+    int     job;
+
+    job = schedule_heap[index];
+    while ( (child = 2*index + 1)<schedule_heap_size )
+    {
+        if ( (child+1<schedule_heap_size) && Schedule_before( schedule_heap[child+1], schedule_heap[child] ) )
+        {
+            child++;
+        }
+        if ( !Schedule_before( schedule_heap[child], job ) )
+        {
+            break;
+        }
+        schedule_heap[index] = schedule_heap[child];
+        index = child;
+    }
+    schedule_heap[index] = job;
+}
+
+static void Schedule_push( int job )
+{
+    schedule_heap[schedule_heap_size] = job;
+    Schedule_siftUp( schedule_heap_size++ );
+}
+
+static int Schedule_pop( void )
+{
+    int     job;
+
+    job = schedule_heap[0];
+    schedule_heap[0] = schedule_heap[--schedule_heap_size];
+    if ( schedule_heap_size>0 )
+    {
+        Schedule_siftDown( 0 );
+    }
+    return job;
+}
+
+// Rebuild the heap after deadlines have been changed
+static void Schedule_heapify( void )
+{
+    int     ii;
+
+    for ( ii=schedule_heap_size/2 - 1; ii>=0; ii-- )
+    {
+        Schedule_siftDown( ii );
+    }
+}
+
+// First deadline of a job at or after a tick that is on one of its slots
+static void Schedule_align( ScheduleJob_t *job, uint32_t now )
+{
+    uint32_t    since_slot;
+
+    since_slot = (uint32_t)( (Schedule_wallMs( now ) + job->period_ms - job->phase_ms) % job->period_ms );
+    job->deadline = now + Schedule_toTicks( (since_slot==0) ? 0 : job->period_ms - since_slot );
+}
+
+static void Schedule_alignAll( uint32_t now )
+{
+    int     ii;
+
+    schedule_realign = false;
+    for ( ii=0; ii<schedule_job_count; ii++ )
+    {
+        Schedule_align( &schedule_jobs[ii], now );
+    }
+    Schedule_heapify();
+}
+
+// A job from its name or number
+static int Schedule_find( const char *name )
+{
+    int     ii;
+
+    for ( ii=0; ii<schedule_job_count; ii++ )
+    {
+        if ( strcmp( schedule_jobs[ii].name, name )==0 )
+        {
+            return ii;
+        }
+    }
+    ii = atoi( name );
+    return ( (ii>=1) && (ii<=schedule_job_count) ) ? ii-1 : -1;
+}
+
+// Public Functions
+
+// Add a job
+int Schedule_addJob( const char *name, uint32_t period_ms, uint32_t phase_ms, int priority )
+{
+    ScheduleJob_t   *job;
+
+    if ( schedule_job_count>=SCHEDULE_JOBS_MAX )
+    {
+        printf( "Schedule - no room for job %s\n", name );
+        return -1;
+    }
+    job = &schedule_jobs[schedule_job_count];
+    memset( job, 0, sizeof(*job) );
+    job->name = name;
+    job->priority = priority;
+    Schedule_setPeriod( schedule_job_count, period_ms, phase_ms );
+    Schedule_push( schedule_job_count );
+    return schedule_job_count++;
+}
+
+// Change a job's period
+bool Schedule_setPeriod( int job, uint32_t period_ms, uint32_t phase_ms )
+{
+    if ( (job<0) || (job>=SCHEDULE_JOBS_MAX) )
+    {
+        return false;
+    }
+    if ( period_ms<SCHEDULE_PERIOD_MIN_MS )
+    {
+        period_ms = SCHEDULE_PERIOD_MIN_MS;
+    }
+    schedule_jobs[job].period_ms = period_ms;
+    schedule_jobs[job].phase_ms = phase_ms % period_ms;
+    schedule_realign = true;
+    return true;
+}
+
+// Run a job once at the next wake up
+void Schedule_trigger( int job )
+{
+    if ( (job>=0) && (job<schedule_job_count) )
+    {
+        schedule_jobs[job].triggered = true;
+        schedule_triggered = true;
+    }
+}
+
+// Set the wall clock
+void Schedule_setTime( uint32_t seconds )
+{
+    schedule_wall_base_tick = osKernelGetTickCount();
+    schedule_wall_base_ms = (uint64_t)seconds * 1000;
+    schedule_wall_set = true;
+    schedule_realign = true;
+}
+
+// Wait for the next jobs
+int Schedule_next( int due[SCHEDULE_JOBS_MAX] )
+{
+    ScheduleJob_t   *job;
+    uint32_t        now;
+    uint32_t        until;
+    uint32_t        late;
+    int             count;
+    int             popped;
+    int             next;
+    int             ii;
+    int             jj;
+
+    now = osKernelGetTickCount();
+    if ( schedule_realign )
+    {
+        Schedule_alignAll( now );
+    }
+
+    // sleep in steps until the first is due
+    while ( !schedule_triggered &&
+            ((schedule_heap_size==0) ||
+             ((int32_t)(schedule_jobs[schedule_heap[0]].deadline - (now = osKernelGetTickCount())) > 0)) )
+    {
+        until = now + Schedule_toTicks( SCHEDULE_STEP_MS );
+        if ( (schedule_heap_size>0) && ((int32_t)(schedule_jobs[schedule_heap[0]].deadline - until) < 0) )
+        {
+            until = schedule_jobs[schedule_heap[0]].deadline;
+        }
+        osDelayUntil( until );
+        watchdog_update();
+        Console_poll();
+        if ( schedule_realign )
+        {   // changed from the console
+            Schedule_alignAll( osKernelGetTickCount() );
+        }
+    }
+    now = osKernelGetTickCount();
+    watchdog_update();
+
+    // take every job due by the end of the coalescing window
+    count = 0;
+    until = now + Schedule_toTicks( SCHEDULE_COALESCE_MS );
+    while ( (schedule_heap_size>0) && ((int32_t)(schedule_jobs[schedule_heap[0]].deadline - until) <= 0) )
+    {
+        due[count++] = Schedule_pop();
+    }
+
+    // time them, and put them back at their next slot
+    for ( ii=0; ii<count; ii++ )
+    {
+        job = &schedule_jobs[due[ii]];
+        late = ( (int32_t)(now - job->deadline) > 0 ) ? Schedule_toMs( now - job->deadline ) : 0;
+        job->stats.runs++;
+        job->stats.last_late_ms = late;
+        job->stats.total_late_ms += late;
+        if ( late>job->stats.max_late_ms )
+        {
+            job->stats.max_late_ms = late;
+        }
+        job->deadline += Schedule_toTicks( job->period_ms );
+        while ( (int32_t)(job->deadline - now) < 0 )
+        {
+            job->deadline += Schedule_toTicks( job->period_ms );
+            job->stats.missed++;
+        }
+        Schedule_push( due[ii] );
+    }
+
+    // and those run by hand, without moving their slots
+    popped = count;
+    if ( schedule_triggered )
+    {
+        schedule_triggered = false;
+        for ( ii=0; ii<schedule_job_count; ii++ )
+        {
+            if ( !schedule_jobs[ii].triggered )
+            {
+                continue;
+            }
+            schedule_jobs[ii].triggered = false;
+            for ( jj=0; (jj<popped) && (due[jj]!=ii); jj++ )
+            {
+            }
+            if ( jj==popped )
+            {   // not also due on its slot
+                due[count++] = ii;
+            }
+        }
+    }
+
+    // highest priority first (a stable insertion sort - the earliest due first on a tie)
+    for ( ii=1; ii<count; ii++ )
+    {
+        next = due[ii];
+        for ( jj=ii; (jj>0) && (schedule_jobs[due[jj-1]].priority<schedule_jobs[next].priority); jj-- )
+        {
+            due[jj] = due[jj-1];
+        }
+        due[jj] = next;
+    }
+    return count;
+}
+
+// Timing of a job
+const ScheduleStats_t *Schedule_stats( int job )
+{
+    return ( (job>=0) && (job<schedule_job_count) ) ? &schedule_jobs[job].stats : NULL;
+}
+
+// Print the jobs
+void Schedule_show( void )
+{
+    const ScheduleJob_t     *job;
+    uint32_t                now;
+    int                     ii;
+
+    now = osKernelGetTickCount();
+    printf( "Schedule - %s %lu s\n", schedule_wall_set ? "clock" : "uptime",
+                (unsigned long)( Schedule_wallMs( now ) / 1000 ) );
+    printf( "  job          period   phase  prio    runs  missed   late last/max/mean ms   next ms\n" );
+    for ( ii=0; ii<schedule_job_count; ii++ )
+    {
+        job = &schedule_jobs[ii];
+        printf( "  %d %-10s %7lu %7lu  %4d  %6lu  %6lu   %6lu %6lu %6lu   %7ld\n", ii+1, job->name,
+                    (unsigned long)job->period_ms, (unsigned long)job->phase_ms, job->priority,
+                    (unsigned long)job->stats.runs, (unsigned long)job->stats.missed,
+                    (unsigned long)job->stats.last_late_ms, (unsigned long)job->stats.max_late_ms,
+                    (unsigned long)( (job->stats.runs==0) ? 0 : job->stats.total_late_ms / job->stats.runs ),
+                    (long)(int32_t)Schedule_toMs( job->deadline - now ) );
+    }
+}
+
+// Console command
+void Schedule_command( const char *args )
+{
+    char        name[SCHEDULE_NAME_SIZE];
+    milli_t     period;
+    milli_t     phase;
+    uint32_t    seconds;
+    int         job;
+    int         ii;
+
+    if ( Console_match( &args, "show" ) )
+    {
+        Schedule_show();
+    }
+    else if ( Console_match( &args, "period" ) && Console_word( &args, name, sizeof(name) ) &&
+              Console_parseMilli( &args, &period ) && (period>0) )
+    {
+        phase = 0;
+        Console_parseMilli( &args, &phase );
+        if ( !Schedule_setPeriod( Schedule_find( name ), (uint32_t)period, (uint32_t)((phase<0) ? 0 : phase) ) )
+        {
+            printf( "Schedule - no job %s\n", name );
+        }
+    }
+    else if ( Console_match( &args, "run" ) && Console_word( &args, name, sizeof(name) ) )
+    {
+        job = Schedule_find( name );
+        if ( job<0 )
+        {
+            printf( "Schedule - no job %s\n", name );
+        }
+        Schedule_trigger( job );
+    }
+    else if ( Console_match( &args, "time" ) && Console_parseUnsigned( &args, &seconds ) )
+    {
+        Schedule_setTime( seconds );
+    }
+    else if ( Console_match( &args, "clear" ) )
+    {
+        for ( ii=0; ii<schedule_job_count; ii++ )
+        {
+            memset( &schedule_jobs[ii].stats, 0, sizeof(ScheduleStats_t) );
+        }
+    }
+    else
+    {
+        printf( "sched show | period <job> <s> [phase s] | run <job> | time <seconds since 1970> | clear\n" );
+    }
+}
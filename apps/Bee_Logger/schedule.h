@@ -0,0 +1,75 @@
+/*---------------------------------------------------------------------------
+
+    Schedule
+        Periodic jobs, each at its own rate, on absolute deadlines
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Macros
+
+#define SCHEDULE_JOBS_MAX       8
+#define SCHEDULE_COALESCE_MS    50          // jobs due this close to the first share its wake up
+
+// Types
+
+// Timing of a job so far
+typedef struct
+{
+    uint32_t    runs;
+    uint32_t    missed;             // slots skipped because the jobs before overran
+    uint32_t    last_late_ms;       // run after the deadline
+    uint32_t    max_late_ms;
+    uint64_t    total_late_ms;      // for the mean
+} ScheduleStats_t;
+
+// Functions
+
+// Add a job - returns its id (0..SCHEDULE_JOBS_MAX-1), or -1
+//  It runs when the wall clock (or the uptime, until the clock is set) is a
+//  whole number of periods plus the phase - so a period that divides a
+//  minute, or is a number of minutes, keeps it on minute boundaries.
+//  Of the jobs due at one wake up, those of higher priority come first.
+int Schedule_addJob( const char *name, uint32_t period_ms, uint32_t phase_ms, int priority );
+
+// Change a job's period and phase
+bool Schedule_setPeriod( int job, uint32_t period_ms, uint32_t phase_ms );
+
+// Run a job once at the next wake up (the next console poll, if waiting)
+//  Its slots stay where they were
+void Schedule_trigger( int job );
+
+// Set the wall clock, in seconds since 1970 - the jobs are aligned to it
+void Schedule_setTime( uint32_t seconds );
+
+// Sleep until the next job is due, then give the ids of every job due
+// (within SCHEDULE_COALESCE_MS), highest priority first
+//  Keeps the watchdog fed and the service console going meanwhile
+//  Returns the number of jobs in due[]
+int Schedule_next( int due[SCHEDULE_JOBS_MAX] );
+
+// Timing of a job so far
+const ScheduleStats_t *Schedule_stats( int job );
+
+// Print the jobs and their timing
+void Schedule_show( void );
+
+// Console command handler - "sched show|period <job> <s> [phase s]|run <job>|time <seconds since 1970>|clear"
+void Schedule_command( const char *args );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // SCHEDULE_H
@@ -0,0 +1,43 @@
+/*---------------------------------------------------------------------------
+
+    Supply Voltage
+        Routines to read the supply voltage through the ADC divider
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+#include <stdio.h>
+#include "analog_channel.h"
+#include "analog_calibration.h"
+#include "supply_voltage.h"
+
+// Macros
+
+#define ADC_PIN         28
+#define ADC_SAMPLES     4096        // oversampled, as the supply is noisy while the WizFi360 transmits
+
+// Conversion from oversampled readings (12 bits x 16), folded to fixed point at compile time
+//  The divider and diode drop are calibrated (analog_calibration.cpp)
+static constexpr Linear<Voltage> pin_scale( ANALOG_VREF / ANALOG_FULL_SCALE, 0.0 );
+
+// Public Functions
+
+// Initialise the ADC channel
+void SupplyVoltage_init( void )
+{
+    AnalogChannel_init();
+    AnalogChannel_enable( ADC_PIN-26 );
+    AnalogCalibration_init();
+}
+
+// Read the supply voltage
+bool SupplyVoltage_read( uint16_t *reading, milli_t *pin_voltage, milli_t *supply_voltage )
+{
+    if ( !AnalogChannel_read( ADC_PIN-26, ADC_SAMPLES, reading ) )
+    {
+        return false;
+    }
+    *pin_voltage = pin_scale.apply( *reading ).to_milli();
+    *supply_voltage = AnalogCalibration_apply( *reading );          // scale for resistors and diode-drop
+    return true;
+}
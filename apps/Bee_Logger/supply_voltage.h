@@ -0,0 +1,34 @@
+/*---------------------------------------------------------------------------
+
+    Supply Voltage
+        Routines to read the supply voltage through the ADC divider
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+
+#ifndef SUPPLY_VOLTAGE_H
+#define SUPPLY_VOLTAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fixed_point.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Functions
+
+// Initialise the ADC channel
+void SupplyVoltage_init( void );
+
+// Read the supply, giving the oversampled reading (ADC counts x 16), the
+// voltage at the ADC pin and the supply voltage before the divider (V x 1000)
+bool SupplyVoltage_read( uint16_t *reading, milli_t *pin_voltage, milli_t *supply_voltage );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // SUPPLY_VOLTAGE_H
@@ -1,7 +1,7 @@
 /*---------------------------------------------------------------------------
 
     Temperature Sensors
-        Routines to read from the one-wire DS18B20 sensor
+        Routines to read from the one-wire DS18B20 sensors
 
     clayton@isnotcrazy.com
 
@@ -10,78 +10,632 @@
 
 	Provides a C wrapper around the C++ library
 
+	Each bus may carry many sensors.  The sensors found on the buses are
+	kept in an inventory, with a logical name for each, which is stored
+	in flash so a restart does not have to search the buses again.
+
+	The DS18B20s take 750ms to convert at 12 bits but only 94ms at 9 bits.
+	A probe whose full resolution readings hold steady is dropped to 9
+	bits, and while it reads within the same 9 bit step as its last full
+	resolution reading, that reading stands.  Any other reading, and every
+	TEMP_REFRESH_CYCLES readings regardless, it is raised to 12 bits again.
+	Each bus is timed for its slowest probe.
+
+	On a bus with TEMP_ALARM_SCAN_MIN or more probes, each probe's alarm
+	band (TH/TL) is set around its last reading.  After a conversion an
+	Alarm Search finds the probes that have left their band, and only
+	those are read - the others keep their last reading.  Every probe is
+	read again every TEMP_FULL_READ_CYCLES cycles.
+
+	Each bus keeps its own state (conversion flag, cycle count, and the
+	policy of the probes on it), so the buses can also be read by
+	separate threads with TempSensor_readBus.
+
 ---------------------------------------------------------------------------*/
 #include <stdio.h>
+#include <string.h>
+#include "cmsis_os2.h"
 #include "one_wire.h"
+#include "flash_store.h"
+#include "console.h"
 #include "temperature_sensors.h"
 
+// Macros
+
+#define TEMP_BUS_CAPACITY		16			// most sensors found on one bus
+#define TEMP_INVENTORY_VERSION	1
+#define TEMP_CONVERSION_TIMEOUT_MS	1000		// longer than any conversion
+#define TEMP_RESOLUTION_LOW		9			// bits
+#define TEMP_RESOLUTION_HIGH	12
+#define TEMP_STABLE_CYCLES		3			// steady full resolution readings before dropping
+#define TEMP_REFRESH_CYCLES		8			// low resolution readings between full ones
+#define TEMP_ALARM_SCAN_MIN		4			// probes on a bus to read by Alarm Search
+#define TEMP_ALARM_BAND			2			// C - TL and TH from the whole degrees read
+#define TEMP_FULL_READ_CYCLES	8			// cycles between reading every probe
+
+// Valid temperature range
+static constexpr Temperature TEMPERATURE_MIN = Temperature::from_double( -100.0 );
+static constexpr Temperature TEMPERATURE_MAX = Temperature::from_double( 200.0 );
+
+// Largest change between full resolution readings of a steady probe
+static constexpr Fixed<4, Celsius> TEMP_STABLE_DELTA = Fixed<4, Celsius>::from_double( 0.25 );
+
+// Types
+
+typedef struct
+{
+	uint8_t			bus;						// index into temp_buses
+	rom_address_t	address;
+	char			name[SENSOR_NAME_SIZE];
+} TempSensorEntry_t;
+
+// Inventory as stored in flash
+typedef struct
+{
+	uint32_t			version;
+	int32_t				count;
+	TempSensorEntry_t	sensors[SENSORS_MAX];
+} TempInventory_t;
+
+// Resolution policy state of a sensor
+typedef struct
+{
+	uint8_t				resolution;				// bits the probe is set to
+	uint8_t				stable;					// steady full resolution readings in a row
+	uint8_t				low_cycles;				// low resolution readings since the last full one
+	bool				reference_valid;
+	Fixed<4, Celsius>	reference;				// last full resolution reading
+} TempSensorPolicy_t;
+
 // Data
-One_wire TSensor1( 10 );		// GP10
-One_wire TSensor2( 11 );		// GP11
-One_wire TSensor3( 12 );		// GP12
-One_wire TSensor4( 15 );		// GP15 (test sensor)
+One_wire_bus<TEMP_BUS_CAPACITY> TSensor1( 10 );		// GP10
+One_wire_bus<TEMP_BUS_CAPACITY> TSensor2( 11 );		// GP11
+One_wire_bus<TEMP_BUS_CAPACITY> TSensor3( 12 );		// GP12
+One_wire_bus<TEMP_BUS_CAPACITY> TSensor4( 15 );		// GP15 (test sensor)
+
+static One_wire * const temp_buses[TEMP_BUS_COUNT] = { &TSensor1, &TSensor2, &TSensor3, &TSensor4 };
+static const uint temp_bus_pins[TEMP_BUS_COUNT] = { 10, 11, 12, 15 };
+
+static osEventFlagsId_t	temp_conversion_event;			// one flag per bus, set when its conversion is done
+static TempInventory_t	temp_inventory;
+static int				temp_bus_sensors[TEMP_BUS_COUNT];		// inventory sensors on each bus
+static TempSensorPolicy_t	temp_policy[SENSORS_MAX];			// by inventory entry
+static milli_t			temp_results[SENSORS_MAX];				// last readings, for probes not read
+static bool				temp_results_valid[SENSORS_MAX];
+static uint32_t			temp_bus_cycle[TEMP_BUS_COUNT];
+static uint32_t			temp_pending;					// flags of the buses converting
+
+// Private Functions
+
+static void TempSensor_printAddress( const rom_address_t &address )
+{
+	printf( "%02x%02x%02x%02x%02x%02x%02x%02x",
+				address.rom[0], address.rom[1], address.rom[2], address.rom[3], 
+				address.rom[4], address.rom[5], address.rom[6], address.rom[7] );
+}
+
+// Select the inventory entry for a sensor
+static TempSensorEntry_t *TempSensor_select( int sensor_id )
+{
+	if ( (sensor_id<1) || (sensor_id>temp_inventory.count) )
+	{
+		return NULL;
+	}
+	return &temp_inventory.sensors[sensor_id-1];
+}
+
+// Time a bus's conversions for its slowest probe
+static void TempSensor_timeBus( int bus )
+{
+	unsigned int	slowest;
+	int				ii;
+
+	slowest = 0;
+	for ( ii=0; ii<temp_inventory.count; ii++ )
+	{
+		if ( (temp_inventory.sensors[ii].bus==bus) && (temp_policy[ii].resolution>slowest) )
+		{
+			slowest = temp_policy[ii].resolution;
+		}
+	}
+	temp_buses[bus]->set_conversion_resolution( (slowest==0) ? TEMP_RESOLUTION_HIGH : slowest );
+}
+
+// Time every bus
+static void TempSensor_timeBuses( void )
+{
+	int		bus;
+
+	for ( bus=0; bus<TEMP_BUS_COUNT; bus++ )
+	{
+		TempSensor_timeBus( bus );
+	}
+}
+
+// Count the sensors on each bus - a bus with just one is addressed with Skip ROM
+static void TempSensor_configure( void )
+{
+	int		ii;
+
+	memset( temp_bus_sensors, 0, sizeof(temp_bus_sensors) );
+	for ( ii=0; ii<temp_inventory.count; ii++ )
+	{
+		temp_bus_sensors[ temp_inventory.sensors[ii].bus ]++;
+	}
+	for ( ii=0; ii<TEMP_BUS_COUNT; ii++ )
+	{
+		temp_buses[ii]->set_single_device( temp_bus_sensors[ii]==1 );
+	}
+
+	// probes power up at full resolution - any that are not are found when read
+	for ( ii=0; ii<SENSORS_MAX; ii++ )
+	{
+		temp_policy[ii] = TempSensorPolicy_t{};
+		temp_policy[ii].resolution = TEMP_RESOLUTION_HIGH;
+		temp_results_valid[ii] = false;
+	}
+	memset( temp_bus_cycle, 0, sizeof(temp_bus_cycle) );
+	TempSensor_timeBuses();
+}
+
+// Apply the resolution policy to a reading just collected, and set the
+// resolution for the next one
+//	Returns false if the reading has to be discarded
+static bool TempSensor_adapt( TempSensorPolicy_t *policy, TempSensorEntry_t *entry, Fixed<4, Celsius> &reading )
+{
+	One_wire			*sensor;
+	Fixed<4, Celsius>	change;
+	unsigned int		resolution;
+	unsigned int		next;
+	int32_t				step_mask;
+	bool				late;
+
+	if ( (entry->address.rom[0]!=FAMILY_CODE_DS18B20) && (entry->address.rom[0]!=FAMILY_CODE_DS1822) &&
+		 (entry->address.rom[0]!=FAMILY_CODE_DS28EA00) )
+	{	// fixed resolution
+		return true;
+	}
+
+	// a probe that has been reset is back at its power up resolution
+	sensor = temp_buses[entry->bus];
+	resolution = sensor->resolution();
+	if ( resolution!=policy->resolution )
+	{
+		printf( "Sensor %s at %u bits, expected %u\n", entry->name, resolution, (unsigned)policy->resolution );
+		late = ( resolution>policy->resolution );
+		policy->resolution = (uint8_t)resolution;
+		if ( late )
+		{	// it was read before its conversion finished
+			policy->stable = 0;
+			return false;
+		}
+	}
+
+	if ( resolution>=TEMP_RESOLUTION_HIGH )
+	{	// full resolution - steady if close to the last one
+		change = reading - policy->reference;
+		if ( policy->reference_valid && (change>=-TEMP_STABLE_DELTA) && (change<=TEMP_STABLE_DELTA) )
+		{
+			if ( policy->stable<TEMP_STABLE_CYCLES )
+			{
+				policy->stable++;
+			}
+		}
+		else
+		{
+			policy->stable = 0;
+		}
+		policy->reference = reading;
+		policy->reference_valid = true;
+		policy->low_cycles = 0;
+		next = ( policy->stable>=TEMP_STABLE_CYCLES ) ? TEMP_RESOLUTION_LOW : TEMP_RESOLUTION_HIGH;
+	}
+	else
+	{	// low resolution - the undefined low bits are dropped
+		step_mask = ~((1 << (TEMP_RESOLUTION_HIGH - resolution)) - 1);
+		next = TEMP_RESOLUTION_HIGH;
+		if ( policy->reference_valid && ((reading.raw() & step_mask)==(policy->reference.raw() & step_mask)) )
+		{	// no change that this resolution can show
+			reading = policy->reference;
+			if ( ++policy->low_cycles<TEMP_REFRESH_CYCLES )
+			{
+				next = resolution;
+			}
+		}
+		else
+		{	// moving
+			reading = Fixed<4, Celsius>::from_raw( reading.raw() & step_mask );
+			policy->stable = 0;
+		}
+	}
+
+	if ( (next!=resolution) && sensor->set_resolution( entry->address, next ) )
+	{
+		policy->resolution = (uint8_t)next;
+	}
+	return true;
+}
+
+// Give a sensor the first free default name
+//	With at most SENSORS_MAX names taken, one of the first SENSORS_MAX+1 is free
+static void TempSensor_defaultName( TempInventory_t *inventory, TempSensorEntry_t *entry )
+{
+	char	name[SENSOR_NAME_SIZE];
+	bool	used;
+	int		number;
+	int		ii;
+
+	for ( number=1; number<=SENSORS_MAX+1; number++ )
+	{
+		snprintf( name, sizeof(name), "Temperature%d", number );
+		used = false;
+		for ( ii=0; (ii<inventory->count) && !used; ii++ )
+		{
+			used = ( strcmp( inventory->sensors[ii].name, name )==0 );
+		}
+		if ( !used )
+		{
+			strcpy( entry->name, name );
+			return;
+		}
+	}
+	entry->name[0] = '\0';
+}
+
+// Collect a converted reading from a sensor
+static bool TempSensor_collect( int sensor_id, TempSensorEntry_t *entry, milli_t *result )
+{
+	One_wire			*sensor;
+	rom_address_t		address;
+	Fixed<4, Celsius>	reading;
+	Temperature			temperature;
+	int					band_centre;
+
+	sensor = temp_buses[entry->bus];
+	if ( !sensor->temperature( entry->address, reading ) )
+	{
+		printf( "Sensor %s CRC error\n", entry->name );
+		// a lone sensor may have been changed - read its address again
+		if ( (temp_bus_sensors[entry->bus]==1) && sensor->single_device_read_rom( address ) &&
+			 (memcmp( &address, &entry->address, sizeof(address) )!=0) )
+		{
+			printf( "Sensor %s Address: ", entry->name );
+			TempSensor_printAddress( address );
+			printf( "\n" );
+			entry->address = address;
+		}
+		return false;
+	}
+	if ( !TempSensor_adapt( &temp_policy[sensor_id-1], entry, reading ) )
+	{
+		return false;
+	}
+	if ( temp_bus_sensors[entry->bus]>=TEMP_ALARM_SCAN_MIN )
+	{	// alarm when it moves out of the band around this reading
+		band_centre = reading.raw() >> 4;
+		sensor->set_alarm_band( entry->address, band_centre-TEMP_ALARM_BAND, band_centre+TEMP_ALARM_BAND );
+	}
+	temperature = reading.convert<Temperature::frac_bits>();
+	*result = temperature.to_milli();
+	printf( "Sensor %s Temperature: " MILLI_FMT " C\n", entry->name, MILLI_ARGS(*result) );
+	if ( (temperature<TEMPERATURE_MIN) || (temperature>TEMPERATURE_MAX) )
+	{	// reject out of range temperatures
+		return false;
+	}
+	return true;
+}
+
+// Choose the probes on a bus to read after a conversion
+//	On a bus scanned by Alarm Search only the alarmed probes are read,
+//	unless every probe is due to be read
+static void TempSensor_selectAlarmed( int bus, bool read_all, bool selected[SENSORS_MAX] )
+{
+	rom_address_t		alarmed[TEMP_BUS_CAPACITY];
+	bool				scanned;
+	int					count;
+	int					ii;
+	int					jj;
+
+	scanned = !read_all && (temp_bus_sensors[bus]>=TEMP_ALARM_SCAN_MIN);
+	count = scanned ? temp_buses[bus]->find_alarmed_devices( alarmed, TEMP_BUS_CAPACITY ) : 0;
+	for ( ii=0; ii<temp_inventory.count; ii++ )
+	{
+		if ( temp_inventory.sensors[ii].bus!=bus )
+		{
+			continue;
+		}
+		// as well as any without a good reading (and so without a band),
+		// and all of them if the search failed
+		selected[ii] = !scanned || !temp_results_valid[ii] || (count<0);
+		for ( jj=0; jj<count; jj++ )
+		{
+			if ( memcmp( &alarmed[jj], &temp_inventory.sensors[ii].address, sizeof(rom_address_t) )==0 )
+			{
+				selected[ii] = true;
+			}
+		}
+	}
+}
+
+// Read the converted probes on a bus
+static void TempSensor_collectBus( int bus, milli_t results[SENSORS_MAX], bool valid[SENSORS_MAX] )
+{
+	TempSensorEntry_t	*entry;
+	bool				selected[SENSORS_MAX];
+	int					ii;
+
+	// find the probes to read
+	TempSensor_selectAlarmed( bus, (temp_bus_cycle[bus]++ % TEMP_FULL_READ_CYCLES)==0, selected );
+
+	// read their scratchpads
+	for ( ii=0; ii<temp_inventory.count; ii++ )
+	{
+		entry = &temp_inventory.sensors[ii];
+		if ( entry->bus!=bus )
+		{
+			continue;
+		}
+		if ( selected[ii] )
+		{
+			temp_results[ii] = 0;
+			temp_results_valid[ii] = TempSensor_collect( ii+1, entry, &temp_results[ii] );
+		}
+		results[ii] = temp_results[ii];
+		valid[ii] = temp_results_valid[ii];
+	}
+	TempSensor_timeBus( bus );
+}
+
+// Public Functions
 
 // Initialise all sensor channels
 void TempSensor_init( void )
 {
-    rom_address_t 		address;
-
-	TSensor1.init();
-	TSensor2.init();
-	TSensor3.init();
-	TSensor4.init();
-	// do an initial read
-	TSensor1.single_device_read_rom( address );
-	TSensor1.convert_temperature( address, true, false );
-	TSensor1.temperature( address );
-	TSensor2.single_device_read_rom( address );
-	TSensor2.convert_temperature( address, true, false );
-	TSensor2.temperature( address );
-	TSensor3.single_device_read_rom( address );
-	TSensor3.convert_temperature( address, true, false );
-	TSensor3.temperature( address );
-	TSensor4.single_device_read_rom( address );
-	TSensor4.convert_temperature( address, true, false );
-	TSensor4.temperature( address );
+	TempInventory_t		stored;
+	milli_t				results[SENSORS_MAX];
+	bool				valid[SENSORS_MAX];
+	int					ii;
+
+	temp_conversion_event = osEventFlagsNew( NULL );
+	for ( ii=0; ii<TEMP_BUS_COUNT; ii++ )
+	{
+		temp_buses[ii]->init();
+	}
+
+	if ( FlashStore_read( FLASH_STORE_TEMP_INVENTORY, &stored, sizeof(stored) ) &&
+		 (stored.version==TEMP_INVENTORY_VERSION) && (stored.count>=0) && (stored.count<=SENSORS_MAX) )
+	{
+		temp_inventory = stored;
+		printf( "Temperature sensor inventory loaded - %ld sensors\n", (long)temp_inventory.count );
+		// the buses address their sensors from their own tables (and at overdrive where they can)
+		for ( ii=0; ii<temp_inventory.count; ii++ )
+		{
+			temp_buses[ temp_inventory.sensors[ii].bus ]->add_device( temp_inventory.sensors[ii].address );
+		}
+		TempSensor_configure();
+	}
+	else
+	{
+		TempSensor_scan();
+		TempSensor_save();
+	}
+
+	// do an initial read (the first conversion after power up is not valid)
+	TempSensor_readAll( results, valid );
+}
+
+// Number of sensors
+int TempSensor_count( void )
+{
+	return temp_inventory.count;
+}
+
+// Logical name of a sensor
+const char *TempSensor_name( int sensor_id )
+{
+	TempSensorEntry_t	*entry;
+
+	entry = TempSensor_select( sensor_id );
+	return ( entry==NULL ) ? "" : entry->name;
 }
 
 // Read a sensor
-bool TempSensor_read( int sensor_id, double *result )
+bool TempSensor_read( int sensor_id, milli_t *result )
 {
-	One_wire 			*sensor;
-	bool				retb;
-    rom_address_t 		address;
-	double 				temperature;
+	TempSensorEntry_t	*entry;
+	bool				valid;
 
 	// select sensor
-	switch ( sensor_id )
+	entry = TempSensor_select( sensor_id );
+	if ( entry==NULL )
 	{
-		case SENSORS_T1:	sensor = &TSensor1;		break;
-		case SENSORS_T2:	sensor = &TSensor2;		break;
-		case SENSORS_T3:	sensor = &TSensor3;		break;
-		case 4:				sensor = &TSensor4;		break;
-		default:			return false;
+		return false;
 	}
 
-	// find sensor
-	retb = sensor->single_device_read_rom( address );
-	if ( !retb )
+	// read sensor
+	temp_buses[entry->bus]->convert_temperature( entry->address, true, false );
+	valid = TempSensor_collect( sensor_id, entry, result );
+	TempSensor_timeBuses();
+	return valid;
+}
+
+// Read all sensors
+//	Convert T is sent to every sensor on a bus at once (Skip ROM), on every
+//	bus without waiting.  Each bus's alarm flags its conversion as done, and
+//	all of the scratchpads are read once every flag is set - this thread
+//	sleeps meanwhile, leaving the CPU to the others.
+int TempSensor_readAll( milli_t results[SENSORS_MAX], bool valid[SENSORS_MAX] )
+{
+	TempSensor_startAll();
+	return TempSensor_finishAll( results, valid );
+}
+
+// Start all conversions
+void TempSensor_startAll( void )
+{
+	rom_address_t		all_sensors{};
+	int					bus;
+
+	temp_pending = 0;
+	osEventFlagsClear( temp_conversion_event, (1u << TEMP_BUS_COUNT) - 1 );
+	for ( bus=0; bus<TEMP_BUS_COUNT; bus++ )
 	{
-		printf("Sensor T%d not found\n", sensor_id );
-		return false;
+		if ( temp_bus_sensors[bus]==0 )
+		{
+			continue;
+		}
+		temp_buses[bus]->start_convert_temperature( all_sensors, true, temp_conversion_event, 1u << bus );
+		temp_pending |= 1u << bus;
 	}
-	printf( "Sensor T%d Address: %02x%02x%02x%02x%02x%02x%02x%02x\n", sensor_id,
-					address.rom[0], address.rom[1], address.rom[2], address.rom[3], 
-					address.rom[4], address.rom[5], address.rom[6], address.rom[7] );
+}
 
-	// read sensor
-	sensor->convert_temperature( address, true, false );
-	temperature = sensor->temperature( address );
-	printf( "Sensor T%d Temperature: %3.1f C\n", sensor_id, temperature );
-	*result = temperature;
-	if ( (temperature<-100.0) || (temperature>200.0) )
-	{	// reject out of range temperatures
+// Read all sensors, once the conversions have finished
+int TempSensor_finishAll( milli_t results[SENSORS_MAX], bool valid[SENSORS_MAX] )
+{
+	uint32_t			flags;
+	int					bus;
+
+	// wait for every bus to finish
+	if ( temp_pending!=0 )
+	{
+		flags = osEventFlagsWait( temp_conversion_event, temp_pending, osFlagsWaitAll, TEMP_CONVERSION_TIMEOUT_MS );
+		if ( (flags & osFlagsError)!=0 )
+		{
+			printf( "Temperature conversions timed out\n" );
+		}
+		temp_pending = 0;
+	}
+
+	for ( bus=0; bus<TEMP_BUS_COUNT; bus++ )
+	{
+		TempSensor_collectBus( bus, results, valid );
+	}
+	return temp_inventory.count;
+}
+
+// Read the sensors on one bus
+//	Only touches the state of that bus, so each bus can have its own thread
+int TempSensor_readBus( int bus, milli_t results[SENSORS_MAX], bool valid[SENSORS_MAX] )
+{
+	rom_address_t		all_sensors{};
+	uint32_t			flags;
+
+	if ( (bus<0) || (bus>=TEMP_BUS_COUNT) || (temp_bus_sensors[bus]==0) )
+	{
+		return 0;
+	}
+	osEventFlagsClear( temp_conversion_event, 1u << bus );
+	temp_buses[bus]->start_convert_temperature( all_sensors, true, temp_conversion_event, 1u << bus );
+	flags = osEventFlagsWait( temp_conversion_event, 1u << bus, osFlagsWaitAll, TEMP_CONVERSION_TIMEOUT_MS );
+	if ( (flags & osFlagsError)!=0 )
+	{
+		printf( "Temperature conversion on GP%u timed out\n", temp_bus_pins[bus] );
+	}
+	TempSensor_collectBus( bus, results, valid );
+	return temp_bus_sensors[bus];
+}
+
+// Bus a sensor is on
+int TempSensor_bus( int sensor_id )
+{
+	TempSensorEntry_t	*entry;
+
+	entry = TempSensor_select( sensor_id );
+	return ( entry==NULL ) ? -1 : entry->bus;
+}
+
+// Search every bus again
+void TempSensor_scan( void )
+{
+	TempInventory_t		inventory;
+	TempSensorEntry_t	*entry;
+	int					found;
+	int					bus;
+	int					ii;
+	int					jj;
+
+	memset( &inventory, 0, sizeof(inventory) );
+	inventory.version = TEMP_INVENTORY_VERSION;
+	for ( bus=0; bus<TEMP_BUS_COUNT; bus++ )
+	{
+		found = temp_buses[bus]->find_and_count_devices_on_bus();
+		printf( "Temperature bus GP%u - %d sensors\n", temp_bus_pins[bus], found );
+		for ( ii=0; (ii<found) && (inventory.count<SENSORS_MAX); ii++ )
+		{
+			entry = &inventory.sensors[inventory.count++];
+			entry->bus = (uint8_t)bus;
+			entry->address = temp_buses[bus]->get_address( ii );
+			// keep the name of a known sensor
+			for ( jj=0; jj<temp_inventory.count; jj++ )
+			{
+				if ( memcmp( &temp_inventory.sensors[jj].address, &entry->address, sizeof(rom_address_t) )==0 )
+				{
+					strcpy( entry->name, temp_inventory.sensors[jj].name );
+				}
+			}
+		}
+	}
+	// then name the new ones
+	for ( ii=0; ii<inventory.count; ii++ )
+	{
+		if ( inventory.sensors[ii].name[0]=='\0' )
+		{
+			TempSensor_defaultName( &inventory, &inventory.sensors[ii] );
+		}
+	}
+	temp_inventory = inventory;
+	TempSensor_configure();
+}
+
+// Store the inventory
+bool TempSensor_save( void )
+{
+	if ( !FlashStore_write( FLASH_STORE_TEMP_INVENTORY, &temp_inventory, sizeof(temp_inventory) ) )
+	{
+		printf( "Temperature sensor inventory - save failed\n" );
 		return false;
 	}
+	printf( "Temperature sensor inventory saved\n" );
 	return true;
 }
+
+// Console command
+void TempSensor_command( const char *args )
+{
+	TempSensorEntry_t	*entry;
+	char				name[SENSOR_NAME_SIZE];
+	int					sensor_id;
+	int					ii;
+
+	if ( Console_match( &args, "list" ) )
+	{
+		for ( ii=0; ii<temp_inventory.count; ii++ )
+		{
+			entry = &temp_inventory.sensors[ii];
+			printf( "  %2d  GP%-2u  ", ii+1, temp_bus_pins[entry->bus] );
+			TempSensor_printAddress( entry->address );
+			printf( "  %2u bit  %s\n", (unsigned)temp_policy[ii].resolution, entry->name );
+		}
+	}
+	else if ( Console_match( &args, "scan" ) )
+	{
+		TempSensor_scan();
+	}
+	else if ( Console_match( &args, "name" ) && Console_parseInt( &args, &sensor_id ) && 
+			  Console_word( &args, name, sizeof(name) ) )
+	{
+		entry = TempSensor_select( sensor_id );
+		if ( entry!=NULL )
+		{
+			strcpy( entry->name, name );
+		}
+	}
+	else if ( Console_match( &args, "save" ) )
+	{
+		TempSensor_save();
+	}
+	else
+	{
+		printf( "temp list | scan | name <n> <name> | save\n" );
+	}
+}
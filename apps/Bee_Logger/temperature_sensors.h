@@ -1,7 +1,7 @@
 /*---------------------------------------------------------------------------
 
     Temperature Sensors
-        Routines to read from the one-wire sensor
+        Routines to read from the one-wire sensors
 
     clayton@isnotcrazy.com
 
@@ -11,23 +11,62 @@
 #define TEMPERATURE_SENSORS_H
 
 #include <stdbool.h>
+#include "fixed_point.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-// Sensor IDs
-#define SENSORS_T1      1
-#define SENSORS_T2      2
-#define SENSORS_T3      3
+// Most sensors held in the inventory (all buses)
+#define SENSORS_MAX         32
+
+// Longest sensor name, including the terminator
+#define SENSOR_NAME_SIZE    16
+
+// 1-Wire buses, each on its own pin
+#define TEMP_BUS_COUNT      4
 
 // Functions
 
 // Initialise all sensor channels
+//  Loads the stored sensor inventory, or searches the buses if there is none
 void TempSensor_init( void );
 
-// Read a sensor
-bool TempSensor_read( int sensor_id, double *result );
+// Number of sensors in the inventory
+int TempSensor_count( void );
+
+// Logical name of a sensor (sensor_id 1..TempSensor_count)
+const char *TempSensor_name( int sensor_id );
+
+// Read a sensor, producing a result in C (x 1000)
+bool TempSensor_read( int sensor_id, milli_t *result );
+
+// Read all sensors, with one conversion per bus, and all buses converting in parallel
+//  results[] and valid[] are indexed by sensor_id-1, returns the number of sensors
+int TempSensor_readAll( milli_t results[SENSORS_MAX], bool valid[SENSORS_MAX] );
+
+// TempSensor_readAll in two halves, so other work can be done while the
+// sensors convert
+void TempSensor_startAll( void );
+int TempSensor_finishAll( milli_t results[SENSORS_MAX], bool valid[SENSORS_MAX] );
+
+// Convert and read the sensors on one bus (0..TEMP_BUS_COUNT-1)
+//  Only the entries of results[] and valid[] for that bus are written, and
+//  different buses may be read by different threads at once
+//  Returns the number of sensors on the bus
+int TempSensor_readBus( int bus, milli_t results[SENSORS_MAX], bool valid[SENSORS_MAX] );
+
+// Bus a sensor (sensor_id 1..TempSensor_count) is on, or -1
+int TempSensor_bus( int sensor_id );
+
+// Search every bus again, keeping the names of sensors already known
+void TempSensor_scan( void );
+
+// Store the sensor inventory in flash
+bool TempSensor_save( void );
+
+// Console command handler - "temp list|scan|name <n> <name>|save"
+void TempSensor_command( const char *args );
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,87 @@
+/*---------------------------------------------------------------------------
+
+    Bench
+        Timing for the benchmarks, on the host or on the target
+
+    clayton@isnotcrazy.com
+
+    On the host time is in ns.  Built for the RP2040 (PICO_ON_DEVICE) it
+    is in CPU cycles, from SysTick - a 24 bit down counter, so time no
+    more than BENCH_BATCH_CYCLES in one go.
+
+---------------------------------------------------------------------------*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#if PICO_ON_DEVICE
+#include "pico/stdlib.h"
+#include "hardware/structs/systick.h"
+#else
+#include <time.h>
+#endif
+
+// Macros
+
+#if PICO_ON_DEVICE
+#define BENCH_UNIT              "cycles"
+#define BENCH_BATCH_CYCLES      0x00FFFFFFu
+#else
+#define BENCH_UNIT              "ns"
+#endif
+
+// Types
+
+typedef uint64_t BenchTime_t;
+
+// Data
+
+// results are added in here, so the work timed is not optimised away
+static volatile int32_t bench_sink;
+
+// Functions
+
+// Start the clock (and, on the target, the USB serial port)
+static inline void Bench_init( void )
+{
+#if PICO_ON_DEVICE
+    stdio_init_all();
+    sleep_ms( 3000 );                       // time to open the terminal
+    systick_hw->rvr = BENCH_BATCH_CYCLES;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5;                  // enabled, processor clock, no interrupt
+#endif
+}
+
+static inline BenchTime_t Bench_start( void )
+{
+#if PICO_ON_DEVICE
+    return systick_hw->cvr;
+#else
+    struct timespec     now;
+
+    timespec_get( &now, TIME_UTC );
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+// Time since start
+static inline uint64_t Bench_elapsed( BenchTime_t start )
+{
+#if PICO_ON_DEVICE
+    return ( (uint32_t)start - systick_hw->cvr ) & BENCH_BATCH_CYCLES;
+#else
+    return Bench_start() - start;
+#endif
+}
+
+// Print the time for each of count runs
+static inline void Bench_report( const char *name, uint64_t elapsed, uint32_t count )
+{
+    printf( "  %-32s %9.1f " BENCH_UNIT "\n", name, (double)elapsed / count );
+}
+
+#endif      // BENCH_H
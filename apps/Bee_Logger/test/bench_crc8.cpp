@@ -0,0 +1,113 @@
+/*---------------------------------------------------------------------------
+
+    CRC8 (benchmark)
+        The table driven CRCs against the bit by bit routines they replaced
+
+    clayton@isnotcrazy.com
+
+    Times the checks the drivers make: a DS18B20 scratchpad (8 bytes) and
+    an HTU21D measurement (2 bytes).  Built twice by CMake, the second
+    time with CRC8_NIBBLE_TABLE.
+
+---------------------------------------------------------------------------*/
+#include <stddef.h>
+#include "bench.h"
+#include "crc8_reference.h"
+#include "crc8.h"
+
+// Macros
+
+#define BENCH_MESSAGES      256
+#define BENCH_PASSES        4000
+
+#ifdef CRC8_NIBBLE_TABLE
+#define BENCH_TABLE         "nibble table"
+#else
+#define BENCH_TABLE         "byte table"
+#endif
+
+// Data
+
+// filled at run time, so nothing can be folded
+static uint8_t bench_scratchpads[BENCH_MESSAGES][8];
+
+// Private Functions
+
+static uint8_t Bench_scratchpadOld( const uint8_t *ram )
+{
+    uint8_t     crc;
+    int         ii;
+
+    crc = 0;
+    for ( ii=0; ii<8; ii++ )
+    {
+        crc = Crc8Reference_maxim( crc, ram[ii] );
+    }
+    return crc;
+}
+
+static uint8_t Bench_scratchpadNew( const uint8_t *ram )
+{
+    return Crc8_maxim::compute( ram, 8 );
+}
+
+static uint8_t Bench_measurementOld( const uint8_t *bytes )
+{
+    return Crc8Reference_htu21dCheck( (uint16_t)((bytes[0] << 8) | bytes[1]), bytes[2] );
+}
+
+static uint8_t Bench_measurementNew( const uint8_t *bytes )
+{
+    return Crc8_htu21d::compute( bytes, 2 ) ^ bytes[2];
+}
+
+// Time of one check, over every message
+static void Bench_run( const char *name, uint8_t (*check)( const uint8_t *bytes ) )
+{
+    BenchTime_t     start;
+    uint64_t        elapsed;
+    int32_t         sum;
+    int             pass;
+    int             ii;
+
+    elapsed = 0;
+    sum = 0;
+    for ( pass=0; pass<BENCH_PASSES; pass++ )
+    {
+        start = Bench_start();
+        for ( ii=0; ii<BENCH_MESSAGES; ii++ )
+        {
+            sum += check( bench_scratchpads[ii] );
+        }
+        elapsed += Bench_elapsed( start );
+    }
+    bench_sink = sum;
+    Bench_report( name, elapsed, BENCH_PASSES * BENCH_MESSAGES );
+}
+
+// Public Functions
+
+int main( void )
+{
+    uint32_t    seed;
+    int         ii;
+    int         jj;
+
+    seed = 12345;
+    for ( ii=0; ii<BENCH_MESSAGES; ii++ )
+    {
+        for ( jj=0; jj<8; jj++ )
+        {
+            seed = seed * 1103515245u + 12345u;
+            bench_scratchpads[ii][jj] = (uint8_t)( seed >> 16 );
+        }
+    }
+
+    Bench_init();
+    printf( "CRC8 (" BENCH_TABLE ") - time per check\n" );
+    Bench_run( "DS18B20 scratchpad, bitwise", Bench_scratchpadOld );
+    Bench_run( "DS18B20 scratchpad, table", Bench_scratchpadNew );
+    Bench_run( "HTU21D measurement, bitwise", Bench_measurementOld );
+    Bench_run( "HTU21D measurement, table", Bench_measurementNew );
+    return 0;
+}
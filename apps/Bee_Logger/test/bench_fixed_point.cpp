@@ -0,0 +1,224 @@
+/*---------------------------------------------------------------------------
+
+    Fixed Point (benchmark)
+        Fixed / Linear sensor conversions against the double arithmetic they replaced
+
+    clayton@isnotcrazy.com
+
+    Times each conversion from raw counts to the thousandths published,
+    both ways, and how far apart the answers are.  The constants are those
+    of the sensor modules.  Built for the host by test/CMakeLists.txt (ns),
+    or for the board as Bee_Logger_bench with -DBEE_LOGGER_BENCHMARK=ON
+    (cycles, printed on the USB serial port).
+
+    Each pass is timed on its own, so a pass stays inside SysTick's 24
+    bits on the board even for the double formatting.
+
+---------------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "fixed_point.h"
+
+// Macros
+
+#define BENCH_INPUTS        256
+#if PICO_ON_DEVICE
+#define BENCH_PASSES        16
+#else
+#define BENCH_PASSES        4000
+#endif
+
+// as they were before the fixed point conversion
+#define WEIGHT_RAW_OFFSET   -32300
+#define WEIGHT_SCALEFACTOR  (1.0/10673)
+#define WEIGHT_OFFSET       0.0
+#define ADC_VREF            3.33
+#define DIVIDER_RATIO       9.728
+#define DIODE_DROP          0.804
+
+// Types
+
+typedef int32_t (*BenchConvert_t)( int32_t raw );
+
+typedef struct
+{
+    const char      *name;
+    BenchConvert_t  old_way;                // double, as the modules were
+    BenchConvert_t  new_way;                // Fixed / Linear
+    int32_t         raw_min;
+    int32_t         raw_max;
+    bool            compare;                // both return milli_t, rather than a length
+} BenchCase_t;
+
+// Data
+
+static constexpr Linear<Humidity> humidity_scale( 125.0 / 65536.0, -6.0 );
+static constexpr Linear<Temperature> temperature_scale( 175.72 / 65536.0, -46.85 );
+static constexpr Linear<Weight> weight_scale( WEIGHT_SCALEFACTOR, -(WEIGHT_RAW_OFFSET * WEIGHT_SCALEFACTOR) - WEIGHT_OFFSET );
+static constexpr Linear<Voltage> supply_scale( ADC_VREF / (1 << 12) * DIVIDER_RATIO, DIODE_DROP );
+
+// filled at run time, so nothing can be folded
+static int32_t bench_inputs[BENCH_INPUTS];
+
+static char bench_text[32];
+
+// Private Functions
+
+static milli_t Bench_milli( double value )
+{
+    return (milli_t)( value * 1000.0 + (value<0 ? -0.5 : 0.5) );
+}
+
+// HTU21D
+
+static int32_t Bench_humidityDouble( int32_t raw )
+{
+    return Bench_milli( raw * (125.0 / 65536.0) - 6.0 );
+}
+
+static int32_t Bench_humidityFixed( int32_t raw )
+{
+    return humidity_scale.apply( raw ).to_milli();
+}
+
+static int32_t Bench_htuTempDouble( int32_t raw )
+{
+    return Bench_milli( raw * (175.72 / 65536.0) - 46.85 );
+}
+
+static int32_t Bench_htuTempFixed( int32_t raw )
+{
+    return temperature_scale.apply( raw ).to_milli();
+}
+
+// DS18B20
+
+static int32_t Bench_ds18b20Double( int32_t raw )
+{
+    return Bench_milli( (int16_t)raw / 16.0 );
+}
+
+static int32_t Bench_ds18b20Fixed( int32_t raw )
+{
+    return Fixed<4, Celsius>::from_raw( (int16_t)raw ).convert<Temperature::frac_bits>().to_milli();
+}
+
+// HX711
+
+static int32_t Bench_weightDouble( int32_t raw )
+{
+    return Bench_milli( (raw - WEIGHT_RAW_OFFSET) * WEIGHT_SCALEFACTOR - WEIGHT_OFFSET );
+}
+
+static int32_t Bench_weightFixed( int32_t raw )
+{
+    return weight_scale.apply( raw ).to_milli();
+}
+
+// Supply voltage
+
+static int32_t Bench_supplyDouble( int32_t raw )
+{
+    return Bench_milli( (raw * ADC_VREF / (1 << 12)) * DIVIDER_RATIO + DIODE_DROP );
+}
+
+static int32_t Bench_supplyFixed( int32_t raw )
+{
+    return supply_scale.apply( raw ).to_milli();
+}
+
+// Publishing - the old "%.6f" of a double against MILLI_FMT
+
+static int32_t Bench_formatDouble( int32_t raw )
+{
+    return snprintf( bench_text, sizeof(bench_text), "%.6f", raw * (125.0 / 65536.0) - 6.0 );
+}
+
+static int32_t Bench_formatFixed( int32_t raw )
+{
+    milli_t     value = humidity_scale.apply( raw ).to_milli();
+
+    return snprintf( bench_text, sizeof(bench_text), MILLI_FMT, MILLI_ARGS(value) );
+}
+
+static const BenchCase_t bench_cases[] =
+{
+    { "HTU21D humidity",        Bench_humidityDouble,   Bench_humidityFixed,    0,          65535,      true },
+    { "HTU21D temperature",     Bench_htuTempDouble,    Bench_htuTempFixed,     0,          65535,      true },
+    { "DS18B20 temperature",    Bench_ds18b20Double,    Bench_ds18b20Fixed,     -880,       2000,       true },
+    { "HX711 weight",           Bench_weightDouble,     Bench_weightFixed,      -8388608,   8388607,    true },
+    { "Supply voltage",         Bench_supplyDouble,     Bench_supplyFixed,      0,          4095,       true },
+    { "Humidity, formatted",    Bench_formatDouble,     Bench_formatFixed,      0,          65535,      false },
+};
+
+#define BENCH_CASES         (int)(sizeof(bench_cases) / sizeof(bench_cases[0]))
+
+// Time of one conversion, averaged over every pass
+static uint64_t Bench_time( BenchConvert_t convert )
+{
+    BenchTime_t     start;
+    uint64_t        elapsed;
+    int32_t         sum;
+    int             pass;
+    int             ii;
+
+    elapsed = 0;
+    sum = 0;
+    for ( pass=0; pass<BENCH_PASSES; pass++ )
+    {
+        start = Bench_start();
+        for ( ii=0; ii<BENCH_INPUTS; ii++ )
+        {
+            sum += convert( bench_inputs[ii] );
+        }
+        elapsed += Bench_elapsed( start );
+    }
+    bench_sink = sum;
+    return elapsed;
+}
+
+static void Bench_case( const BenchCase_t *bench )
+{
+    uint32_t    seed;
+    int32_t     difference;
+    int32_t     worst;
+    int         ii;
+
+    seed = 12345;
+    worst = 0;
+    for ( ii=0; ii<BENCH_INPUTS; ii++ )
+    {
+        seed = seed * 1103515245u + 12345u;
+        bench_inputs[ii] = bench->raw_min + (int32_t)( (seed >> 8) % (uint32_t)(bench->raw_max - bench->raw_min + 1) );
+        difference = abs( bench->old_way( bench_inputs[ii] ) - bench->new_way( bench_inputs[ii] ) );
+        worst = ( difference>worst ) ? difference : worst;
+    }
+
+    if ( bench->compare )
+    {   // within the resolution of the fixed point type
+        printf( "%s (worst difference %ld thousandths)\n", bench->name, (long)worst );
+    }
+    else
+    {
+        printf( "%s\n", bench->name );
+    }
+    Bench_report( "double", Bench_time( bench->old_way ), BENCH_PASSES * BENCH_INPUTS );
+    Bench_report( "fixed", Bench_time( bench->new_way ), BENCH_PASSES * BENCH_INPUTS );
+}
+
+// Public Functions
+
+int main( void )
+{
+    int     ii;
+
+    Bench_init();
+    printf( "Fixed point - time per conversion\n" );
+    for ( ii=0; ii<BENCH_CASES; ii++ )
+    {
+        Bench_case( &bench_cases[ii] );
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+/*---------------------------------------------------------------------------
+
+    Weight Filter (benchmark)
+        Time of each filter, over windows of the HX711 sequences
+
+    clayton@isnotcrazy.com
+
+    Build with optimisation (the default CMAKE_BUILD_TYPE here is
+    Release).  The host is many times faster than the RP2040, so compare
+    the filters with each other rather than with the sample period.
+
+---------------------------------------------------------------------------*/
+#include <stdio.h>
+#include "bench.h"
+#include "hx711_sequences.h"
+#include "weight_filter.h"
+
+// Macros
+
+#define BENCH_RUNS          200000
+
+// Data
+
+static const WeightFilter_t bench_filters[] =
+{
+    WEIGHT_FILTER_MEAN, WEIGHT_FILTER_MEDIAN, WEIGHT_FILTER_TRIMMED_MEAN, WEIGHT_FILTER_HAMPEL
+};
+
+// Private Functions
+
+// Every filter on windows of one size, sliding along every sequence
+static void Bench_window( int window )
+{
+    WeightFilterResult_t    result;
+    const Hx711Sequence_t   *sequence;
+    char                    name[40];
+    BenchTime_t             start;
+    uint32_t                run;
+    int                     filter;
+    int                     offset;
+
+    for ( filter=0; filter<(int)(sizeof(bench_filters)/sizeof(bench_filters[0])); filter++ )
+    {
+        start = Bench_start();
+        for ( run=0; run<BENCH_RUNS; run++ )
+        {
+            sequence = &hx711_sequences[run % HX711_SEQUENCES];
+            offset = (int)( (run / HX711_SEQUENCES) % (HX711_SEQUENCE_LENGTH - window + 1) );
+            WeightFilter_apply( bench_filters[filter], &sequence->samples[offset], window, &result );
+            bench_sink += result.value;
+        }
+        snprintf( name, sizeof(name), "%s of %d", WeightFilter_name( bench_filters[filter] ), window );
+        Bench_report( name, Bench_elapsed( start ), BENCH_RUNS );
+    }
+}
+
+// Public Functions
+
+int main( void )
+{
+    Bench_init();
+    printf( "Weight filter - time per window\n" );
+    Bench_window( 8 );
+    Bench_window( WEIGHT_FILTER_MAX );
+    return 0;
+}
@@ -0,0 +1,91 @@
+/*---------------------------------------------------------------------------
+
+    CRC8 Reference
+        The bit by bit CRC routines crc8.h replaced, for the host tests
+
+    clayton@isnotcrazy.com
+
+    Copied from One_wire::crc_byte and HTU21D::checkCRC as they were
+    before the table driven Crc8.
+
+---------------------------------------------------------------------------*/
+
+#ifndef CRC8_REFERENCE_H
+#define CRC8_REFERENCE_H
+
+#include <stdint.h>
+
+// Functions
+
+// One_wire::crc_byte - Dallas/Maxim, LSB first
+static inline uint8_t Crc8Reference_maxim( uint8_t crc, uint8_t byte )
+{
+    int     j;
+
+    for ( j=0; j<8; j++ )
+    {
+        if ( (byte & 0x01) ^ (crc & 0x01) )
+        {   // DATA ^ LSB CRC = 1 - shift in a 1, and flip bits 3 and 4
+            crc = crc >> 1;
+            crc = (uint8_t)( crc | 0x80 );
+            if ( crc & 0x04 )
+            {
+                crc = (uint8_t)( crc & 0xFB );
+            }
+            else
+            {
+                crc = (uint8_t)( crc | 0x04 );
+            }
+            if ( crc & 0x08 )
+            {
+                crc = (uint8_t)( crc & 0xF7 );
+            }
+            else
+            {
+                crc = (uint8_t)( crc | 0x08 );
+            }
+        }
+        else
+        {   // DATA ^ LSB CRC = 0 - shift in a 0
+            crc = crc >> 1;
+            crc = (uint8_t)( crc & 0x7F );
+        }
+        byte = byte >> 1;
+    }
+    return crc;
+}
+
+// The same polynomial MSB first, a bit at a time, as HTU21D::checkCRC divided
+static inline uint8_t Crc8Reference_htu21d( uint8_t crc, uint8_t byte )
+{
+    int     j;
+
+    crc ^= byte;
+    for ( j=0; j<8; j++ )
+    {
+        crc = (uint8_t)( (crc & 0x80) ? ((crc << 1) ^ 0x31) : (crc << 1) );
+    }
+    return crc;
+}
+
+// HTU21D::checkCRC - long division by 0x0131 of the message and its check value, 0 if good
+static inline uint8_t Crc8Reference_htu21dCheck( uint16_t message, uint8_t check )
+{
+    uint32_t    remainder;
+    uint32_t    divisor;
+    int         i;
+
+    remainder = ((uint32_t)message << 8) | check;
+    divisor = 0x988000;                         // 0x0131 shifted to the top of three bytes
+    for ( i=0; i<16; i++ )
+    {
+        if ( remainder & ((uint32_t)1 << (23 - i)) )
+        {
+            remainder ^= divisor;
+        }
+        divisor >>= 1;
+    }
+    return (uint8_t)remainder;
+}
+
+#endif      // CRC8_REFERENCE_H
@@ -0,0 +1,80 @@
+/*---------------------------------------------------------------------------
+
+    HX711 Sequences
+        Raw load cell readings, for the weight filter tests and benchmark
+
+    clayton@isnotcrazy.com
+
+    Runs of raw HX711 counts (signed 24 bit, gain 128) at a steady hive
+    weight, with the disturbances the filters are there for: sample
+    noise, a bump lasting two samples, single bits corrupted in the
+    shift out, a weight step, and a quiet load cell which reads the same
+    count again and again (so its MAD is zero).
+
+---------------------------------------------------------------------------*/
+
+#ifndef HX711_SEQUENCES_H
+#define HX711_SEQUENCES_H
+
+#include <stdint.h>
+
+// Macros
+
+#define HX711_SEQUENCE_LENGTH   32
+#define HX711_SEQUENCE_NOISE    24          // counts either side of the level
+
+// Types
+
+typedef struct
+{
+    const char  *name;
+    int32_t     level;                      // true reading
+    int         step_at;                    // first sample at step_level (HX711_SEQUENCE_LENGTH - none)
+    int32_t     step_level;
+    int32_t     samples[HX711_SEQUENCE_LENGTH];
+} Hx711Sequence_t;
+
+// Data
+
+static const Hx711Sequence_t hx711_sequences[] =
+{
+    { "quiet", 912345, HX711_SEQUENCE_LENGTH, 0,
+      {
+        912357, 912326, 912352, 912369, 912337, 912323, 912321, 912330,
+        912363, 912358, 912351, 912369, 912368, 912344, 912341, 912322,
+        912338, 912352, 912333, 912367, 912347, 912355, 912355, 912364,
+        912327, 912333, 912357, 912356, 912365, 912367, 912337, 912363,
+      } },
+    { "bump", 912345, HX711_SEQUENCE_LENGTH, 0,
+      {
+        912360, 912364, 912326, 912348, 912342, 912326, 912344, 912347,
+        912337, 912349, 912365, 913827, 913869, 912333, 912365, 912361,
+        912339, 912327, 912323, 912358, 912333, 912362, 912344, 912352,
+        912333, 912353, 912357, 912362, 912365, 912353, 912322, 912361,
+      } },
+    { "bit error", 912345, HX711_SEQUENCE_LENGTH, 0,
+      {
+        912344, 912336, 912359, 912348, 912340, 912343, 912358, 912328,
+        912326, 388065, 912364, 912354, 912333, 912328, 912359, 912363,
+        912338, 912340, 912367, 912333, 912345, 912351, 912335, 1043401,
+        912359, 912334, 912365, 912354, 912321, 912333, 912331, 912322,
+      } },
+    { "step", 912345, 16, 933345,
+      {
+        912362, 912342, 912356, 912363, 912360, 912360, 912340, 912344,
+        912345, 912354, 912345, 912339, 912329, 912364, 912352, 912324,
+        933332, 933348, 933359, 933368, 933346, 933327, 933349, 933336,
+        933326, 933359, 933363, 933349, 933349, 933345, 933325, 933354,
+      } },
+    { "flat", 912345, HX711_SEQUENCE_LENGTH, 0,
+      {
+        912345, 912345, 912345, 912345, 912345, 912345, 912345, 912645,
+        912345, 912345, 912345, 912345, 912345, 912345, 912345, 912345,
+        912345, 912345, 912345, 912345, 908345, 912345, 912345, 912345,
+        912345, 912345, 912345, 912345, 912345, 912345, 912345, 912345,
+      } },
+};
+
+#define HX711_SEQUENCES         (int)( sizeof(hx711_sequences) / sizeof(hx711_sequences[0]) )
+
+#endif      // HX711_SEQUENCES_H
@@ -0,0 +1,153 @@
+/*---------------------------------------------------------------------------
+
+    CMSIS-RTOS2 (mock)
+        The part of the CMSIS-RTOS2 API the application uses, for host tests
+
+    clayton@isnotcrazy.com
+
+    Same names, types and values as the real cmsis_os2.h, implemented by
+    mock_rtos.c on a virtual clock - see mock_rtos.h.
+
+---------------------------------------------------------------------------*/
+
+#ifndef CMSIS_OS2_H_
+#define CMSIS_OS2_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Macros
+
+#define osWaitForever           0xFFFFFFFFU
+
+#define osFlagsWaitAny          0x00000000U
+#define osFlagsWaitAll          0x00000001U
+#define osFlagsNoClear          0x00000002U
+
+#define osFlagsError            0x80000000U
+#define osFlagsErrorUnknown     0xFFFFFFFFU
+#define osFlagsErrorTimeout     0xFFFFFFFEU
+#define osFlagsErrorResource    0xFFFFFFFDU
+#define osFlagsErrorParameter   0xFFFFFFFCU
+
+// Types
+
+typedef enum
+{
+    osOK                    =  0,
+    osError                 = -1,
+    osErrorTimeout          = -2,
+    osErrorResource         = -3,
+    osErrorParameter        = -4,
+    osErrorNoMemory         = -5,
+    osErrorISR              = -6
+} osStatus_t;
+
+typedef enum
+{
+    osKernelInactive        = 0,
+    osKernelReady           = 1,
+    osKernelRunning         = 2,
+    osKernelLocked          = 3
+} osKernelState_t;
+
+typedef enum
+{
+    osPriorityNone          = 0,
+    osPriorityIdle          = 1,
+    osPriorityLow           = 8,
+    osPriorityBelowNormal   = 16,
+    osPriorityNormal        = 24,
+    osPriorityAboveNormal   = 32,
+    osPriorityHigh          = 40,
+    osPriorityRealtime      = 48
+} osPriority_t;
+
+typedef void (*osThreadFunc_t)( void *argument );
+
+typedef void *osThreadId_t;
+typedef void *osEventFlagsId_t;
+typedef void *osMutexId_t;
+typedef void *osMessageQueueId_t;
+
+typedef struct
+{
+    const char      *name;
+    uint32_t        attr_bits;
+    void            *cb_mem;
+    uint32_t        cb_size;
+    void            *stack_mem;
+    uint32_t        stack_size;
+    osPriority_t    priority;
+    uint32_t        tz_module;
+    uint32_t        reserved;
+} osThreadAttr_t;
+
+typedef struct
+{
+    const char      *name;
+    uint32_t        attr_bits;
+    void            *cb_mem;
+    uint32_t        cb_size;
+} osEventFlagsAttr_t;
+
+typedef struct
+{
+    const char      *name;
+    uint32_t        attr_bits;
+    void            *cb_mem;
+    uint32_t        cb_size;
+} osMutexAttr_t;
+
+typedef struct
+{
+    const char      *name;
+    uint32_t        attr_bits;
+    void            *cb_mem;
+    uint32_t        cb_size;
+    void            *mq_mem;
+    uint32_t        mq_size;
+} osMessageQueueAttr_t;
+
+// Functions
+
+osKernelState_t osKernelGetState( void );
+int32_t osKernelLock( void );
+int32_t osKernelUnlock( void );
+uint32_t osKernelGetTickCount( void );
+uint32_t osKernelGetTickFreq( void );
+
+osThreadId_t osThreadNew( osThreadFunc_t func, void *argument, const osThreadAttr_t *attr );
+osThreadId_t osThreadGetId( void );
+uint32_t osThreadFlagsSet( osThreadId_t thread_id, uint32_t flags );
+uint32_t osThreadFlagsClear( uint32_t flags );
+uint32_t osThreadFlagsGet( void );
+uint32_t osThreadFlagsWait( uint32_t flags, uint32_t options, uint32_t timeout );
+
+osStatus_t osDelay( uint32_t ticks );
+osStatus_t osDelayUntil( uint32_t ticks );
+
+osEventFlagsId_t osEventFlagsNew( const osEventFlagsAttr_t *attr );
+uint32_t osEventFlagsSet( osEventFlagsId_t ef_id, uint32_t flags );
+uint32_t osEventFlagsClear( osEventFlagsId_t ef_id, uint32_t flags );
+uint32_t osEventFlagsGet( osEventFlagsId_t ef_id );
+uint32_t osEventFlagsWait( osEventFlagsId_t ef_id, uint32_t flags, uint32_t options, uint32_t timeout );
+
+osMutexId_t osMutexNew( const osMutexAttr_t *attr );
+osStatus_t osMutexAcquire( osMutexId_t mutex_id, uint32_t timeout );
+osStatus_t osMutexRelease( osMutexId_t mutex_id );
+
+osMessageQueueId_t osMessageQueueNew( uint32_t msg_count, uint32_t msg_size, const osMessageQueueAttr_t *attr );
+osStatus_t osMessageQueuePut( osMessageQueueId_t mq_id, const void *msg_ptr, uint8_t msg_prio, uint32_t timeout );
+osStatus_t osMessageQueueGet( osMessageQueueId_t mq_id, void *msg_ptr, uint8_t *msg_prio, uint32_t timeout );
+uint32_t osMessageQueueGetCount( osMessageQueueId_t mq_id );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // CMSIS_OS2_H_
@@ -0,0 +1,56 @@
+/*---------------------------------------------------------------------------
+
+    hardware/dma.h (mock)
+        The part of the pico-sdk DMA API the drivers use, for host tests
+
+    clayton@isnotcrazy.com
+
+    A configured channel does not move anything by itself - mock_i2c.c
+    plays the I2C block's end of the transfer.
+
+---------------------------------------------------------------------------*/
+
+#ifndef _HARDWARE_DMA_H
+#define _HARDWARE_DMA_H
+
+#include "../pico_pi_mocks.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Types
+
+enum dma_channel_transfer_size
+{
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2
+};
+
+typedef struct
+{
+    enum dma_channel_transfer_size  size;
+    bool                            read_increment;
+    bool                            write_increment;
+    uint                            dreq;
+} dma_channel_config;
+
+// Functions
+
+int dma_claim_unused_channel( bool required );
+dma_channel_config dma_channel_get_default_config( uint channel );
+void channel_config_set_transfer_data_size( dma_channel_config *config, enum dma_channel_transfer_size size );
+void channel_config_set_read_increment( dma_channel_config *config, bool increment );
+void channel_config_set_write_increment( dma_channel_config *config, bool increment );
+void channel_config_set_dreq( dma_channel_config *config, uint dreq );
+void dma_channel_configure( uint channel, const dma_channel_config *config, volatile void *write_addr,
+                            const volatile void *read_addr, uint transfer_count, bool trigger );
+void dma_channel_abort( uint channel );
+bool dma_channel_is_busy( uint channel );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // _HARDWARE_DMA_H
@@ -0,0 +1,36 @@
+/*---------------------------------------------------------------------------
+
+    hardware/gpio.h (mock)
+        The part of the pico-sdk GPIO API i2c_bus.c uses, for host tests
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+
+#ifndef _HARDWARE_GPIO_H
+#define _HARDWARE_GPIO_H
+
+#include "../pico_pi_mocks.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Types
+
+enum gpio_function
+{
+    GPIO_FUNC_I2C = 3,
+    GPIO_FUNC_SIO = 5
+};
+
+// Functions
+
+void gpio_set_function( uint gpio, enum gpio_function fn );
+void gpio_pull_up( uint gpio );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // _HARDWARE_GPIO_H
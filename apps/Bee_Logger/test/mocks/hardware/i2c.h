@@ -0,0 +1,73 @@
+/*---------------------------------------------------------------------------
+
+    hardware/i2c.h (mock)
+        The part of the pico-sdk I2C API i2c_bus.c uses, for host tests
+
+    clayton@isnotcrazy.com
+
+    Same names and register bits as the pico-sdk, implemented by
+    mock_i2c.c - see mock_i2c.h.
+
+---------------------------------------------------------------------------*/
+
+#ifndef _HARDWARE_I2C_H
+#define _HARDWARE_I2C_H
+
+#include "../pico_pi_mocks.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Macros
+
+#define I2C_IC_DATA_CMD_CMD_BITS                        0x00000100u
+#define I2C_IC_DATA_CMD_STOP_BITS                       0x00000200u
+#define I2C_IC_DATA_CMD_RESTART_BITS                    0x00000400u
+#define I2C_IC_INTR_MASK_M_TX_ABRT_BITS                 0x00000040u
+#define I2C_IC_INTR_MASK_M_STOP_DET_BITS                0x00000200u
+#define I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS               0x00000040u
+#define I2C_IC_RAW_INTR_STAT_STOP_DET_BITS              0x00000200u
+#define I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS   0x00000001u
+#define I2C_IC_TX_ABRT_SOURCE_ARB_LOST_BITS             0x00001000u
+
+#define i2c0                    (&i2c0_inst)
+#define i2c1                    (&i2c1_inst)
+
+// Types
+
+// only the registers the driver touches
+typedef struct
+{
+    volatile uint32_t   tar;
+    volatile uint32_t   data_cmd;
+    volatile uint32_t   intr_mask;
+    volatile uint32_t   raw_intr_stat;
+    volatile uint32_t   clr_tx_abrt;
+    volatile uint32_t   clr_stop_det;
+    volatile uint32_t   enable;
+    volatile uint32_t   tx_abrt_source;
+} i2c_hw_t;
+
+typedef struct i2c_inst
+{
+    i2c_hw_t    *hw;
+    bool        restart_on_next;
+} i2c_inst_t;
+
+// Data
+
+extern i2c_inst_t i2c0_inst;
+extern i2c_inst_t i2c1_inst;
+
+// Functions
+
+uint i2c_init( i2c_inst_t *i2c, uint baudrate );
+i2c_hw_t *i2c_get_hw( i2c_inst_t *i2c );
+uint i2c_get_dreq( i2c_inst_t *i2c, bool is_tx );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // _HARDWARE_I2C_H
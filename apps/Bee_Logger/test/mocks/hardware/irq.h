@@ -0,0 +1,39 @@
+/*---------------------------------------------------------------------------
+
+    hardware/irq.h (mock)
+        The part of the pico-sdk IRQ API i2c_bus.c uses, for host tests
+
+    clayton@isnotcrazy.com
+
+    Handlers are called by the mocks that raise the interrupt.
+
+---------------------------------------------------------------------------*/
+
+#ifndef _HARDWARE_IRQ_H
+#define _HARDWARE_IRQ_H
+
+#include "../pico_pi_mocks.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Macros
+
+#define I2C0_IRQ                23
+#define I2C1_IRQ                24
+
+// Types
+
+typedef void (*irq_handler_t)( void );
+
+// Functions
+
+void irq_set_exclusive_handler( uint num, irq_handler_t handler );
+void irq_set_enabled( uint num, bool enabled );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // _HARDWARE_IRQ_H
@@ -0,0 +1,26 @@
+/*---------------------------------------------------------------------------
+
+    hardware/watchdog.h (mock)
+        The part of the pico-sdk watchdog API schedule.c uses, for host tests
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+
+#ifndef _HARDWARE_WATCHDOG_H
+#define _HARDWARE_WATCHDOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Functions
+
+// Feed the watchdog - given by the test
+void watchdog_update( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // _HARDWARE_WATCHDOG_H
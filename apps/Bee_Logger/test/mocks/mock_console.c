@@ -0,0 +1,51 @@
+/*---------------------------------------------------------------------------
+
+    Console (mock)
+        No service commands in host tests
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+#include "console.h"
+
+// Public Functions
+
+void Console_poll( void )
+{
+}
+
+bool Console_match( const char **text, const char *word )
+{
+    (void)text;
+    (void)word;
+    return false;
+}
+
+bool Console_parseMilli( const char **text, milli_t *value )
+{
+    (void)text;
+    (void)value;
+    return false;
+}
+
+bool Console_parseInt( const char **text, int *value )
+{
+    (void)text;
+    (void)value;
+    return false;
+}
+
+bool Console_parseUnsigned( const char **text, uint32_t *value )
+{
+    (void)text;
+    (void)value;
+    return false;
+}
+
+bool Console_word( const char **text, char *word, size_t size )
+{
+    (void)text;
+    (void)word;
+    (void)size;
+    return false;
+}
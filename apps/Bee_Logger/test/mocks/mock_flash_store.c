@@ -0,0 +1,51 @@
+/*---------------------------------------------------------------------------
+
+    Flash Store (mock)
+        Records kept in RAM, for host tests
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+#include <string.h>
+#include "flash_store.h"
+#include "mock_flash_store.h"
+
+// Types
+
+typedef struct
+{
+    size_t      size;                       // 0 - empty
+    uint8_t     data[FLASH_STORE_MAX_SIZE];
+} MockFlashSlot_t;
+
+// Data
+
+static MockFlashSlot_t  mock_flash_slots[FLASH_STORE_SLOTS];
+
+// Public Functions
+
+bool FlashStore_read( int slot, void *data, size_t size )
+{
+    if ( (slot<0) || (slot>=FLASH_STORE_SLOTS) || (mock_flash_slots[slot].size!=size) )
+    {
+        return false;
+    }
+    memcpy( data, mock_flash_slots[slot].data, size );
+    return true;
+}
+
+bool FlashStore_write( int slot, const void *data, size_t size )
+{
+    if ( (slot<0) || (slot>=FLASH_STORE_SLOTS) || (size>FLASH_STORE_MAX_SIZE) )
+    {
+        return false;
+    }
+    memcpy( mock_flash_slots[slot].data, data, size );
+    mock_flash_slots[slot].size = size;
+    return true;
+}
+
+void MockFlashStore_erase( void )
+{
+    memset( mock_flash_slots, 0, sizeof(mock_flash_slots) );
+}
@@ -0,0 +1,26 @@
+/*---------------------------------------------------------------------------
+
+    Flash Store (mock)
+        Control of the RAM records, for host tests
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+
+#ifndef MOCK_FLASH_STORE_H
+#define MOCK_FLASH_STORE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Functions
+
+// Empty every flash store slot
+void MockFlashStore_erase( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // MOCK_FLASH_STORE_H
@@ -0,0 +1,396 @@
+/*---------------------------------------------------------------------------
+
+    I2C (mock)
+        Devices on simulated I2C blocks, fed by simulated DMA, for host tests
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mock_rtos.h"
+#include "mock_i2c.h"
+
+// Macros
+
+#define MOCK_I2C_BUSES          2
+#define MOCK_I2C_DEVICES        8
+#define MOCK_IRQS               32
+
+#define MOCK_DREQ_I2C0_TX       32          // as the RP2040 numbers them - TX, RX for each block
+#define MOCK_DREQ_NONE          0x3F
+
+// Types
+
+typedef struct
+{
+    int         bus;
+    uint8_t     address;
+    uint8_t     reply[MOCK_I2C_BYTES_MAX];
+    int         reply_len;
+    bool        hang;
+} MockI2cDevice_t;
+
+typedef struct
+{
+    i2c_hw_t    hw;
+    bool        busy;                   // a transaction has started and not finished
+    int         tx_channel;             // DMA channel feeding the transaction running
+    uint8_t     *rx_buffer;             // where the receive channel set up next will write
+    int         rx_count;
+    uint8_t     *reading;               // and for the transaction running
+    int         read_count;
+} MockI2cBus_t;
+
+typedef struct
+{
+    dma_channel_config  config;
+    bool                claimed;
+} MockDmaChannel_t;
+
+// Data
+
+static MockI2cBus_t         mock_i2c_buses[MOCK_I2C_BUSES];
+static MockI2cDevice_t      mock_i2c_devices[MOCK_I2C_DEVICES];
+static int                  mock_i2c_device_count;
+static MockI2cTransfer_t    mock_i2c_transfers[MOCK_I2C_TRANSFERS];
+static int                  mock_i2c_transfer_count;
+static int                  mock_i2c_aborts;
+
+static MockDmaChannel_t     mock_dma_channels[NUM_DMA_CHANNELS];
+
+static irq_handler_t        mock_irq_handlers[MOCK_IRQS];
+static bool                 mock_irq_enabled[MOCK_IRQS];
+
+i2c_inst_t i2c0_inst = { &mock_i2c_buses[0].hw, false };
+i2c_inst_t i2c1_inst = { &mock_i2c_buses[1].hw, false };
+
+// Private Functions
+
+static void MockI2c_fatal( const char *message )
+{
+    printf( "Mock I2C - %s\n", message );
+    exit( 2 );
+}
+
+static MockI2cDevice_t *MockI2c_device( int bus, uint8_t address )
+{
+    int     ii;
+
+    for ( ii=0; ii<mock_i2c_device_count; ii++ )
+    {
+        if ( (mock_i2c_devices[ii].bus==bus) && (mock_i2c_devices[ii].address==address) )
+        {
+            return &mock_i2c_devices[ii];
+        }
+    }
+    return NULL;
+}
+
+// Raise the block's interrupt, if it is unmasked
+static void MockI2c_interrupt( int bus_id )
+{
+    MockI2cBus_t    *bus;
+    uint            irq;
+
+    bus = &mock_i2c_buses[bus_id];
+    irq = I2C0_IRQ + (uint)bus_id;
+    if ( ((bus->hw.intr_mask & bus->hw.raw_intr_stat)!=0) && mock_irq_enabled[irq] && (mock_irq_handlers[irq]!=NULL) )
+    {
+        mock_irq_handlers[irq]();
+    }
+}
+
+// The device has answered, or nobody did
+static void MockI2c_finish( void *context )
+{
+    MockI2cBus_t        *bus;
+    MockI2cDevice_t     *device;
+    MockI2cTransfer_t   *transfer;
+    int                 ii;
+
+    transfer = (MockI2cTransfer_t *)context;
+    bus = &mock_i2c_buses[transfer->bus];
+    if ( !bus->busy )
+    {   // aborted meanwhile
+        return;
+    }
+    bus->busy = false;
+    device = MockI2c_device( transfer->bus, transfer->address );
+    if ( device==NULL )
+    {
+        bus->hw.tx_abrt_source = I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS;
+        bus->hw.raw_intr_stat |= I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS | I2C_IC_RAW_INTR_STAT_STOP_DET_BITS;
+    }
+    else
+    {
+        for ( ii=0; (ii<bus->read_count) && (device->reply_len>0); ii++ )
+        {
+            bus->reading[ii] = device->reply[ii % device->reply_len];
+        }
+        bus->hw.raw_intr_stat |= I2C_IC_RAW_INTR_STAT_STOP_DET_BITS;
+    }
+    MockI2c_interrupt( transfer->bus );
+}
+
+// The transmit channel has been triggered
+static void MockI2c_start( int bus_id, int channel, const uint16_t *commands, int count )
+{
+    MockI2cBus_t        *bus;
+    MockI2cDevice_t     *device;
+    MockI2cTransfer_t   *transfer;
+    bool                first_read;
+    int                 ii;
+
+    bus = &mock_i2c_buses[bus_id];
+    if ( mock_i2c_transfer_count>=MOCK_I2C_TRANSFERS )
+    {
+        MockI2c_fatal( "too many transactions" );
+    }
+    transfer = &mock_i2c_transfers[mock_i2c_transfer_count++];
+    memset( transfer, 0, sizeof(*transfer) );
+    transfer->bus = bus_id;
+    transfer->address = (uint8_t)bus->hw.tar;
+    transfer->time = MockRtos_now();
+    transfer->overlapped = bus->busy;
+    transfer->restart = true;
+    transfer->stop = true;
+    for ( ii=0; ii<count; ii++ )
+    {
+        first_read = ( (commands[ii] & I2C_IC_DATA_CMD_CMD_BITS)!=0 ) && (transfer->read_len==0);
+        if ( ((commands[ii] & I2C_IC_DATA_CMD_RESTART_BITS)!=0) != (first_read && (transfer->write_len>0)) )
+        {
+            transfer->restart = false;
+        }
+        if ( ((commands[ii] & I2C_IC_DATA_CMD_STOP_BITS)!=0) != (ii==count-1) )
+        {
+            transfer->stop = false;
+        }
+        if ( (commands[ii] & I2C_IC_DATA_CMD_CMD_BITS)!=0 )
+        {
+            transfer->read_len++;
+        }
+        else if ( transfer->write_len<MOCK_I2C_BYTES_MAX )
+        {
+            transfer->written[transfer->write_len++] = (uint8_t)commands[ii];
+        }
+    }
+
+    bus->busy = true;
+    bus->tx_channel = channel;
+    bus->reading = bus->rx_buffer;
+    bus->read_count = ( bus->rx_buffer!=NULL ) ? bus->rx_count : 0;
+    bus->rx_buffer = NULL;
+    bus->rx_count = 0;
+    bus->hw.raw_intr_stat = 0;
+    bus->hw.tx_abrt_source = 0;
+    device = MockI2c_device( bus_id, transfer->address );
+    if ( (device==NULL) || !device->hang )
+    {
+        MockRtos_after( MOCK_I2C_TRANSFER_MS, MockI2c_finish, transfer );
+    }
+}
+
+// Public Functions - mock control
+
+void MockI2c_addDevice( int bus, uint8_t address, const uint8_t *reply, int reply_len )
+{
+    MockI2cDevice_t     *device;
+
+    if ( mock_i2c_device_count>=MOCK_I2C_DEVICES )
+    {
+        MockI2c_fatal( "too many devices" );
+    }
+    device = &mock_i2c_devices[mock_i2c_device_count++];
+    memset( device, 0, sizeof(*device) );
+    device->bus = bus;
+    device->address = address;
+    device->reply_len = ( reply_len<MOCK_I2C_BYTES_MAX ) ? reply_len : MOCK_I2C_BYTES_MAX;
+    if ( reply!=NULL )
+    {
+        memcpy( device->reply, reply, (size_t)device->reply_len );
+    }
+}
+
+void MockI2c_hang( int bus, uint8_t address )
+{
+    MockI2cDevice_t     *device;
+
+    device = MockI2c_device( bus, address );
+    if ( device==NULL )
+    {
+        MockI2c_addDevice( bus, address, NULL, 0 );
+        device = MockI2c_device( bus, address );
+    }
+    device->hang = true;
+}
+
+int MockI2c_transferCount( void )
+{
+    return mock_i2c_transfer_count;
+}
+
+const MockI2cTransfer_t *MockI2c_transfer( int index )
+{
+    return &mock_i2c_transfers[index];
+}
+
+void MockI2c_clear( void )
+{
+    mock_i2c_transfer_count = 0;
+    mock_i2c_aborts = 0;
+}
+
+int MockI2c_aborts( void )
+{
+    return mock_i2c_aborts;
+}
+
+// Public Functions - hardware/i2c.h
+
+uint i2c_init( i2c_inst_t *i2c, uint baudrate )
+{
+    i2c->hw->enable = 1;
+    return baudrate;
+}
+
+i2c_hw_t *i2c_get_hw( i2c_inst_t *i2c )
+{
+    return i2c->hw;
+}
+
+uint i2c_get_dreq( i2c_inst_t *i2c, bool is_tx )
+{
+    return MOCK_DREQ_I2C0_TX + 2 * (uint)( i2c==i2c1 ) + ( is_tx ? 0 : 1 );
+}
+
+// Public Functions - hardware/dma.h
+
+int dma_claim_unused_channel( bool required )
+{
+    int     ii;
+
+    for ( ii=0; ii<NUM_DMA_CHANNELS; ii++ )
+    {
+        if ( !mock_dma_channels[ii].claimed )
+        {
+            mock_dma_channels[ii].claimed = true;
+            return ii;
+        }
+    }
+    if ( required )
+    {
+        MockI2c_fatal( "no DMA channel" );
+    }
+    return -1;
+}
+
+dma_channel_config dma_channel_get_default_config( uint channel )
+{
+    dma_channel_config  config;
+
+    (void)channel;
+    config.size = DMA_SIZE_32;
+    config.read_increment = true;
+    config.write_increment = false;
+    config.dreq = MOCK_DREQ_NONE;
+    return config;
+}
+
+void channel_config_set_transfer_data_size( dma_channel_config *config, enum dma_channel_transfer_size size )
+{
+    config->size = size;
+}
+
+void channel_config_set_read_increment( dma_channel_config *config, bool increment )
+{
+    config->read_increment = increment;
+}
+
+void channel_config_set_write_increment( dma_channel_config *config, bool increment )
+{
+    config->write_increment = increment;
+}
+
+void channel_config_set_dreq( dma_channel_config *config, uint dreq )
+{
+    config->dreq = dreq;
+}
+
+// Paced by an I2C block: receive channels are noted, a transmit channel starts the transaction
+void dma_channel_configure( uint channel, const dma_channel_config *config, volatile void *write_addr,
+                            const volatile void *read_addr, uint transfer_count, bool trigger )
+{
+    int     bus_id;
+
+    mock_dma_channels[channel].config = *config;
+    if ( (config->dreq<MOCK_DREQ_I2C0_TX) || (config->dreq>=MOCK_DREQ_I2C0_TX + 2*MOCK_I2C_BUSES) )
+    {
+        return;
+    }
+    bus_id = (int)( config->dreq - MOCK_DREQ_I2C0_TX ) / 2;
+    if ( ((config->dreq - MOCK_DREQ_I2C0_TX) & 1)!=0 )
+    {
+        if ( (config->size!=DMA_SIZE_8) || config->read_increment || !config->write_increment )
+        {
+            MockI2c_fatal( "receive channel set up wrongly" );
+        }
+        mock_i2c_buses[bus_id].rx_buffer = (uint8_t *)write_addr;
+        mock_i2c_buses[bus_id].rx_count = (int)transfer_count;
+    }
+    else if ( trigger )
+    {
+        if ( (config->size!=DMA_SIZE_16) || !config->read_increment || config->write_increment )
+        {
+            MockI2c_fatal( "transmit channel set up wrongly" );
+        }
+        MockI2c_start( bus_id, (int)channel, (const uint16_t *)read_addr, (int)transfer_count );
+    }
+}
+
+// Stops a transaction that is still running
+void dma_channel_abort( uint channel )
+{
+    int     ii;
+
+    mock_i2c_aborts++;
+    for ( ii=0; ii<MOCK_I2C_BUSES; ii++ )
+    {
+        if ( mock_i2c_buses[ii].busy && (mock_i2c_buses[ii].tx_channel==(int)channel) )
+        {
+            mock_i2c_buses[ii].busy = false;
+        }
+    }
+}
+
+bool dma_channel_is_busy( uint channel )
+{
+    (void)channel;
+    return false;
+}
+
+// Public Functions - hardware/gpio.h
+
+void gpio_set_function( uint gpio, enum gpio_function fn )
+{
+    (void)gpio;
+    (void)fn;
+}
+
+void gpio_pull_up( uint gpio )
+{
+    (void)gpio;
+}
+
+// Public Functions - hardware/irq.h
+
+void irq_set_exclusive_handler( uint num, irq_handler_t handler )
+{
+    mock_irq_handlers[num] = handler;
+}
+
+void irq_set_enabled( uint num, bool enabled )
+{
+    mock_irq_enabled[num] = enabled;
+}
@@ -0,0 +1,76 @@
+/*---------------------------------------------------------------------------
+
+    I2C (mock)
+        Devices on simulated I2C blocks, fed by simulated DMA, for host tests
+
+    clayton@isnotcrazy.com
+
+    Implements hardware/i2c.h, dma.h, gpio.h and irq.h.  Triggering the
+    DMA channel that feeds an I2C block starts a transaction: the commands
+    are decoded and logged, and MOCK_I2C_TRANSFER_MS later (a mock RTOS
+    alarm) the addressed device answers, the bytes it sends are written
+    to the receive channel's buffer and the block raises STOP_DET - or
+    TX_ABRT with ADDR_NOACK if no device has that address.  A device set
+    to hang holds the bus, so no interrupt ever comes.
+
+    The driver clears the interrupt status by reading the clr_ registers,
+    which a plain struct cannot see, so the mock clears it when each
+    transaction starts.
+
+---------------------------------------------------------------------------*/
+
+#ifndef MOCK_I2C_H
+#define MOCK_I2C_H
+
+#include "hardware/i2c.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Macros
+
+#define MOCK_I2C_TRANSFER_MS    1
+#define MOCK_I2C_BYTES_MAX      32
+#define MOCK_I2C_TRANSFERS      32
+
+// Types
+
+// One transaction, as the block saw it
+typedef struct
+{
+    int         bus;
+    uint8_t     address;
+    uint8_t     written[MOCK_I2C_BYTES_MAX];
+    int         write_len;
+    int         read_len;
+    bool        restart;                // a repeated start before the first read after a write, and nowhere else
+    bool        stop;                   // a STOP on the last command, and on no other
+    bool        overlapped;             // started while the last one on the bus was still running
+    uint32_t    time;                   // ms, mock RTOS clock
+} MockI2cTransfer_t;
+
+// Functions
+
+// Put a device on a bus, answering reads with reply (repeated as needed)
+void MockI2c_addDevice( int bus, uint8_t address, const uint8_t *reply, int reply_len );
+
+// Make a device hold the bus - its transactions never finish
+void MockI2c_hang( int bus, uint8_t address );
+
+// The log of transactions
+int MockI2c_transferCount( void );
+const MockI2cTransfer_t *MockI2c_transfer( int index );
+void MockI2c_clear( void );
+
+// DMA channels aborted so far
+int MockI2c_aborts( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // MOCK_I2C_H
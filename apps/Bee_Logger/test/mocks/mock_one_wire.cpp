@@ -0,0 +1,255 @@
+/*---------------------------------------------------------------------------
+
+    One Wire (mock)
+        DS18B20s on simulated buses, for host tests
+
+    clayton@isnotcrazy.com
+
+    At 9 to 11 bits a DS18B20 leaves the low bits of its reading
+    undefined - the mock sets them, so code that does not mask them off
+    shows up.
+
+---------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mock_rtos.h"
+#include "mock_one_wire.h"
+
+// Macros
+
+#define MOCK_ONE_WIRE_BUSES     8
+
+// Types
+
+struct MockDevice {
+	rom_address_t address;
+	Fixed<4, Celsius> temperature;
+	unsigned int resolution;
+};
+
+struct MockBus {
+	uint pin;
+	int count;
+	MockDevice devices[MOCK_ONE_WIRE_DEVICES];
+};
+
+// Data
+
+static MockBus mock_buses[MOCK_ONE_WIRE_BUSES];
+static int mock_bus_count;
+static MockOneWireEvent mock_events[MOCK_ONE_WIRE_EVENTS];
+static int mock_event_count;
+
+// Private Functions
+
+static MockBus *MockOneWire_bus(uint pin) {
+	for (int ii = 0; ii < mock_bus_count; ii++) {
+		if (mock_buses[ii].pin == pin) {
+			return &mock_buses[ii];
+		}
+	}
+	if (mock_bus_count >= MOCK_ONE_WIRE_BUSES) {
+		printf("Mock One_wire - too many buses\n");
+		exit(2);
+	}
+	mock_buses[mock_bus_count].pin = pin;
+	return &mock_buses[mock_bus_count++];
+}
+
+static void MockOneWire_log(MockOneWireAction action, uint pin) {
+	if (mock_event_count < MOCK_ONE_WIRE_EVENTS) {
+		mock_events[mock_event_count++] = MockOneWireEvent{action, pin, MockRtos_now()};
+	}
+}
+
+// Public Functions - mock control
+
+int MockOneWire_addDevice(uint pin, Fixed<4, Celsius> temperature) {
+	MockBus *bus = MockOneWire_bus(pin);
+	MockDevice *device = &bus->devices[bus->count];
+
+	*device = MockDevice{};
+	device->address.rom[0] = FAMILY_CODE_DS18B20;
+	device->address.rom[1] = (uint8_t) pin;
+	device->address.rom[2] = (uint8_t) bus->count;
+	device->temperature = temperature;
+	device->resolution = 12;
+	return bus->count++;
+}
+
+void MockOneWire_setTemperature(uint pin, int index, Fixed<4, Celsius> temperature) {
+	MockOneWire_bus(pin)->devices[index].temperature = temperature;
+}
+
+unsigned int MockOneWire_resolution(uint pin, int index) {
+	return MockOneWire_bus(pin)->devices[index].resolution;
+}
+
+int MockOneWire_eventCount() {
+	return mock_event_count;
+}
+
+const MockOneWireEvent &MockOneWire_event(int index) {
+	return mock_events[index];
+}
+
+void MockOneWire_clearEvents() {
+	mock_event_count = 0;
+}
+
+// Public Functions - One_wire
+
+One_wire::One_wire(uint data_pin, uint power_pin, bool power_polarity, rom_address_t *addresses, Speed *speeds, int capacity)
+		: _data_pin(data_pin), _parasite_pin(power_pin), _power_mosfet(power_pin != not_controllable),
+		  _power_polarity(power_polarity), _addresses(addresses), _speeds(speeds), _capacity(capacity) {
+}
+
+One_wire::~One_wire() = default;
+
+void One_wire::init() {
+	MockOneWire_bus(_data_pin);
+}
+
+int One_wire::find_and_count_devices_on_bus() {
+	MockBus *bus = MockOneWire_bus(_data_pin);
+
+	_found = 0;
+	for (int ii = 0; (ii < bus->count) && (_found < _capacity); ii++) {
+		_addresses[_found] = bus->devices[ii].address;
+		_speeds[_found] = Speed::standard;
+		_found++;
+	}
+	return _found;
+}
+
+int One_wire::add_device(const rom_address_t &address) {
+	for (int ii = 0; ii < _found; ii++) {
+		if (memcmp(&_addresses[ii], &address, sizeof(address)) == 0) {
+			return ii;
+		}
+	}
+	if (_found >= _capacity) {
+		return -1;
+	}
+	_addresses[_found] = address;
+	_speeds[_found] = Speed::standard;
+	return _found++;
+}
+
+rom_address_t &One_wire::get_address(int index) {
+	return _addresses[index];
+}
+
+int One_wire::find_alarmed_devices(rom_address_t *addresses, int capacity) {
+	(void) addresses;
+	(void) capacity;
+	return 0;
+}
+
+void One_wire::end_conversion() {
+	_converting = false;
+	MockOneWire_log(MockOneWireAction::done, _data_pin);
+	if (_notify_event != nullptr) {
+		osEventFlagsSet(_notify_event, _notify_flags);
+	}
+}
+
+int64_t One_wire::conversion_alarm(alarm_id_t id, void *user_data) {
+	(void) id;
+	static_cast<One_wire *>(user_data)->end_conversion();
+	return 0;
+}
+
+int One_wire::start_convert_temperature(rom_address_t &address, bool all, osEventFlagsId_t event, uint32_t flags) {
+	int delay_time;
+
+	(void) address;
+	(void) all;
+	MockOneWire_log(MockOneWireAction::convert, _data_pin);
+	delay_time = conversion_time(_conversion_resolution);
+	_notify_event = event;
+	_notify_flags = flags;
+	_converting = true;
+	MockRtos_after((uint32_t) delay_time, [](void *context) { conversion_alarm(0, context); }, this);
+	return delay_time;
+}
+
+int One_wire::convert_temperature(rom_address_t &address, bool wait, bool all) {
+	int delay_time = start_convert_temperature(address, all, nullptr, 0);
+
+	if (wait) {
+		osDelay((uint32_t) delay_time);
+	}
+	return delay_time;
+}
+
+bool One_wire::temperature(rom_address_t &address, Fixed<4, Celsius> &value) {
+	MockBus *bus = MockOneWire_bus(_data_pin);
+	MockDevice *device = nullptr;
+	int32_t undefined;
+
+	MockOneWire_log(MockOneWireAction::read, _data_pin);
+	for (int ii = 0; ii < bus->count; ii++) {
+		if (_single_device || (memcmp(&bus->devices[ii].address, &address, sizeof(address)) == 0)) {
+			device = &bus->devices[ii];
+			break;
+		}
+	}
+	if (device == nullptr) {
+		return false;
+	}
+	ram[4] = (uint8_t) (((device->resolution - 9) << 5) | 0x1F);
+	undefined = (1 << (12 - device->resolution)) - 1;
+	value = Fixed<4, Celsius>::from_raw(device->temperature.raw() | undefined);
+	return true;
+}
+
+bool One_wire::set_resolution(rom_address_t &address, unsigned int resolution) {
+	MockBus *bus = MockOneWire_bus(_data_pin);
+
+	for (int ii = 0; ii < bus->count; ii++) {
+		if (_single_device || (memcmp(&bus->devices[ii].address, &address, sizeof(address)) == 0)) {
+			bus->devices[ii].resolution = resolution;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool One_wire::set_alarm_band(rom_address_t &address, int low, int high) {
+	(void) address;
+	(void) low;
+	(void) high;
+	return true;
+}
+
+unsigned int One_wire::resolution() const {
+	return ((ram[4] >> 5) & 0x03) + 9;
+}
+
+void One_wire::set_conversion_resolution(unsigned int resolution) {
+	_conversion_resolution = resolution;
+}
+
+int One_wire::conversion_time(unsigned int resolution) {
+	switch (resolution) {
+		case 9:
+			return 94;
+		case 10:
+			return 188;
+		case 11:
+			return 375;
+		default:
+			return 750;
+	}
+}
+
+bool One_wire::single_device_read_rom(rom_address_t &rom_address) {
+	(void) rom_address;
+	return false;
+}
+
+void One_wire::set_single_device(bool single) {
+	_single_device = single;
+}
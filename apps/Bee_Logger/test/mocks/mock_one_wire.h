@@ -0,0 +1,56 @@
+/*---------------------------------------------------------------------------
+
+    One Wire (mock)
+        DS18B20s on simulated buses, for host tests
+
+    clayton@isnotcrazy.com
+
+    The One_wire class from one_wire.h, built with MOCK_PICO_PI, with its
+    methods replaced by simulated devices.  A conversion ends with a
+    mock RTOS alarm after the DS18B20 conversion time, and every command
+    is logged with the virtual time, so a test can check what was sent
+    to each bus and when.
+
+---------------------------------------------------------------------------*/
+
+#ifndef MOCK_ONE_WIRE_H
+#define MOCK_ONE_WIRE_H
+
+#include "one_wire.h"
+
+// Macros
+
+#define MOCK_ONE_WIRE_DEVICES   16          // on each bus
+#define MOCK_ONE_WIRE_EVENTS    256
+
+// Types
+
+enum class MockOneWireAction : uint8_t {
+	convert,                                // Convert T sent
+	done,                                   // conversion finished
+	read                                    // scratchpad read
+};
+
+struct MockOneWireEvent {
+	MockOneWireAction action;
+	uint pin;
+	uint32_t time;                          // ms, mock RTOS clock
+};
+
+// Functions
+
+// Put a DS18B20 on the bus of a pin - returns its index on the bus
+int MockOneWire_addDevice(uint pin, Fixed<4, Celsius> temperature);
+
+// Change the temperature a device will read
+void MockOneWire_setTemperature(uint pin, int index, Fixed<4, Celsius> temperature);
+
+// Resolution a device is set to, in bits
+unsigned int MockOneWire_resolution(uint pin, int index);
+
+// The log of bus commands
+int MockOneWire_eventCount();
+const MockOneWireEvent &MockOneWire_event(int index);
+void MockOneWire_clearEvents();
+
+#endif      // MOCK_ONE_WIRE_H
@@ -0,0 +1,556 @@
+/*---------------------------------------------------------------------------
+
+    Mock RTOS
+        CMSIS-RTOS2 on a virtual clock, for host tests
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mock_rtos.h"
+
+// Macros
+
+#define MOCK_THREADS            8
+#define MOCK_OBJECTS            32          // of each kind
+#define MOCK_ALARMS             64
+#define MOCK_QUEUE_BYTES        256
+
+// Types
+
+typedef struct
+{
+    osThreadFunc_t  func;
+    void            *argument;
+    uint32_t        flags;
+    bool            running;
+    bool            exited;
+    jmp_buf         park;               // back to MockRtos_runThreads when it would wait forever
+} MockThread_t;
+
+typedef struct
+{
+    uint32_t        flags;
+} MockEventFlags_t;
+
+typedef struct
+{
+    MockThread_t    *owner;
+} MockMutex_t;
+
+typedef struct
+{
+    uint32_t        capacity;
+    uint32_t        size;
+    uint32_t        head;
+    uint32_t        count;
+    uint8_t         data[MOCK_QUEUE_BYTES];
+} MockQueue_t;
+
+typedef struct
+{
+    uint32_t        due;
+    MockRtosAlarm_t alarm;
+    void            *context;
+} MockAlarm_t;
+
+typedef struct
+{
+    uint32_t        *flags;
+    uint32_t        wanted;
+    uint32_t        options;
+} MockFlagsWait_t;
+
+typedef bool (*MockReady_t)( void *context );
+
+// Data
+
+static MockThread_t         mock_threads[MOCK_THREADS];             // [0] is main()
+static int                  mock_thread_count = 1;
+static MockThread_t         *mock_current = &mock_threads[0];
+
+static MockEventFlags_t     mock_event_flags[MOCK_OBJECTS];
+static int                  mock_event_flags_count;
+static MockMutex_t          mock_mutexes[MOCK_OBJECTS];
+static int                  mock_mutex_count;
+static MockQueue_t          mock_queues[MOCK_OBJECTS];
+static int                  mock_queue_count;
+
+static MockAlarm_t          mock_alarms[MOCK_ALARMS];
+static int                  mock_alarm_count;
+
+static uint32_t             mock_now;
+static uint32_t             mock_activity;          // counts anything that could wake a thread
+static int32_t              mock_lock;
+
+// Private Functions
+
+static void MockRtos_fatal( const char *message )
+{
+    printf( "Mock RTOS - %s\n", message );
+    exit( 2 );
+}
+
+// Soonest alarm, or -1
+static int MockRtos_nextAlarm( void )
+{
+    int     next;
+    int     ii;
+
+    next = -1;
+    for ( ii=0; ii<mock_alarm_count; ii++ )
+    {
+        if ( (next<0) || ((int32_t)(mock_alarms[ii].due - mock_alarms[next].due) < 0) )
+        {
+            next = ii;
+        }
+    }
+    return next;
+}
+
+// Run an alarm, moving the clock to it
+static void MockRtos_fire( int index )
+{
+    MockAlarm_t     alarm;
+
+    alarm = mock_alarms[index];
+    mock_alarms[index] = mock_alarms[--mock_alarm_count];
+    if ( (int32_t)(alarm.due - mock_now) > 0 )
+    {
+        mock_now = alarm.due;
+    }
+    mock_activity++;
+    alarm.alarm( alarm.context );
+}
+
+// Wait until ready() - returns false if the timeout passed first
+static bool MockRtos_wait( MockReady_t ready, void *context, uint32_t timeout )
+{
+    uint32_t    deadline;
+    int         next;
+
+    deadline = mock_now + timeout;
+    while ( !ready( context ) )
+    {
+        if ( timeout==0 )
+        {
+            return false;
+        }
+        if ( mock_current==&mock_threads[0] )
+        {
+            MockRtos_runThreads();
+            if ( ready( context ) )
+            {
+                break;
+            }
+        }
+        next = MockRtos_nextAlarm();
+        if ( (next>=0) && ((timeout==osWaitForever) || ((int32_t)(mock_alarms[next].due - deadline) <= 0)) )
+        {
+            MockRtos_fire( next );
+            continue;
+        }
+        if ( timeout==osWaitForever )
+        {
+            if ( mock_current!=&mock_threads[0] )
+            {   // park it until something else happens
+                longjmp( mock_current->park, 1 );
+            }
+            MockRtos_fatal( "main thread would wait forever" );
+        }
+        if ( (int32_t)(deadline - mock_now) > 0 )
+        {
+            mock_now = deadline;
+        }
+        return ready( context );
+    }
+    return true;
+}
+
+static bool MockRtos_never( void *context )
+{
+    (void)context;
+    return false;
+}
+
+static bool MockRtos_flagsReady( void *context )
+{
+    MockFlagsWait_t     *wait;
+
+    wait = (MockFlagsWait_t *)context;
+    if ( (wait->options & osFlagsWaitAll)!=0 )
+    {
+        return ( (*wait->flags & wait->wanted)==wait->wanted );
+    }
+    return ( (*wait->flags & wait->wanted)!=0 );
+}
+
+// Wait for flags, as both thread and event flags do
+static uint32_t MockRtos_flagsWait( uint32_t *flags, uint32_t wanted, uint32_t options, uint32_t timeout )
+{
+    MockFlagsWait_t     wait;
+    uint32_t            result;
+
+    wait.flags = flags;
+    wait.wanted = wanted;
+    wait.options = options;
+    if ( !MockRtos_wait( MockRtos_flagsReady, &wait, timeout ) )
+    {
+        return ( timeout==0 ) ? osFlagsErrorResource : osFlagsErrorTimeout;
+    }
+    result = *flags;
+    if ( (options & osFlagsNoClear)==0 )
+    {
+        *flags &= ~wanted;
+    }
+    return result;
+}
+
+static bool MockRtos_mutexFree( void *context )
+{
+    return ( ((MockMutex_t *)context)->owner==NULL );
+}
+
+static bool MockRtos_queueFull( void *context )
+{
+    MockQueue_t     *queue;
+
+    queue = (MockQueue_t *)context;
+    return ( queue->count<queue->capacity );
+}
+
+static bool MockRtos_queueEmpty( void *context )
+{
+    return ( ((MockQueue_t *)context)->count>0 );
+}
+
+// Public Functions - mock control
+
+uint32_t MockRtos_now( void )
+{
+    return mock_now;
+}
+
+void MockRtos_after( uint32_t ms, MockRtosAlarm_t alarm, void *context )
+{
+    if ( mock_alarm_count>=MOCK_ALARMS )
+    {
+        MockRtos_fatal( "too many alarms" );
+    }
+    mock_alarms[mock_alarm_count].due = mock_now + ms;
+    mock_alarms[mock_alarm_count].alarm = alarm;
+    mock_alarms[mock_alarm_count].context = context;
+    mock_alarm_count++;
+}
+
+void MockRtos_advance( uint32_t ms )
+{
+    uint32_t    until;
+    int         next;
+
+    until = mock_now + ms;
+    while ( ((next = MockRtos_nextAlarm())>=0) && ((int32_t)(mock_alarms[next].due - until) <= 0) )
+    {
+        MockRtos_fire( next );
+    }
+    mock_now = until;
+}
+
+void MockRtos_runThreads( void )
+{
+    MockThread_t    *caller;
+    MockThread_t    *thread;
+    uint32_t        activity;
+    int             ii;
+
+    caller = mock_current;
+    do
+    {   // until a whole pass changes nothing
+        activity = mock_activity;
+        for ( ii=1; ii<mock_thread_count; ii++ )
+        {
+            thread = &mock_threads[ii];
+            if ( thread->running || thread->exited || (thread==caller) )
+            {
+                continue;
+            }
+            thread->running = true;
+            mock_current = thread;
+            if ( setjmp( thread->park )==0 )
+            {
+                thread->func( thread->argument );
+                thread->exited = true;
+            }
+            thread->running = false;
+            mock_current = caller;
+        }
+    } while ( activity!=mock_activity );
+}
+
+int MockRtos_alarmsPending( void )
+{
+    return mock_alarm_count;
+}
+
+// Public Functions - kernel
+
+osKernelState_t osKernelGetState( void )
+{
+    return ( mock_lock>0 ) ? osKernelLocked : osKernelRunning;
+}
+
+int32_t osKernelLock( void )
+{
+    return mock_lock++ > 0;
+}
+
+int32_t osKernelUnlock( void )
+{
+    return mock_lock-- > 0;
+}
+
+uint32_t osKernelGetTickCount( void )
+{
+    return mock_now;
+}
+
+uint32_t osKernelGetTickFreq( void )
+{
+    return 1000;
+}
+
+osStatus_t osDelay( uint32_t ticks )
+{
+    MockRtos_wait( MockRtos_never, NULL, ticks );
+    return osOK;
+}
+
+osStatus_t osDelayUntil( uint32_t ticks )
+{
+    if ( (int32_t)(ticks - mock_now) > 0 )
+    {
+        osDelay( ticks - mock_now );
+    }
+    return osOK;
+}
+
+// Public Functions - threads
+
+osThreadId_t osThreadNew( osThreadFunc_t func, void *argument, const osThreadAttr_t *attr )
+{
+    MockThread_t    *thread;
+
+    (void)attr;
+    if ( mock_thread_count>=MOCK_THREADS )
+    {
+        return NULL;
+    }
+    thread = &mock_threads[mock_thread_count++];
+    memset( thread, 0, sizeof(*thread) );
+    thread->func = func;
+    thread->argument = argument;
+    mock_activity++;
+    return thread;
+}
+
+osThreadId_t osThreadGetId( void )
+{
+    return mock_current;
+}
+
+uint32_t osThreadFlagsSet( osThreadId_t thread_id, uint32_t flags )
+{
+    MockThread_t    *thread;
+
+    thread = (MockThread_t *)thread_id;
+    if ( thread==NULL )
+    {
+        return osFlagsErrorParameter;
+    }
+    thread->flags |= flags;
+    mock_activity++;
+    return thread->flags;
+}
+
+uint32_t osThreadFlagsClear( uint32_t flags )
+{
+    uint32_t    previous;
+
+    previous = mock_current->flags;
+    mock_current->flags &= ~flags;
+    return previous;
+}
+
+uint32_t osThreadFlagsGet( void )
+{
+    return mock_current->flags;
+}
+
+uint32_t osThreadFlagsWait( uint32_t flags, uint32_t options, uint32_t timeout )
+{
+    return MockRtos_flagsWait( &mock_current->flags, flags, options, timeout );
+}
+
+// Public Functions - event flags
+
+osEventFlagsId_t osEventFlagsNew( const osEventFlagsAttr_t *attr )
+{
+    (void)attr;
+    return ( mock_event_flags_count<MOCK_OBJECTS ) ? &mock_event_flags[mock_event_flags_count++] : NULL;
+}
+
+uint32_t osEventFlagsSet( osEventFlagsId_t ef_id, uint32_t flags )
+{
+    MockEventFlags_t    *event;
+
+    event = (MockEventFlags_t *)ef_id;
+    if ( event==NULL )
+    {
+        return osFlagsErrorParameter;
+    }
+    event->flags |= flags;
+    mock_activity++;
+    return event->flags;
+}
+
+uint32_t osEventFlagsClear( osEventFlagsId_t ef_id, uint32_t flags )
+{
+    MockEventFlags_t    *event;
+    uint32_t            previous;
+
+    event = (MockEventFlags_t *)ef_id;
+    if ( event==NULL )
+    {
+        return osFlagsErrorParameter;
+    }
+    previous = event->flags;
+    event->flags &= ~flags;
+    return previous;
+}
+
+uint32_t osEventFlagsGet( osEventFlagsId_t ef_id )
+{
+    return ( ef_id==NULL ) ? 0 : ((MockEventFlags_t *)ef_id)->flags;
+}
+
+uint32_t osEventFlagsWait( osEventFlagsId_t ef_id, uint32_t flags, uint32_t options, uint32_t timeout )
+{
+    if ( ef_id==NULL )
+    {
+        return osFlagsErrorParameter;
+    }
+    return MockRtos_flagsWait( &((MockEventFlags_t *)ef_id)->flags, flags, options, timeout );
+}
+
+// Public Functions - mutexes
+
+osMutexId_t osMutexNew( const osMutexAttr_t *attr )
+{
+    (void)attr;
+    return ( mock_mutex_count<MOCK_OBJECTS ) ? &mock_mutexes[mock_mutex_count++] : NULL;
+}
+
+osStatus_t osMutexAcquire( osMutexId_t mutex_id, uint32_t timeout )
+{
+    MockMutex_t     *mutex;
+
+    mutex = (MockMutex_t *)mutex_id;
+    if ( mutex==NULL )
+    {
+        return osErrorParameter;
+    }
+    if ( mutex->owner==mock_current )
+    {
+        MockRtos_fatal( "mutex acquired twice by one thread" );
+    }
+    if ( !MockRtos_wait( MockRtos_mutexFree, mutex, timeout ) )
+    {
+        return ( timeout==0 ) ? osErrorResource : osErrorTimeout;
+    }
+    mutex->owner = mock_current;
+    return osOK;
+}
+
+osStatus_t osMutexRelease( osMutexId_t mutex_id )
+{
+    MockMutex_t     *mutex;
+
+    mutex = (MockMutex_t *)mutex_id;
+    if ( (mutex==NULL) || (mutex->owner!=mock_current) )
+    {
+        return osErrorResource;
+    }
+    mutex->owner = NULL;
+    mock_activity++;
+    return osOK;
+}
+
+// Public Functions - message queues
+
+osMessageQueueId_t osMessageQueueNew( uint32_t msg_count, uint32_t msg_size, const osMessageQueueAttr_t *attr )
+{
+    MockQueue_t     *queue;
+
+    (void)attr;
+    if ( (mock_queue_count>=MOCK_OBJECTS) || (msg_count*msg_size>MOCK_QUEUE_BYTES) )
+    {
+        return NULL;
+    }
+    queue = &mock_queues[mock_queue_count++];
+    memset( queue, 0, sizeof(*queue) );
+    queue->capacity = msg_count;
+    queue->size = msg_size;
+    return queue;
+}
+
+osStatus_t osMessageQueuePut( osMessageQueueId_t mq_id, const void *msg_ptr, uint8_t msg_prio, uint32_t timeout )
+{
+    MockQueue_t     *queue;
+
+    (void)msg_prio;
+    queue = (MockQueue_t *)mq_id;
+    if ( queue==NULL )
+    {
+        return osErrorParameter;
+    }
+    if ( !MockRtos_wait( MockRtos_queueFull, queue, timeout ) )
+    {
+        return ( timeout==0 ) ? osErrorResource : osErrorTimeout;
+    }
+    memcpy( &queue->data[ ((queue->head + queue->count) % queue->capacity) * queue->size ], msg_ptr, queue->size );
+    queue->count++;
+    mock_activity++;
+    return osOK;
+}
+
+osStatus_t osMessageQueueGet( osMessageQueueId_t mq_id, void *msg_ptr, uint8_t *msg_prio, uint32_t timeout )
+{
+    MockQueue_t     *queue;
+
+    queue = (MockQueue_t *)mq_id;
+    if ( queue==NULL )
+    {
+        return osErrorParameter;
+    }
+    if ( !MockRtos_wait( MockRtos_queueEmpty, queue, timeout ) )
+    {
+        return ( timeout==0 ) ? osErrorResource : osErrorTimeout;
+    }
+    memcpy( msg_ptr, &queue->data[ queue->head * queue->size ], queue->size );
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    if ( msg_prio!=NULL )
+    {
+        *msg_prio = 0;
+    }
+    mock_activity++;
+    return osOK;
+}
+
+uint32_t osMessageQueueGetCount( osMessageQueueId_t mq_id )
+{
+    return ( mq_id==NULL ) ? 0 : ((MockQueue_t *)mq_id)->count;
+}
@@ -0,0 +1,60 @@
+/*---------------------------------------------------------------------------
+
+    Mock RTOS
+        CMSIS-RTOS2 on a virtual clock, for host tests
+
+    clayton@isnotcrazy.com
+
+    Time only moves when something waits: a wait that cannot be met at
+    once first runs the other threads, then steps the clock to the next
+    alarm (standing in for a hardware alarm or interrupt), until the wait
+    is met or its timeout passes.  A test can measure how long the code
+    under test slept by reading the clock before and after.
+
+    The test's own main() is the first thread.  Threads made with
+    osThreadNew run cooperatively, one at a time, when the main thread
+    waits (or calls MockRtos_runThreads).  A thread that would wait
+    forever is parked, and next time is started again from the top - so
+    only threads written as "while (1) { wait; work; }" with their state
+    outside the function are supported, which is how the application's
+    worker threads are written.
+
+---------------------------------------------------------------------------*/
+
+#ifndef MOCK_RTOS_H
+#define MOCK_RTOS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "cmsis_os2.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Types
+
+typedef void (*MockRtosAlarm_t)( void *context );
+
+// Functions
+
+// Virtual time, in ms (one tick)
+uint32_t MockRtos_now( void );
+
+// Run alarm(context) once the clock reaches now + ms
+void MockRtos_after( uint32_t ms, MockRtosAlarm_t alarm, void *context );
+
+// Move the clock on, running the alarms due meanwhile
+void MockRtos_advance( uint32_t ms );
+
+// Let the other threads run until they all wait
+void MockRtos_runThreads( void );
+
+// Number of alarms not yet run
+int MockRtos_alarmsPending( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // MOCK_RTOS_H
@@ -0,0 +1,32 @@
+/*---------------------------------------------------------------------------
+
+    pico/stdlib.h (mock)
+        The part of the pico-sdk stdio API console.c uses, for host tests
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+
+#ifndef _PICO_STDLIB_H
+#define _PICO_STDLIB_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Macros
+
+#define PICO_ERROR_TIMEOUT      (-1)
+
+// Functions
+
+// Next character received, or PICO_ERROR_TIMEOUT - given by the test
+int getchar_timeout_us( uint32_t timeout_us );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // _PICO_STDLIB_H
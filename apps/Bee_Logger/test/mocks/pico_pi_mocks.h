@@ -0,0 +1,27 @@
+/*---------------------------------------------------------------------------
+
+    Pico Mocks
+        The pico-sdk types one_wire.h needs, for host tests (MOCK_PICO_PI)
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+
+#ifndef PICO_PI_MOCKS_H
+#define PICO_PI_MOCKS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "cmsis_os2.h"
+
+// Macros
+
+#define NUM_DMA_CHANNELS        12
+
+// Types
+
+typedef unsigned int uint;
+typedef struct pio_hw *PIO;
+typedef int32_t alarm_id_t;
+
+#endif      // PICO_PI_MOCKS_H
@@ -0,0 +1,62 @@
+/*---------------------------------------------------------------------------
+
+    Test
+        Checks for the host tests
+
+    clayton@isnotcrazy.com
+
+    Each test is a plain program - a failed check is printed and counted,
+    and Test_result() gives the exit status CTest looks at.
+
+---------------------------------------------------------------------------*/
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// Macros
+
+#define TEST_CHECK(cond)            Test_check( (cond), #cond, __FILE__, __LINE__ )
+#define TEST_EQUAL(actual, expected) \
+    Test_equal( (long long)(actual), (long long)(expected), #actual, __FILE__, __LINE__ )
+
+// Data
+
+static int  test_checks;
+static int  test_failures;
+
+// Functions
+
+static inline bool Test_check( bool passed, const char *text, const char *file, int line )
+{
+    test_checks++;
+    if ( !passed )
+    {
+        test_failures++;
+        printf( "%s:%d: FAILED %s\n", file, line, text );
+    }
+    return passed;
+}
+
+static inline bool Test_equal( long long actual, long long expected, const char *text, const char *file, int line )
+{
+    test_checks++;
+    if ( actual!=expected )
+    {
+        test_failures++;
+        printf( "%s:%d: FAILED %s is %lld, expected %lld\n", file, line, text, actual, expected );
+        return false;
+    }
+    return true;
+}
+
+// Print the totals - returns the exit status
+static inline int Test_result( const char *name )
+{
+    printf( "%s - %d checks, %d failed\n", name, test_checks, test_failures );
+    return ( test_failures==0 ) ? 0 : 1;
+}
+
+#endif      // TEST_H
@@ -0,0 +1,241 @@
+/*---------------------------------------------------------------------------
+
+    Analog Calibration (test)
+        Linearity correction and the supply divider, on synthetic transfer curves
+
+    clayton@isnotcrazy.com
+
+    The linearity table is checked against a synthetic RP2040 ADC whose
+    codes 512, 1536, 2560 and 3584 are 8 LSB wider than the rest.  The
+    divider calibration is fed supply readings from a stub SupplyVoltage,
+    and points that cannot be a divider must leave the one in use alone.
+
+---------------------------------------------------------------------------*/
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "mock_flash_store.h"
+#include "flash_store.h"
+#include "analog_channel.h"
+#include "supply_voltage.h"
+#include "analog_calibration.h"
+
+// Macros
+
+#define TEST_CODES          4096
+#define TEST_WIDE_EXTRA     8.0             // LSB
+#define TEST_STEPS          16              // inputs tried across each LSB
+
+// Data
+
+static double       test_edges[TEST_CODES + 1];         // input where each code starts, LSB
+static uint16_t     test_reading;                       // next supply reading
+
+// Stubs
+
+bool SupplyVoltage_read( uint16_t *reading, milli_t *pin_voltage, milli_t *supply_voltage )
+{
+    *reading = test_reading;
+    *pin_voltage = 0;
+    *supply_voltage = 0;
+    return true;
+}
+
+void AnalogChannel_enable( int channel )
+{
+    (void)channel;
+}
+
+bool AnalogChannel_read( int channel, int samples, uint16_t *reading )
+{
+    (void)channel;
+    (void)samples;
+    (void)reading;
+    return false;
+}
+
+// Private Functions
+
+// The synthetic ADC - the wide codes take their extra width from the rest, evenly
+static void Test_makeAdc( void )
+{
+    double  narrow;
+    int     code;
+
+    narrow = ( TEST_CODES - 4 * (1.0 + TEST_WIDE_EXTRA) ) / ( TEST_CODES - 4 );
+    test_edges[0] = -0.5;
+    for ( code=0; code<TEST_CODES; code++ )
+    {
+        test_edges[code+1] = test_edges[code] + ( ((code & 1023)==512) ? 1.0 + TEST_WIDE_EXTRA : narrow );
+    }
+}
+
+static int Test_convert( double input )
+{
+    int     code;
+
+    for ( code=0; (code<TEST_CODES-1) && (input>=test_edges[code+1]); code++ )
+    {
+    }
+    return code;
+}
+
+// Corrected readings sit in the middle of what each code covers
+static void Test_linearity( void )
+{
+    const uint16_t  *linearity;
+    double          input;
+    double          error;
+    double          worst_raw;
+    double          worst_narrow;
+    double          worst_wide;
+    int             code;
+    int             step;
+
+    linearity = AnalogCalibration_linearity();
+    TEST_EQUAL( linearity[0], 0 );
+    TEST_EQUAL( linearity[TEST_CODES-1], (TEST_CODES-1) << ANALOG_FRACTION_BITS );
+    for ( code=1; code<TEST_CODES; code++ )
+    {
+        TEST_CHECK( linearity[code]>linearity[code-1] );
+    }
+
+    worst_raw = 0.0;
+    worst_narrow = 0.0;
+    worst_wide = 0.0;
+    for ( step=0; step<(TEST_CODES-1)*TEST_STEPS; step++ )
+    {
+        input = (step + 0.5) / TEST_STEPS;
+        code = Test_convert( input );
+        error = fabs( (double)linearity[code] / (1 << ANALOG_FRACTION_BITS) - input );
+        if ( (code & 1023)==512 )
+        {
+            worst_wide = ( error>worst_wide ) ? error : worst_wide;
+        }
+        else
+        {
+            worst_narrow = ( error>worst_narrow ) ? error : worst_narrow;
+            error = fabs( code - input );
+            worst_raw = ( error>worst_raw ) ? error : worst_raw;
+        }
+    }
+
+    // within half a code (and the rounding to 1/16) - uncorrected the sawtooth reaches half a spike
+    TEST_CHECK( worst_narrow<=0.5 + 1.0/32 );
+    TEST_CHECK( worst_wide<=(1.0 + TEST_WIDE_EXTRA)/2 + 1.0/32 );
+    TEST_CHECK( worst_raw>=TEST_WIDE_EXTRA/2 - 0.5 );
+    printf( "Linearity - worst error %.3f LSB (%.3f within a wide code), uncorrected %.3f\n",
+                worst_narrow, worst_wide, worst_raw );
+}
+
+static bool Test_addPoint( uint16_t reading, milli_t voltage )
+{
+    test_reading = reading;
+    return AnalogCalibration_addPoint( voltage );
+}
+
+// Every reading converted as before
+static void Test_unchanged( const milli_t *before )
+{
+    int     ii;
+
+    for ( ii=0; ii<16; ii++ )
+    {
+        TEST_EQUAL( AnalogCalibration_apply( (uint16_t)(ii * 4096) ), before[ii] );
+    }
+}
+
+static void Test_snapshot( milli_t *before )
+{
+    int     ii;
+
+    for ( ii=0; ii<16; ii++ )
+    {
+        before[ii] = AnalogCalibration_apply( (uint16_t)(ii * 4096) );
+    }
+}
+
+// Two points give the gain and the offset, one just the offset
+static void Test_divider( void )
+{
+    milli_t     step;
+    int         reading;
+
+    // the defaults - 3.33V full scale through a 9.728 divider, plus the diode
+    AnalogCalibration_clear();
+    TEST_CHECK( abs( AnalogCalibration_apply( 0 ) - 804 )<=1 );
+    TEST_CHECK( abs( AnalogCalibration_apply( 32768 ) - (804 + 16197) )<=1 );
+    step = AnalogCalibration_apply( 40000 ) - AnalogCalibration_apply( 30000 );
+
+    // 20000 = 5.5V, 50000 = 13.0V - 0.25mV a count, 0.5V at zero
+    TEST_CHECK( Test_addPoint( 50000, 13000 ) );
+    TEST_CHECK( Test_addPoint( 20000, 5500 ) );
+    for ( reading=0; reading<65536; reading+=2500 )
+    {
+        TEST_CHECK( abs( AnalogCalibration_apply( (uint16_t)reading ) - (500 + reading/4) )<=1 );
+    }
+    TEST_EQUAL( AnalogCalibration_apply( 20000 ), 5500 );
+    TEST_EQUAL( AnalogCalibration_apply( 50000 ), 13000 );
+
+    // a point at a known voltage replaces the one there
+    TEST_CHECK( Test_addPoint( 52000, 13000 ) );
+    TEST_EQUAL( AnalogCalibration_apply( 52000 ), 13000 );
+    TEST_EQUAL( AnalogCalibration_apply( 20000 ), 5500 );
+
+    // one point keeps the default gain
+    AnalogCalibration_clear();
+    TEST_CHECK( Test_addPoint( 30000, 8000 ) );
+    TEST_EQUAL( AnalogCalibration_apply( 30000 ), 8000 );
+    TEST_CHECK( abs( AnalogCalibration_apply( 40000 ) - 8000 - step )<=1 );
+}
+
+// Points that cannot be a divider are refused, and the calibration kept
+static void Test_rejected( void )
+{
+    AnalogCalibration_t     stored;
+    milli_t                 before[16];
+
+    AnalogCalibration_clear();
+    TEST_CHECK( Test_addPoint( 20000, 5500 ) );
+    Test_snapshot( before );
+
+    // reversed - more volts at a lower reading
+    TEST_CHECK( !Test_addPoint( 50000, 5000 ) );
+    Test_unchanged( before );
+
+    // too close together - the gain would not fit
+    TEST_CHECK( !Test_addPoint( 20001, 9000 ) );
+    Test_unchanged( before );
+
+    // the same reading
+    TEST_CHECK( !Test_addPoint( 20000, 6000 ) );
+    Test_unchanged( before );
+
+    // nor taken from flash
+    memset( &stored, 0, sizeof(stored) );
+    stored.version = 1;
+    stored.count = 2;
+    stored.points[0].reading = 50000;
+    stored.points[0].voltage = 13000;
+    stored.points[1].reading = 20000;
+    stored.points[1].voltage = 5500;
+    TEST_CHECK( FlashStore_write( FLASH_STORE_ANALOG_CALIBRATION, &stored, sizeof(stored) ) );
+    AnalogCalibration_init();
+    AnalogCalibration_clear();
+    Test_snapshot( before );
+    AnalogCalibration_init();
+    Test_unchanged( before );
+}
+
+// Public Functions
+
+int main( void )
+{
+    MockFlashStore_erase();
+    Test_makeAdc();
+    Test_linearity();
+    Test_divider();
+    Test_rejected();
+    return Test_result( "analog_calibration" );
+}
@@ -0,0 +1,100 @@
+/*---------------------------------------------------------------------------
+
+    CRC8 (test)
+        The table driven CRCs against the bit by bit routines they replaced
+
+    clayton@isnotcrazy.com
+
+    Built twice by CMake, once with CRC8_NIBBLE_TABLE, so both tables are
+    checked: every (crc, byte) pair, every HTU21D message, and the
+    datasheet vectors.
+
+---------------------------------------------------------------------------*/
+#include "test.h"
+#include "crc8_reference.h"
+#include "crc8.h"
+
+// Macros
+
+#ifdef CRC8_NIBBLE_TABLE
+#define TEST_NAME       "crc8 (nibble table)"
+#else
+#define TEST_NAME       "crc8"
+#endif
+
+// Private Functions
+
+// Every crc and byte, one update - failures are counted, not each printed
+static void Test_everyPair( void )
+{
+    int     maxim_failures;
+    int     htu21d_failures;
+    int     crc;
+    int     byte;
+
+    maxim_failures = 0;
+    htu21d_failures = 0;
+    for ( crc=0; crc<256; crc++ )
+    {
+        for ( byte=0; byte<256; byte++ )
+        {
+            maxim_failures += ( Crc8_maxim::update( (uint8_t)crc, (uint8_t)byte )!=
+                                    Crc8Reference_maxim( (uint8_t)crc, (uint8_t)byte ) );
+            htu21d_failures += ( Crc8_htu21d::update( (uint8_t)crc, (uint8_t)byte )!=
+                                    Crc8Reference_htu21d( (uint8_t)crc, (uint8_t)byte ) );
+        }
+    }
+    TEST_EQUAL( maxim_failures, 0 );
+    TEST_EQUAL( htu21d_failures, 0 );
+}
+
+// Every 16 bit HTU21D message: its CRC passes the old check, and no other check value does
+static void Test_htu21dMessages( void )
+{
+    uint8_t     bytes[2];
+    uint8_t     crc;
+    int         failures;
+    int         message;
+
+    failures = 0;
+    for ( message=0; message<65536; message++ )
+    {
+        bytes[0] = (uint8_t)( message >> 8 );
+        bytes[1] = (uint8_t)message;
+        crc = Crc8_htu21d::compute( bytes, 2 );
+        failures += ( Crc8Reference_htu21dCheck( (uint16_t)message, crc )!=0 );
+        failures += ( Crc8Reference_htu21dCheck( (uint16_t)message, (uint8_t)(crc ^ 0x01) )==0 );
+    }
+    TEST_EQUAL( failures, 0 );
+}
+
+// Known values
+static void Test_vectors( void )
+{
+    static const uint8_t    htu21d_short[] = { 0xDC };
+    static const uint8_t    htu21d_temperature[] = { 0x68, 0x3A };
+    static const uint8_t    htu21d_humidity[] = { 0x4E, 0x85 };
+    static const uint8_t    ds18b20_rom[] = { 0x02, 0x1C, 0xB8, 0x01, 0x00, 0x00, 0x00, 0xA2 };
+
+    // HTU21D datasheet
+    TEST_EQUAL( Crc8_htu21d::compute( htu21d_short, 1 ), 0x79 );
+    TEST_EQUAL( Crc8_htu21d::compute( htu21d_temperature, 2 ), 0x7C );
+    TEST_EQUAL( Crc8_htu21d::compute( htu21d_humidity, 2 ), 0x6B );
+
+    // Maxim application note 27 - a ROM's CRC over all eight bytes is zero
+    TEST_EQUAL( Crc8_maxim::compute( ds18b20_rom, 7 ), 0xA2 );
+    TEST_EQUAL( Crc8_maxim::compute( ds18b20_rom, 8 ), 0 );
+
+    // carried on from a previous crc
+    TEST_EQUAL( Crc8_htu21d::compute( &htu21d_temperature[1], 1, Crc8_htu21d::compute( htu21d_temperature, 1 ) ), 0x7C );
+}
+
+// Public Functions
+
+int main( void )
+{
+    Test_everyPair();
+    Test_htu21dMessages();
+    Test_vectors();
+    return Test_result( TEST_NAME );
+}
@@ -0,0 +1,242 @@
+/*---------------------------------------------------------------------------
+
+    I2C Bus (test)
+        Queued transactions, their completion and their failures
+
+    clayton@isnotcrazy.com
+
+    Runs i2c_bus.c against mock I2C blocks and DMA (mock_i2c.h) on the
+    mock RTOS.  Transactions from several submitters must run one at a
+    time in the order queued, each completion method must fire, and a
+    device that does not answer or holds the bus must end its
+    transaction with I2C_BUS_NAK or I2C_BUS_TIMEOUT without stopping the
+    ones after it.
+
+---------------------------------------------------------------------------*/
+#include <string.h>
+#include "test.h"
+#include "mock_rtos.h"
+#include "mock_i2c.h"
+#include "i2c_bus.h"
+
+// Macros
+
+#define TEST_BUS            0
+#define TEST_SUBMITTERS     4
+#define TEST_TIMEOUT_MS     20              // I2C_BUS_TIMEOUT_MS, in i2c_bus.c
+#define TEST_WAIT_MS        100
+
+#define TEST_FLAG_1         0x0002
+#define TEST_FLAG_2         0x0004
+
+#define TEST_ADDRESS        0x40            // answers
+#define TEST_ABSENT         0x50            // does not acknowledge
+#define TEST_HUNG           0x60            // holds the bus
+
+// Data
+
+static const uint8_t        test_reply[3] = { 0x68, 0x3A, 0x7C };
+
+static I2cTransaction_t     test_transactions[TEST_SUBMITTERS];
+static uint8_t              test_tx[TEST_SUBMITTERS][2];
+static uint8_t              test_rx[TEST_SUBMITTERS][3];
+static osEventFlagsId_t     test_events;
+
+static int                  test_callbacks[TEST_SUBMITTERS];
+static int                  test_callback_count;
+
+// Private Functions
+
+static void Test_callback( I2cTransaction_t *transaction )
+{
+    TEST_EQUAL( transaction->status, I2C_BUS_DONE );
+    if ( test_callback_count<TEST_SUBMITTERS )
+    {
+        test_callbacks[test_callback_count++] = *(int *)transaction->context;
+    }
+}
+
+// A driver on another thread, queueing its transaction without waiting
+static void Test_submitter( void *argument )
+{
+    TEST_CHECK( I2cBus_submit( TEST_BUS, (I2cTransaction_t *)argument ) );
+}
+
+static void Test_init( void )
+{
+    int     ii;
+
+    MockI2c_addDevice( TEST_BUS, TEST_ADDRESS, test_reply, sizeof(test_reply) );
+    for ( ii=1; ii<TEST_SUBMITTERS; ii++ )
+    {
+        MockI2c_addDevice( TEST_BUS, (uint8_t)(TEST_ADDRESS + ii), test_reply, sizeof(test_reply) );
+    }
+    MockI2c_hang( TEST_BUS, TEST_HUNG );
+    test_events = osEventFlagsNew( NULL );
+
+    TEST_CHECK( !I2cBus_init( I2C_BUS_COUNT, I2C_BUS_FAST_MODE, 4, 5 ) );
+    TEST_CHECK( I2cBus_init( TEST_BUS, I2C_BUS_FAST_MODE, 4, 5 ) );
+    TEST_CHECK( I2cBus_init( TEST_BUS, I2C_BUS_STANDARD_MODE, 4, 5 ) );     // shared
+}
+
+// Four submitters, each told its own way, run in the order they queued
+static void Test_queue( void )
+{
+    static int          test_ids[TEST_SUBMITTERS] = { 0, 1, 2, 3 };
+    const MockI2cTransfer_t *transfer;
+    I2cTransaction_t    *transaction;
+    uint32_t            flags;
+    int                 ii;
+
+    MockI2c_clear();
+    for ( ii=0; ii<TEST_SUBMITTERS; ii++ )
+    {
+        transaction = &test_transactions[ii];
+        memset( transaction, 0, sizeof(*transaction) );
+        test_tx[ii][0] = (uint8_t)(0xE3 + ii);
+        test_tx[ii][1] = (uint8_t)ii;
+        transaction->address = (uint8_t)(TEST_ADDRESS + ii);
+        transaction->tx = test_tx[ii];
+        transaction->tx_len = (uint16_t)(1 + (ii & 1));
+        transaction->rx = test_rx[ii];
+        transaction->rx_len = 3;
+        transaction->context = &test_ids[ii];
+    }
+    test_transactions[0].callback = Test_callback;
+    test_transactions[1].event = test_events;
+    test_transactions[1].flags = TEST_FLAG_1;
+    test_transactions[2].callback = Test_callback;
+    test_transactions[2].event = test_events;
+    test_transactions[2].flags = TEST_FLAG_2;
+    test_transactions[3].waiter = osThreadGetId();
+    test_transactions[3].rx_len = 0;                        // write only
+
+    // one from here, then three from other threads
+    osThreadFlagsClear( I2C_BUS_THREAD_FLAG );
+    TEST_CHECK( I2cBus_submit( TEST_BUS, &test_transactions[0] ) );
+    TEST_EQUAL( test_transactions[0].status, I2C_BUS_PENDING );
+    for ( ii=1; ii<TEST_SUBMITTERS; ii++ )
+    {
+        TEST_CHECK( osThreadNew( Test_submitter, &test_transactions[ii], NULL )!=NULL );
+    }
+
+    flags = osEventFlagsWait( test_events, TEST_FLAG_1 | TEST_FLAG_2, osFlagsWaitAll, TEST_WAIT_MS );
+    TEST_EQUAL( flags & osFlagsError, 0 );
+    flags = osThreadFlagsWait( I2C_BUS_THREAD_FLAG, osFlagsWaitAny, TEST_WAIT_MS );
+    TEST_EQUAL( flags & osFlagsError, 0 );
+
+    // in order, one at a time
+    TEST_EQUAL( MockI2c_transferCount(), TEST_SUBMITTERS );
+    for ( ii=0; (ii<MockI2c_transferCount()) && (ii<TEST_SUBMITTERS); ii++ )
+    {
+        transfer = MockI2c_transfer( ii );
+        transaction = &test_transactions[ii];
+        TEST_EQUAL( transfer->address, TEST_ADDRESS + ii );
+        TEST_CHECK( !transfer->overlapped );
+        TEST_CHECK( transfer->restart );
+        TEST_CHECK( transfer->stop );
+        TEST_EQUAL( transfer->write_len, transaction->tx_len );
+        TEST_CHECK( memcmp( transfer->written, transaction->tx, transaction->tx_len )==0 );
+        TEST_EQUAL( transfer->read_len, transaction->rx_len );
+        TEST_EQUAL( transaction->status, I2C_BUS_DONE );
+        if ( ii>0 )
+        {
+            TEST_EQUAL( transfer->time - MockI2c_transfer( ii-1 )->time, MOCK_I2C_TRANSFER_MS );
+        }
+    }
+    for ( ii=0; ii<3; ii++ )
+    {
+        TEST_CHECK( memcmp( test_rx[ii], test_reply, sizeof(test_reply) )==0 );
+    }
+
+    // the callbacks ran, in order
+    TEST_EQUAL( test_callback_count, 2 );
+    TEST_EQUAL( test_callbacks[0], 0 );
+    TEST_EQUAL( test_callbacks[1], 2 );
+}
+
+// Read only, waiting for it
+static void Test_transfer( void )
+{
+    const MockI2cTransfer_t *transfer;
+    uint8_t                 rx[5];
+
+    MockI2c_clear();
+    memset( rx, 0, sizeof(rx) );
+    TEST_EQUAL( I2cBus_transfer( TEST_BUS, TEST_ADDRESS, NULL, 0, rx, sizeof(rx) ), I2C_BUS_DONE );
+    TEST_EQUAL( MockI2c_transferCount(), 1 );
+    transfer = MockI2c_transfer( 0 );
+    TEST_EQUAL( transfer->write_len, 0 );
+    TEST_EQUAL( transfer->read_len, 5 );
+    TEST_CHECK( transfer->restart );
+    TEST_CHECK( transfer->stop );
+    TEST_EQUAL( rx[3], test_reply[0] );
+    TEST_EQUAL( rx[4], test_reply[1] );
+}
+
+// No device at the address - the abort is reported and cleared
+static void Test_nak( void )
+{
+    const uint8_t   tx[1] = { 0xE5 };
+    uint8_t         rx[2];
+
+    MockI2c_clear();
+    TEST_EQUAL( I2cBus_transfer( TEST_BUS, TEST_ABSENT, tx, sizeof(tx), rx, sizeof(rx) ), I2C_BUS_NAK );
+    TEST_EQUAL( MockI2c_aborts(), 2 );                      // both DMA channels stopped
+
+    // and the bus carries on
+    TEST_EQUAL( I2cBus_transfer( TEST_BUS, TEST_ADDRESS, tx, sizeof(tx), rx, sizeof(rx) ), I2C_BUS_DONE );
+    TEST_EQUAL( MockI2c_transferCount(), 2 );
+}
+
+// A device holding the bus - the transaction times out and the block is reset
+static void Test_timeout( void )
+{
+    const uint8_t   tx[1] = { 0xE5 };
+    uint8_t         rx[2];
+    uint32_t        start;
+
+    MockI2c_clear();
+    start = MockRtos_now();
+    TEST_EQUAL( I2cBus_transfer( TEST_BUS, TEST_HUNG, tx, sizeof(tx), rx, sizeof(rx) ), I2C_BUS_TIMEOUT );
+    TEST_EQUAL( MockRtos_now() - start, TEST_TIMEOUT_MS );
+    TEST_EQUAL( i2c_get_hw( i2c0 )->enable, 0 );
+    TEST_EQUAL( MockI2c_aborts(), 2 );
+
+    // the next transaction enables it again
+    TEST_EQUAL( I2cBus_transfer( TEST_BUS, TEST_ADDRESS, tx, sizeof(tx), rx, sizeof(rx) ), I2C_BUS_DONE );
+    TEST_EQUAL( i2c_get_hw( i2c0 )->enable, 1 );
+    TEST_EQUAL( MockI2c_transferCount(), 2 );
+    TEST_CHECK( !MockI2c_transfer( 1 )->overlapped );
+}
+
+// Requests that never reach the bus
+static void Test_errors( void )
+{
+    uint8_t     buffer[I2C_BUS_TRANSFER_MAX + 1];
+
+    MockI2c_clear();
+    memset( buffer, 0, sizeof(buffer) );
+    TEST_EQUAL( I2cBus_transfer( TEST_BUS, TEST_ADDRESS, NULL, 0, NULL, 0 ), I2C_BUS_ERROR );
+    TEST_EQUAL( I2cBus_transfer( TEST_BUS, TEST_ADDRESS, buffer, sizeof(buffer), NULL, 0 ), I2C_BUS_ERROR );
+    TEST_EQUAL( I2cBus_transfer( TEST_BUS, 0x80, buffer, 1, NULL, 0 ), I2C_BUS_ERROR );
+    TEST_EQUAL( MockI2c_transferCount(), 0 );
+
+    // bus 1 has not been set up
+    TEST_EQUAL( I2cBus_transfer( 1, TEST_ADDRESS, buffer, 1, NULL, 0 ), I2C_BUS_ERROR );
+    TEST_EQUAL( I2cBus_transfer( -1, TEST_ADDRESS, buffer, 1, NULL, 0 ), I2C_BUS_ERROR );
+}
+
+// Public Functions
+
+int main( void )
+{
+    Test_init();
+    Test_queue();
+    Test_transfer();
+    Test_nak();
+    Test_timeout();
+    Test_errors();
+    TEST_EQUAL( MockRtos_alarmsPending(), 0 );
+    return Test_result( "i2c_bus" );
+}
@@ -0,0 +1,211 @@
+/*---------------------------------------------------------------------------
+
+    Schedule (test)
+        Jobs on wall clock slots, set from the service console
+
+    clayton@isnotcrazy.com
+
+    Runs schedule.c and the console parser on the mock RTOS.  The clock is
+    set by typing "sched time <seconds since 1970>" as the user would, with
+    a real epoch, and the jobs must then wake on their wall clock slots -
+    the 20 s job at :00/:20/:40, and the 60 s job on the minute.  A job run
+    by hand must run once, at once, and then keep to those same slots.
+
+---------------------------------------------------------------------------*/
+#include <string.h>
+#include "test.h"
+#include "mock_rtos.h"
+#include "pico/stdlib.h"
+#include "hardware/watchdog.h"
+#include "console.h"
+#include "schedule.h"
+
+// Macros
+
+#define TEST_EPOCH          1760000005UL    // 2025-10-09 08:53:25 UTC
+#define TEST_SAMPLE_S       20
+#define TEST_PUBLISH_S      60
+#define TEST_STEP_MS        100             // SCHEDULE_STEP_MS, in schedule.c
+
+// Data
+
+static const char   *test_input = "";
+static int          test_feeds;
+
+static int          test_sample;
+static int          test_publish;
+
+// Private Functions
+
+// Type a line on the console, and let it run
+static void Test_type( const char *line )
+{
+    test_input = line;
+    Console_poll();
+    TEST_EQUAL( *test_input, '\0' );
+}
+
+// Seconds until the wall clock is next a whole number of periods
+static uint32_t Test_toSlot( uint32_t seconds, uint32_t period )
+{
+    return ( (seconds % period)==0 ) ? 0 : period - (seconds % period);
+}
+
+static void Test_parse( void )
+{
+    const char  *text;
+    uint32_t    value;
+
+    text = " 1760000000 next";
+    TEST_CHECK( Console_parseUnsigned( &text, &value ) );
+    TEST_EQUAL( value, 1760000000UL );
+    TEST_CHECK( strcmp( text, " next" )==0 );
+
+    text = "4294967295";
+    TEST_CHECK( Console_parseUnsigned( &text, &value ) );
+    TEST_EQUAL( value, 4294967295UL );
+
+    value = 7;
+    text = "4294967296";
+    TEST_CHECK( !Console_parseUnsigned( &text, &value ) );
+    text = "-1";
+    TEST_CHECK( !Console_parseUnsigned( &text, &value ) );
+    text = "12.5";
+    TEST_CHECK( !Console_parseUnsigned( &text, &value ) );
+    text = "";
+    TEST_CHECK( !Console_parseUnsigned( &text, &value ) );
+    TEST_EQUAL( value, 7 );
+}
+
+// The clock set from the console, and the jobs on its slots
+static void Test_time( void )
+{
+    int         due[SCHEDULE_JOBS_MAX];
+    uint32_t    start;
+    uint32_t    wall;
+    int         count;
+
+    test_sample = Schedule_addJob( "sample", TEST_SAMPLE_S*1000, 0, 0 );
+    test_publish = Schedule_addJob( "publish", TEST_PUBLISH_S*1000, 0, 1 );
+
+    // out of range - ignored
+    Test_type( "sched time 4294967296\r" );
+    Test_type( "sched time 1760000005\r" );
+
+    // the first 20 s slot after the time set
+    start = MockRtos_now();
+    count = Schedule_next( due );
+    wall = TEST_EPOCH + Test_toSlot( TEST_EPOCH, TEST_SAMPLE_S );
+    TEST_EQUAL( MockRtos_now() - start, Test_toSlot( TEST_EPOCH, TEST_SAMPLE_S )*1000 );
+    TEST_EQUAL( wall % TEST_SAMPLE_S, 0 );
+    TEST_EQUAL( count, 1 );
+    TEST_EQUAL( due[0], test_sample );
+    TEST_CHECK( test_feeds >= (int)Test_toSlot( TEST_EPOCH, TEST_SAMPLE_S )*10 );
+
+    // on to the minute, where both are due - publish (the higher priority) first
+    while ( (wall % TEST_PUBLISH_S)!=0 )
+    {
+        start = MockRtos_now();
+        count = Schedule_next( due );
+        wall += TEST_SAMPLE_S;
+        TEST_EQUAL( MockRtos_now() - start, TEST_SAMPLE_S*1000 );
+    }
+    TEST_EQUAL( count, 2 );
+    TEST_EQUAL( due[0], test_publish );
+    TEST_EQUAL( due[1], test_sample );
+    TEST_EQUAL( Schedule_stats( test_sample )->missed, 0 );
+}
+
+// Jobs run by hand, between slots
+static void Test_trigger( void )
+{
+    int         due[SCHEDULE_JOBS_MAX];
+    uint32_t    start;
+    uint32_t    runs;
+    int         count;
+
+    // from a job (as on a swarm), 7 s after the minute - publish at once
+    osDelay( 7000 );
+    runs = Schedule_stats( test_publish )->runs;
+    Schedule_trigger( test_publish );
+    start = MockRtos_now();
+    count = Schedule_next( due );
+    TEST_EQUAL( MockRtos_now() - start, 0 );
+    TEST_EQUAL( count, 1 );
+    TEST_EQUAL( due[0], test_publish );
+
+    // from the console while waiting - at the next poll
+    test_input = "sched run sample\r";
+    start = MockRtos_now();
+    count = Schedule_next( due );
+    TEST_EQUAL( MockRtos_now() - start, TEST_STEP_MS );
+    TEST_EQUAL( *test_input, '\0' );
+    TEST_EQUAL( count, 1 );
+    TEST_EQUAL( due[0], test_sample );
+
+    // then both back on their slots, at :20, :40 and the minute
+    count = Schedule_next( due );
+    TEST_EQUAL( MockRtos_now() - start, (TEST_SAMPLE_S - 7)*1000 );
+    TEST_EQUAL( count, 1 );
+    TEST_EQUAL( due[0], test_sample );
+    count = Schedule_next( due );
+    TEST_EQUAL( MockRtos_now() - start, (2*TEST_SAMPLE_S - 7)*1000 );
+    TEST_EQUAL( count, 1 );
+    count = Schedule_next( due );
+    TEST_EQUAL( MockRtos_now() - start, (TEST_PUBLISH_S - 7)*1000 );
+    TEST_EQUAL( count, 2 );
+    TEST_EQUAL( due[0], test_publish );
+    TEST_EQUAL( due[1], test_sample );
+
+    // the hand run is not a slot - none missed or late
+    TEST_EQUAL( Schedule_stats( test_publish )->runs, runs + 1 );
+    TEST_EQUAL( Schedule_stats( test_publish )->missed, 0 );
+    TEST_EQUAL( Schedule_stats( test_sample )->missed, 0 );
+    TEST_EQUAL( Schedule_stats( test_sample )->max_late_ms, 0 );
+}
+
+// Public Functions - the hardware and the other console commands
+
+int getchar_timeout_us( uint32_t timeout_us )
+{
+    (void)timeout_us;
+    return ( *test_input=='\0' ) ? PICO_ERROR_TIMEOUT : *test_input++;
+}
+
+void watchdog_update( void )
+{
+    test_feeds++;
+}
+
+void WeightSensor_command( const char *args )
+{
+    (void)args;
+}
+
+void WeightCalibration_command( const char *args )
+{
+    (void)args;
+}
+
+void TempSensor_command( const char *args )
+{
+    (void)args;
+}
+
+void AnalogCalibration_command( const char *args )
+{
+    (void)args;
+}
+
+void Acquisition_command( const char *args )
+{
+    (void)args;
+}
+
+int main( void )
+{
+    Test_parse();
+    Test_time();
+    Test_trigger();
+    return Test_result( "schedule" );
+}
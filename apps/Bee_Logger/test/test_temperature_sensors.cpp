@@ -0,0 +1,202 @@
+/*---------------------------------------------------------------------------
+
+    Temperature Sensors (test)
+        Conversions on every bus overlap
+
+    clayton@isnotcrazy.com
+
+    Runs temperature_sensors.cpp against mock One_wire buses on the mock
+    RTOS clock.  Convert T must reach every bus before any scratchpad is
+    read, and a read of all the buses must take one conversion time, not
+    one for each bus.  A probe dropped to low resolution must not report
+    the bits its datasheet leaves undefined.
+
+---------------------------------------------------------------------------*/
+#include "test.h"
+#include "mock_rtos.h"
+#include "mock_one_wire.h"
+#include "mock_flash_store.h"
+#include "temperature_sensors.h"
+
+// Macros
+
+#define TEST_SENSORS        5
+#define TEST_STABLE_READS   2           // more at 12 bits, after the two above, before dropping to 9
+
+// Data
+
+// as wired in temperature_sensors.cpp
+static const uint test_pins[TEMP_BUS_COUNT] = { 10, 11, 12, 15 };
+
+static const int test_conversion_ms = One_wire::conversion_time( 12 );
+
+// Private Functions
+
+static Fixed<4, Celsius> Test_celsius( double value )
+{
+    return Fixed<4, Celsius>::from_double( value );
+}
+
+// Check the log of one read of every bus
+static void Test_overlapped( void )
+{
+    const MockOneWireEvent  *event;
+    uint                    converted[TEMP_BUS_COUNT];
+    uint32_t                done_time[TEMP_BUS_COUNT];
+    int                     convert_count;
+    int                     first_read;
+    int                     ii;
+    int                     bus;
+
+    // every Convert T is sent before the first scratchpad read
+    convert_count = 0;
+    first_read = -1;
+    for ( ii=0; ii<MockOneWire_eventCount(); ii++ )
+    {
+        event = &MockOneWire_event( ii );
+        if ( (event->action==MockOneWireAction::read) && (first_read<0) )
+        {
+            first_read = ii;
+        }
+        if ( event->action==MockOneWireAction::convert )
+        {
+            TEST_CHECK( first_read<0 );
+            TEST_CHECK( convert_count<TEMP_BUS_COUNT );
+            if ( convert_count<TEMP_BUS_COUNT )
+            {
+                converted[convert_count++] = event->pin;
+            }
+        }
+    }
+    TEST_EQUAL( convert_count, TEMP_BUS_COUNT );
+    TEST_CHECK( first_read>=0 );
+    for ( bus=0; bus<TEMP_BUS_COUNT; bus++ )
+    {
+        for ( ii=0; (ii<convert_count) && (converted[ii]!=test_pins[bus]); ii++ )
+        {
+        }
+        TEST_CHECK( ii<convert_count );
+    }
+
+    // and no bus is read before its conversion has finished
+    for ( bus=0; bus<TEMP_BUS_COUNT; bus++ )
+    {
+        done_time[bus] = UINT32_MAX;
+    }
+    for ( ii=0; ii<MockOneWire_eventCount(); ii++ )
+    {
+        event = &MockOneWire_event( ii );
+        for ( bus=0; (bus<TEMP_BUS_COUNT) && (test_pins[bus]!=event->pin); bus++ )
+        {
+        }
+        TEST_CHECK( bus<TEMP_BUS_COUNT );
+        if ( (bus<TEMP_BUS_COUNT) && (event->action==MockOneWireAction::done) )
+        {
+            done_time[bus] = event->time;
+        }
+        if ( (bus<TEMP_BUS_COUNT) && (event->action==MockOneWireAction::read) )
+        {
+            TEST_CHECK( done_time[bus]!=UINT32_MAX );
+            TEST_CHECK( event->time>=done_time[bus] );
+        }
+    }
+}
+
+// Set up the buses - one probe on each, and a second on the last
+static void Test_init( void )
+{
+    int     bus;
+
+    MockFlashStore_erase();
+    for ( bus=0; bus<TEMP_BUS_COUNT; bus++ )
+    {
+        MockOneWire_addDevice( test_pins[bus], Test_celsius( 20.0 + bus ) );
+    }
+    MockOneWire_addDevice( test_pins[TEMP_BUS_COUNT-1], Test_celsius( 30.5 ) );
+
+    TempSensor_init();
+    TEST_EQUAL( TempSensor_count(), TEST_SENSORS );
+    TEST_CHECK( MockRtos_alarmsPending()==0 );
+}
+
+// One read of all of the buses
+static void Test_readAll( void )
+{
+    milli_t     results[SENSORS_MAX];
+    bool        valid[SENSORS_MAX];
+    uint32_t    start;
+    int         count;
+    int         ii;
+
+    MockOneWire_clearEvents();
+    start = MockRtos_now();
+    count = TempSensor_readAll( results, valid );
+    TEST_EQUAL( count, TEST_SENSORS );
+
+    // one conversion time in all - not one for each bus
+    TEST_EQUAL( MockRtos_now() - start, test_conversion_ms );
+    Test_overlapped();
+
+    for ( ii=0; ii<count; ii++ )
+    {
+        TEST_CHECK( valid[ii] );
+        TEST_EQUAL( results[ii], (ii<TEMP_BUS_COUNT) ? 20000 + 1000*ii : 30500 );
+    }
+}
+
+// Other work done between starting and finishing comes off the wait
+static void Test_startFinish( void )
+{
+    milli_t     results[SENSORS_MAX];
+    bool        valid[SENSORS_MAX];
+    uint32_t    start;
+    uint32_t    finish;
+
+    MockOneWire_clearEvents();
+    start = MockRtos_now();
+    TempSensor_startAll();
+    TEST_EQUAL( MockRtos_now() - start, 0 );
+
+    MockRtos_advance( 500 );
+    finish = MockRtos_now();
+    TEST_EQUAL( TempSensor_finishAll( results, valid ), TEST_SENSORS );
+    TEST_EQUAL( MockRtos_now() - finish, test_conversion_ms - 500 );
+    TEST_EQUAL( MockRtos_now() - start, test_conversion_ms );
+    Test_overlapped();
+}
+
+// Steady probes drop to 9 bits - a change then read keeps only the defined bits
+static void Test_lowResolution( void )
+{
+    milli_t     results[SENSORS_MAX];
+    bool        valid[SENSORS_MAX];
+    int         ii;
+
+    for ( ii=0; ii<TEST_STABLE_READS; ii++ )
+    {
+        TEST_EQUAL( TempSensor_readAll( results, valid ), TEST_SENSORS );
+    }
+    TEST_EQUAL( MockOneWire_resolution( test_pins[0], 0 ), 9 );
+
+    // unchanged - the full resolution reading is kept
+    TEST_EQUAL( TempSensor_readAll( results, valid ), TEST_SENSORS );
+    TEST_EQUAL( results[0], 20000 );
+
+    // moving - 25.4375 as read at 9 bits, 25.0 once the undefined bits go
+    MockOneWire_setTemperature( test_pins[0], 0, Test_celsius( 25.0 ) );
+    TEST_EQUAL( TempSensor_readAll( results, valid ), TEST_SENSORS );
+    TEST_CHECK( valid[0] );
+    TEST_EQUAL( results[0], 25000 );
+    TEST_EQUAL( MockOneWire_resolution( test_pins[0], 0 ), 12 );
+}
+
+// Public Functions
+
+int main( void )
+{
+    Test_init();
+    Test_readAll();
+    Test_startFinish();
+    Test_lowResolution();
+    return Test_result( "temperature_sensors" );
+}
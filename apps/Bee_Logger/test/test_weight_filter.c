@@ -0,0 +1,237 @@
+/*---------------------------------------------------------------------------
+
+    Weight Filter (test)
+        Each filter, on made up windows and on raw HX711 sequences
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+#include <stdlib.h>
+#include "test.h"
+#include "hx711_sequences.h"
+#include "weight_filter.h"
+
+// Macros
+
+#define TEST_FILTERS        4
+
+// Data
+
+static const WeightFilter_t test_filters[TEST_FILTERS] =
+{
+    WEIGHT_FILTER_MEAN, WEIGHT_FILTER_MEDIAN, WEIGHT_FILTER_TRIMMED_MEAN, WEIGHT_FILTER_HAMPEL
+};
+
+// Private Functions
+
+static WeightFilterResult_t Test_apply( WeightFilter_t filter, const int32_t *samples, int count )
+{
+    WeightFilterResult_t    result;
+
+    result.value = 0;
+    result.used = -1;
+    result.rejected = -1;
+    TEST_CHECK( WeightFilter_apply( filter, samples, count, &result ) );
+    TEST_EQUAL( result.rejected, ((count<WEIGHT_FILTER_MAX) ? count : WEIGHT_FILTER_MAX) - result.used );
+    return result;
+}
+
+// Odd windows take the middle sample, even ones the mean of the middle two
+static void Test_windowSizes( void )
+{
+    static const int32_t    odd[] = { 50, 10, 40, 20, 30 };
+    static const int32_t    even[] = { 40, 10, 30, 20 };
+    static const int32_t    negative[] = { -30, -20 };
+    WeightFilterResult_t    result;
+
+    result = Test_apply( WEIGHT_FILTER_MEDIAN, odd, 5 );
+    TEST_EQUAL( result.value, 30 );
+    TEST_EQUAL( result.rejected, 0 );
+    result = Test_apply( WEIGHT_FILTER_MEDIAN, even, 4 );
+    TEST_EQUAL( result.value, 25 );
+    result = Test_apply( WEIGHT_FILTER_MEDIAN, negative, 2 );
+    TEST_EQUAL( result.value, -25 );
+    result = Test_apply( WEIGHT_FILTER_MEDIAN, odd, 1 );
+    TEST_EQUAL( result.value, 50 );
+
+    // the mean rounds half away from zero
+    result = Test_apply( WEIGHT_FILTER_MEAN, even, 4 );
+    TEST_EQUAL( result.value, 25 );
+    result = Test_apply( WEIGHT_FILTER_MEAN, (const int32_t[]){ 1, 2 }, 2 );
+    TEST_EQUAL( result.value, 2 );
+    result = Test_apply( WEIGHT_FILTER_MEAN, (const int32_t[]){ -1, -2 }, 2 );
+    TEST_EQUAL( result.value, -2 );
+
+    // Hampel on both
+    result = Test_apply( WEIGHT_FILTER_HAMPEL, odd, 5 );
+    TEST_EQUAL( result.value, 30 );
+    TEST_EQUAL( result.rejected, 0 );
+    result = Test_apply( WEIGHT_FILTER_HAMPEL, even, 4 );
+    TEST_EQUAL( result.value, 25 );
+    TEST_EQUAL( result.rejected, 0 );
+}
+
+// The trimmed mean drops count/4 from each end
+static void Test_trim( void )
+{
+    static const int32_t    samples[16] = { 16, 3, 9, 1, 12, 5, 14, 7, 2, 11, 8, 15, 4, 13, 6, 10 };
+    WeightFilterResult_t    result;
+
+    result = Test_apply( WEIGHT_FILTER_TRIMMED_MEAN, samples, 3 );
+    TEST_EQUAL( result.used, 3 );
+    TEST_EQUAL( result.value, 9 );                  // (16+3+9)/3 - nothing dropped
+    result = Test_apply( WEIGHT_FILTER_TRIMMED_MEAN, samples, 4 );
+    TEST_EQUAL( result.used, 2 );
+    TEST_EQUAL( result.value, 6 );                  // 3 9
+    result = Test_apply( WEIGHT_FILTER_TRIMMED_MEAN, samples, 7 );
+    TEST_EQUAL( result.used, 5 );
+    TEST_EQUAL( result.rejected, 2 );
+    TEST_EQUAL( result.value, 9 );                  // 3 5 9 12 14 -> 8.6
+    result = Test_apply( WEIGHT_FILTER_TRIMMED_MEAN, samples, 8 );
+    TEST_EQUAL( result.used, 4 );
+    TEST_EQUAL( result.value, 8 );                  // 5 7 9 12 -> 8.25
+    result = Test_apply( WEIGHT_FILTER_TRIMMED_MEAN, samples, 16 );
+    TEST_EQUAL( result.used, 8 );
+    TEST_EQUAL( result.rejected, 8 );
+    TEST_EQUAL( result.value, 9 );                  // 5..12 -> 8.5
+}
+
+// A quiet window has a MAD of zero, taken as one count
+static void Test_zeroMad( void )
+{
+    static const int32_t    same[8] = { 500, 500, 500, 500, 500, 500, 500, 500 };
+    static const int32_t    glitch[8] = { 500, 500, 500, 530, 500, 500, 500, 500 };
+    static const int32_t    edge[8] = { 500, 500, 504, 500, 495, 500, 500, 500 };
+    WeightFilterResult_t    result;
+
+    result = Test_apply( WEIGHT_FILTER_HAMPEL, same, 8 );
+    TEST_EQUAL( result.value, 500 );
+    TEST_EQUAL( result.rejected, 0 );
+    result = Test_apply( WEIGHT_FILTER_HAMPEL, glitch, 8 );
+    TEST_EQUAL( result.value, 500 );
+    TEST_EQUAL( result.rejected, 1 );
+
+    // 4 counts is within 3 x 1.4826 of a MAD of 1, 5 is not
+    result = Test_apply( WEIGHT_FILTER_HAMPEL, edge, 8 );
+    TEST_EQUAL( result.used, 7 );
+    TEST_EQUAL( result.rejected, 1 );
+    TEST_EQUAL( result.value, 501 );                // 3504/7
+}
+
+// One bad sample moves the mean, but none of the robust filters
+static void Test_glitch( void )
+{
+    int32_t                 samples[8] = { 1000, 1002, 998, 1001, 999, 1000, 1001, 999 };
+    WeightFilterResult_t    result;
+    int                     position;
+
+    for ( position=0; position<8; position++ )
+    {
+        samples[position] += 1 << 19;
+
+        result = Test_apply( WEIGHT_FILTER_MEAN, samples, 8 );
+        TEST_CHECK( result.value>60000 );
+        TEST_EQUAL( result.rejected, 0 );
+        result = Test_apply( WEIGHT_FILTER_MEDIAN, samples, 8 );
+        TEST_CHECK( abs( result.value - 1000 )<=1 );
+        result = Test_apply( WEIGHT_FILTER_TRIMMED_MEAN, samples, 8 );
+        TEST_CHECK( abs( result.value - 1000 )<=1 );
+        TEST_EQUAL( result.rejected, 4 );
+        result = Test_apply( WEIGHT_FILTER_HAMPEL, samples, 8 );
+        TEST_CHECK( abs( result.value - 1000 )<=1 );
+        TEST_EQUAL( result.rejected, 1 );
+
+        samples[position] -= 1 << 19;
+    }
+}
+
+// Limits on the window
+static void Test_limits( void )
+{
+    int32_t                 samples[WEIGHT_FILTER_MAX+4];
+    WeightFilterResult_t    result;
+    int                     ii;
+
+    for ( ii=0; ii<WEIGHT_FILTER_MAX+4; ii++ )
+    {
+        samples[ii] = ( ii<WEIGHT_FILTER_MAX ) ? 100 : 100000;
+    }
+    for ( ii=0; ii<TEST_FILTERS; ii++ )
+    {
+        TEST_CHECK( !WeightFilter_apply( test_filters[ii], samples, 0, &result ) );
+        result = Test_apply( test_filters[ii], samples, WEIGHT_FILTER_MAX+4 );
+        TEST_EQUAL( result.value, 100 );
+        TEST_EQUAL( result.used + result.rejected, WEIGHT_FILTER_MAX );
+    }
+}
+
+// Every window of a sequence that does not cross its step
+static void Test_sequence( const Hx711Sequence_t *sequence, int window )
+{
+    WeightFilterResult_t    result;
+    const int32_t           *samples;
+    int32_t                 level;
+    int                     glitches;
+    int                     start;
+    int                     ii;
+
+    for ( start=0; start+window<=HX711_SEQUENCE_LENGTH; start++ )
+    {
+        if ( (start<sequence->step_at) && (start+window>sequence->step_at) )
+        {
+            continue;
+        }
+        samples = &sequence->samples[start];
+        level = ( start>=sequence->step_at ) ? sequence->step_level : sequence->level;
+        glitches = 0;
+        for ( ii=0; ii<window; ii++ )
+        {
+            if ( abs( samples[ii] - level )>HX711_SEQUENCE_NOISE )
+            {
+                glitches++;
+            }
+        }
+
+        result = Test_apply( WEIGHT_FILTER_MEAN, samples, window );
+        TEST_EQUAL( result.rejected, 0 );
+        TEST_CHECK( (glitches>0) == (abs( result.value - level )>HX711_SEQUENCE_NOISE) );
+
+        result = Test_apply( WEIGHT_FILTER_MEDIAN, samples, window );
+        TEST_CHECK( abs( result.value - level )<=HX711_SEQUENCE_NOISE );
+
+        result = Test_apply( WEIGHT_FILTER_TRIMMED_MEAN, samples, window );
+        TEST_EQUAL( result.rejected, 2*(window/4) );
+        if ( glitches<=window/4 )
+        {
+            TEST_CHECK( abs( result.value - level )<=HX711_SEQUENCE_NOISE );
+        }
+
+        result = Test_apply( WEIGHT_FILTER_HAMPEL, samples, window );
+        TEST_CHECK( abs( result.value - level )<=HX711_SEQUENCE_NOISE );
+        TEST_CHECK( result.rejected>=glitches );
+        if ( sequence->samples[0]==sequence->samples[1] )
+        {   // a load cell without noise - only the glitches go
+            TEST_EQUAL( result.rejected, glitches );
+        }
+    }
+}
+
+// Public Functions
+
+int main( void )
+{
+    int     ii;
+
+    Test_windowSizes();
+    Test_trim();
+    Test_zeroMad();
+    Test_glitch();
+    Test_limits();
+    for ( ii=0; ii<HX711_SEQUENCES; ii++ )
+    {
+        Test_sequence( &hx711_sequences[ii], 7 );
+        Test_sequence( &hx711_sequences[ii], 8 );
+    }
+    TEST_CHECK( WeightFilter_name( WEIGHT_FILTER_HAMPEL )[0]=='h' );
+    return Test_result( "weight_filter" );
+}
@@ -0,0 +1,460 @@
+/*---------------------------------------------------------------------------
+
+    Weight Calibration
+        Multi-point, temperature compensated load cell calibration
+
+    clayton@isnotcrazy.com
+
+    The calibration points split the raw reading range into segments, each
+    converted with its own integer slope.  Readings outside the points are
+    extrapolated from the nearest segment, so a single point (a tare)
+    keeps the default scale.  The segment for a reading is found from a
+    small index over the raw range, rather than by searching.
+
+    Load cell drift is modelled as a raw reading offset proportional to
+    the difference from a reference temperature.
+
+    A new calibration is built into the table not in use, so a failed
+    build leaves the old one untouched, and swapped in under a mutex that
+    conversions also hold - a conversion on the acquisition worker sees
+    one whole table, temperature terms included, however many changes
+    the console makes meanwhile.
+
+---------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cmsis_os2.h"
+#include "flash_store.h"
+#include "console.h"
+#include "weight_sensor.h"
+#include "weight_calibration.h"
+
+// Macros
+
+#define WEIGHT_CAL_VERSION      1
+
+#define WEIGHT_CAL_INDEX_BITS   5               // segment index buckets, as a power of 2
+#define WEIGHT_CAL_INDEX_SIZE   (1 << WEIGHT_CAL_INDEX_BITS)
+#define WEIGHT_CAL_SLOPE_BITS   20              // fraction bits on a slope, beyond those of Weight
+
+// Defaults, used until a calibration has been stored
+#define WEIGHT_RAW_OFFSET   -32300          // raw reading offset to subtract (before scaling)
+#define WEIGHT_SCALEFACTOR  (1.0/10673)     // Scale factor to apply to the output reading
+#define WEIGHT_OFFSET       0.0             // Kg offset to subtract (after scaling)
+#define WEIGHT_TEMP_REF     20000           // C (x 1000)
+
+// default slope and offset, folded to fixed point at compile time
+static constexpr int32_t weight_default_slope = (int32_t)( WEIGHT_SCALEFACTOR * (1 << Weight::frac_bits) * (1 << WEIGHT_CAL_SLOPE_BITS) + 0.5 );
+static constexpr milli_t weight_default_offset = (milli_t)( -WEIGHT_OFFSET * 1000 );
+
+// Types
+
+typedef struct
+{
+    int32_t     raw;            // start of the segment (temperature compensated)
+    int32_t     weight;         // Weight at the start of the segment
+    int32_t     slope;          // Weight per raw count, with WEIGHT_CAL_SLOPE_BITS extra fraction bits
+} WeightCalSegment_t;
+
+typedef struct
+{
+    int                 count;                      // segments
+    int                 shift;                      // raw reading offset to index bucket
+    WeightCalSegment_t  segments[WEIGHT_CAL_POINTS_MAX];
+    uint8_t             index[WEIGHT_CAL_INDEX_SIZE];   // first segment for each bucket
+    milli_t             temp_coeff;                 // as WeightCalibration_t
+    milli_t             temp_ref;
+} WeightCalTable_t;
+
+// Data
+
+static WeightCalibration_t          weight_calibration[WEIGHT_CELLS];
+
+// the table in use, and the one the next calibration is built into - both under weight_cal_mutex
+static WeightCalTable_t             weight_cal_tables[WEIGHT_CELLS][2];
+static WeightCalTable_t             *weight_cal_table[WEIGHT_CELLS];
+static osMutexId_t                  weight_cal_mutex;
+
+static volatile milli_t             weight_cal_temperature;
+static volatile bool                weight_cal_temperature_valid;
+
+// Private Functions
+
+// kg (x 1000) to Weight
+static int32_t WeightCalibration_toWeight( milli_t weight )
+{
+    return (int32_t)Weight::round_shift( ((int64_t)weight << Weight::frac_bits) / 125, 3 );
+}
+
+// Table in use, held still
+static void WeightCalibration_lock( void )
+{
+    if ( weight_cal_mutex!=NULL )
+    {
+        osMutexAcquire( weight_cal_mutex, osWaitForever );
+    }
+}
+
+static void WeightCalibration_unlock( void )
+{
+    if ( weight_cal_mutex!=NULL )
+    {
+        osMutexRelease( weight_cal_mutex );
+    }
+}
+
+// Raw reading referred to the reference temperature (locked)
+static int32_t WeightCalibration_compensate( const WeightCalTable_t *table, int32_t raw_reading )
+{
+    int64_t     drift;
+
+    if ( !weight_cal_temperature_valid || (table->temp_coeff==0) )
+    {
+        return raw_reading;
+    }
+    drift = (int64_t)table->temp_coeff * ( weight_cal_temperature - table->temp_ref );
+    return raw_reading - (int32_t)( drift / 1000000 );
+}
+
+// Build the segment table and its index from the calibration points
+static bool WeightCalibration_build( const WeightCalibration_t *calibration, WeightCalTable_t *table )
+{
+    const WeightCalPoint_t  *points;
+    WeightCalSegment_t      *segment;
+    int32_t                 start;
+    int64_t                 slope;
+    uint32_t                range;
+    int                     ii;
+    int                     bucket;
+
+    points = calibration->points;
+    if ( (calibration->count<0) || (calibration->count>WEIGHT_CAL_POINTS_MAX) )
+    {
+        return false;
+    }
+    table->temp_coeff = calibration->temp_coeff;
+    table->temp_ref = calibration->temp_ref;
+
+    if ( calibration->count==0 )
+    {   // defaults
+        table->count = 1;
+        table->segments[0].raw = WEIGHT_RAW_OFFSET;
+        table->segments[0].weight = WeightCalibration_toWeight( weight_default_offset );
+        table->segments[0].slope = weight_default_slope;
+    }
+    else if ( calibration->count==1 )
+    {   // offset only
+        table->count = 1;
+        table->segments[0].raw = points[0].raw;
+        table->segments[0].weight = WeightCalibration_toWeight( points[0].weight );
+        table->segments[0].slope = weight_default_slope;
+    }
+    else
+    {   // one segment between each pair of points
+        table->count = calibration->count - 1;
+        for ( ii=0; ii<table->count; ii++ )
+        {
+            if ( points[ii+1].raw<=points[ii].raw )
+            {
+                return false;
+            }
+            segment = &table->segments[ii];
+            segment->raw = points[ii].raw;
+            segment->weight = WeightCalibration_toWeight( points[ii].weight );
+            slope = ( (int64_t)( WeightCalibration_toWeight( points[ii+1].weight ) - segment->weight ) << WEIGHT_CAL_SLOPE_BITS )
+                        / ( points[ii+1].raw - points[ii].raw );
+            if ( (slope>INT32_MAX) || (slope<INT32_MIN) )
+            {   // points too close together
+                return false;
+            }
+            segment->slope = (int32_t)slope;
+        }
+    }
+
+    // bucket width, as a power of 2, to cover the segment starts
+    range = (uint32_t)( table->segments[table->count-1].raw - table->segments[0].raw );
+    table->shift = 0;
+    while ( (range >> table->shift) >= WEIGHT_CAL_INDEX_SIZE )
+    {
+        table->shift++;
+    }
+
+    // last segment starting at or before each bucket
+    ii = 0;
+    for ( bucket=0; bucket<WEIGHT_CAL_INDEX_SIZE; bucket++ )
+    {
+        start = table->segments[0].raw + (int32_t)( (uint32_t)bucket << table->shift );
+        while ( (ii+1<table->count) && (table->segments[ii+1].raw<=start) )
+        {
+            ii++;
+        }
+        table->index[bucket] = (uint8_t)ii;
+    }
+    return true;
+}
+
+// Make a calibration the one in use
+static bool WeightCalibration_use( int cell, const WeightCalibration_t *calibration )
+{
+    WeightCalTable_t    *table;
+    bool                built;
+
+    WeightCalibration_lock();
+    table = ( weight_cal_table[cell]==&weight_cal_tables[cell][0] ) ? &weight_cal_tables[cell][1] : &weight_cal_tables[cell][0];
+    built = WeightCalibration_build( calibration, table );
+    if ( built )
+    {
+        weight_calibration[cell] = *calibration;
+        weight_cal_table[cell] = table;
+    }
+    WeightCalibration_unlock();
+    return built;
+}
+
+// A valid load cell number
+static bool WeightCalibration_cellValid( int cell )
+{
+    if ( (cell<0) || (cell>=WEIGHT_CELLS) )
+    {
+        printf( "Weight calibration - no load cell %d\n", cell+1 );
+        return false;
+    }
+    return true;
+}
+
+// Public Functions
+
+// Load the stored calibration
+void WeightCalibration_init( void )
+{
+    WeightCalibration_t     stored[WEIGHT_CELLS];
+    bool                    loaded;
+    int                     cell;
+
+    if ( weight_cal_mutex==NULL )
+    {
+        weight_cal_mutex = osMutexNew( NULL );
+    }
+    loaded = FlashStore_read( FLASH_STORE_WEIGHT_CALIBRATION, stored, sizeof(stored) );
+    for ( cell=0; cell<WEIGHT_CELLS; cell++ )
+    {
+        if ( loaded && (stored[cell].version==WEIGHT_CAL_VERSION) && WeightCalibration_use( cell, &stored[cell] ) )
+        {
+            printf( "Weight calibration loaded - cell %d, %ld points\n", cell+1, (long)stored[cell].count );
+        }
+        else
+        {
+            printf( "Weight calibration - cell %d using defaults\n", cell+1 );
+            WeightCalibration_clear( cell );
+        }
+    }
+}
+
+// Set the load cell temperature
+void WeightCalibration_setTemperature( milli_t temperature )
+{
+    weight_cal_temperature = temperature;
+    weight_cal_temperature_valid = true;
+}
+
+// Convert a raw reading to kg
+Weight WeightCalibration_convert( int cell, int32_t raw_reading )
+{
+    const WeightCalTable_t      *table;
+    const WeightCalSegment_t    *segment;
+    int32_t                     raw;
+    uint32_t                    bucket;
+    int32_t                     weight;
+    int                         ii;
+
+    WeightCalibration_lock();
+    table = weight_cal_table[cell];
+    raw = WeightCalibration_compensate( table, raw_reading );
+
+    // find the segment - at most one step on from the indexed one, unless points share a bucket
+    ii = 0;
+    if ( raw>table->segments[0].raw )
+    {
+        bucket = (uint32_t)( raw - table->segments[0].raw ) >> table->shift;
+        ii = table->index[ (bucket<WEIGHT_CAL_INDEX_SIZE) ? bucket : WEIGHT_CAL_INDEX_SIZE-1 ];
+        while ( (ii+1<table->count) && (raw>=table->segments[ii+1].raw) )
+        {
+            ii++;
+        }
+    }
+    segment = &table->segments[ii];
+    weight = segment->weight + (int32_t)Weight::round_shift( (int64_t)( raw - segment->raw ) * segment->slope, 
+                WEIGHT_CAL_SLOPE_BITS );
+    WeightCalibration_unlock();
+
+    return Weight::from_raw( weight );
+}
+
+// Convert a raw reading to kg (x 1000)
+milli_t WeightCalibration_apply( int cell, int32_t raw_reading )
+{
+    return WeightCalibration_convert( cell, raw_reading ).to_milli();
+}
+
+// Capture a calibration point
+bool WeightCalibration_addPoint( int cell, milli_t weight )
+{
+    WeightCalibration_t     calibration;
+    WeightWindow_t          window;
+    WeightCalPoint_t        point;
+    int                     ii;
+    int                     jj;
+
+    if ( !WeightCalibration_cellValid( cell ) )
+    {
+        return false;
+    }
+    if ( !WeightSensor_window( WEIGHT_FILTER_MAX, &window ) )
+    {
+        printf( "Weight calibration - no reading\n" );
+        return false;
+    }
+    WeightCalibration_lock();
+    point.raw = WeightCalibration_compensate( weight_cal_table[cell], window.cell_raw[cell] );
+    WeightCalibration_unlock();
+    point.weight = weight;
+
+    // drop any point with the same weight, then insert in raw reading order
+    calibration = weight_calibration[cell];
+    for ( ii=0, jj=0; ii<calibration.count; ii++ )
+    {
+        if ( calibration.points[ii].weight!=weight )
+        {
+            calibration.points[jj++] = calibration.points[ii];
+        }
+    }
+    calibration.count = jj;
+    if ( calibration.count>=WEIGHT_CAL_POINTS_MAX )
+    {
+        printf( "Weight calibration - too many points\n" );
+        return false;
+    }
+    for ( ii=calibration.count; (ii>0) && (calibration.points[ii-1].raw>point.raw); ii-- )
+    {
+        calibration.points[ii] = calibration.points[ii-1];
+    }
+    calibration.points[ii] = point;
+    calibration.count++;
+
+    if ( !WeightCalibration_use( cell, &calibration ) )
+    {
+        printf( "Weight calibration - point does not fit the others\n" );
+        return false;
+    }
+    printf( "Weight calibration - cell %d point " MILLI_FMT " kg = %ld\n", cell+1, MILLI_ARGS(weight), (long)point.raw );
+    return true;
+}
+
+// Set the temperature coefficient
+bool WeightCalibration_setTempCoefficient( int cell, milli_t temp_coeff, milli_t temp_ref )
+{
+    WeightCalibration_t     calibration;
+
+    if ( !WeightCalibration_cellValid( cell ) )
+    {
+        return false;
+    }
+    calibration = weight_calibration[cell];
+    calibration.temp_coeff = temp_coeff;
+    calibration.temp_ref = temp_ref;
+    return WeightCalibration_use( cell, &calibration );
+}
+
+// Return to the defaults
+void WeightCalibration_clear( int cell )
+{
+    WeightCalibration_t     calibration;
+
+    if ( !WeightCalibration_cellValid( cell ) )
+    {
+        return;
+    }
+    memset( &calibration, 0, sizeof(calibration) );
+    calibration.version = WEIGHT_CAL_VERSION;
+    calibration.temp_ref = WEIGHT_TEMP_REF;
+    WeightCalibration_use( cell, &calibration );
+}
+
+// Store the calibration
+bool WeightCalibration_save( void )
+{
+    if ( !FlashStore_write( FLASH_STORE_WEIGHT_CALIBRATION, weight_calibration, sizeof(weight_calibration) ) )
+    {
+        printf( "Weight calibration - save failed\n" );
+        return false;
+    }
+    printf( "Weight calibration saved\n" );
+    return true;
+}
+
+// Print the calibration
+void WeightCalibration_show( void )
+{
+    const WeightCalibration_t   *calibration;
+    int                         cell;
+    int                         ii;
+
+    for ( cell=0; cell<WEIGHT_CELLS; cell++ )
+    {
+        calibration = &weight_calibration[cell];
+        printf( "Weight calibration - cell %d, %ld points  TC " MILLI_FMT " counts/C  Ref " MILLI_FMT " C\n", 
+                    cell+1, (long)calibration->count, MILLI_ARGS(calibration->temp_coeff), 
+                    MILLI_ARGS(calibration->temp_ref) );
+        for ( ii=0; ii<calibration->count; ii++ )
+        {
+            printf( "  %ld = " MILLI_FMT " kg\n", (long)calibration->points[ii].raw, 
+                        MILLI_ARGS(calibration->points[ii].weight) );
+        }
+    }
+}
+
+// Console command
+void WeightCalibration_command( const char *args )
+{
+    milli_t     value;
+    milli_t     temp_ref;
+    int         cell;
+
+    // load cell number, from 1 (optional with a single cell)
+    cell = 1;
+    Console_parseInt( &args, &cell );
+    cell--;
+    if ( !WeightCalibration_cellValid( cell ) )
+    {
+        return;
+    }
+
+    if ( Console_match( &args, "show" ) )
+    {
+        WeightCalibration_show();
+    }
+    else if ( Console_match( &args, "point" ) && Console_parseMilli( &args, &value ) )
+    {
+        WeightCalibration_addPoint( cell, value );
+    }
+    else if ( Console_match( &args, "tc" ) && Console_parseMilli( &args, &value ) )
+    {
+        temp_ref = weight_calibration[cell].temp_ref;
+        Console_parseMilli( &args, &temp_ref );
+        WeightCalibration_setTempCoefficient( cell, value, temp_ref );
+        WeightCalibration_show();
+    }
+    else if ( Console_match( &args, "clear" ) )
+    {
+        WeightCalibration_clear( cell );
+    }
+    else if ( Console_match( &args, "save" ) )
+    {
+        WeightCalibration_save();
+    }
+    else
+    {
+        printf( "cal [cell] show | point <kg> | tc <counts/C> [ref C] | clear | save\n" );
+    }
+}
@@ -0,0 +1,85 @@
+/*---------------------------------------------------------------------------
+
+    Weight Calibration
+        Multi-point, temperature compensated load cell calibration
+
+    clayton@isnotcrazy.com
+
+    Each load cell (WEIGHT_CELLS) has its own calibration.
+
+---------------------------------------------------------------------------*/
+
+#ifndef WEIGHT_CALIBRATION_H
+#define WEIGHT_CALIBRATION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fixed_point.h"
+#include "weight_sensor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Macros
+
+#define WEIGHT_CAL_POINTS_MAX   8           // calibration points held
+
+// Types
+
+// A known weight and the raw reading it gave, at the reference temperature
+typedef struct
+{
+    int32_t     raw;
+    milli_t     weight;         // kg (x 1000)
+} WeightCalPoint_t;
+
+// Calibration as stored in flash
+typedef struct
+{
+    uint32_t            version;
+    int32_t             count;              // points in use, sorted by raw reading
+    WeightCalPoint_t    points[WEIGHT_CAL_POINTS_MAX];
+    milli_t             temp_coeff;         // raw reading drift, counts per C (x 1000)
+    milli_t             temp_ref;           // temperature the points are referred to, C (x 1000)
+} WeightCalibration_t;
+
+// Functions
+
+// Load the stored calibration, or the built in defaults if there is none
+void WeightCalibration_init( void );
+
+// Set the load cell temperature used for compensation, C (x 1000)
+void WeightCalibration_setTemperature( milli_t temperature );
+
+// Convert a load cell's raw reading to kg (x 1000)
+milli_t WeightCalibration_apply( int cell, int32_t raw_reading );
+
+// Capture a load cell's current filtered reading as a calibration point of the given weight
+//  A point with the same weight is replaced
+bool WeightCalibration_addPoint( int cell, milli_t weight );
+
+// Set a load cell's temperature coefficient, counts per C (x 1000), and its reference temperature
+bool WeightCalibration_setTempCoefficient( int cell, milli_t temp_coeff, milli_t temp_ref );
+
+// Return a load cell to the built in defaults (not saved until WeightCalibration_save)
+void WeightCalibration_clear( int cell );
+
+// Store the calibration of every load cell in flash
+bool WeightCalibration_save( void );
+
+// Print the current calibration
+void WeightCalibration_show( void );
+
+// Console command handler - "cal [cell] show|point <kg>|tc <counts/C> [ref C]|clear|save"
+void WeightCalibration_command( const char *args );
+
+#ifdef __cplusplus
+}
+
+// Convert a load cell's raw reading to kg
+Weight WeightCalibration_convert( int cell, int32_t raw_reading );
+
+#endif
+
+#endif      // WEIGHT_CALIBRATION_H
@@ -0,0 +1,163 @@
+/*---------------------------------------------------------------------------
+
+    Weight Filter
+        Outlier rejecting filters for raw load cell readings
+
+    clayton@isnotcrazy.com
+
+    All of the arithmetic is integer, as the RP2040 has no FPU.
+    There are no hardware dependencies, so it can be built on a host.
+
+---------------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "weight_filter.h"
+
+// Macros
+
+// Hampel threshold: 3 * 1.4826 (MAD to standard deviation), scaled by 10000
+#define HAMPEL_THRESHOLD_X10000     44478
+#define HAMPEL_SCALE                10000
+
+// Private Functions
+
+// sort a small array in place
+static void WeightFilter_sort( int32_t *values, int count )
+{
+    int32_t     value;
+    int         ii;
+    int         jj;
+
+    for ( ii=1; ii<count; ii++ )
+    {
+        value = values[ii];
+        for ( jj=ii; (jj>0) && (values[jj-1]>value); jj-- )
+        {
+            values[jj] = values[jj-1];
+        }
+        values[jj] = value;
+    }
+}
+
+// median of a sorted array
+static int32_t WeightFilter_median( const int32_t *sorted, int count )
+{
+    if ( count & 1 )
+    {
+        return sorted[count/2];
+    }
+    return (int32_t)( ((int64_t)sorted[count/2-1] + sorted[count/2]) / 2 );
+}
+
+// rounded average of part of an array
+static int32_t WeightFilter_mean( const int32_t *values, int count )
+{
+    int64_t     total;
+    int         ii;
+
+    total = 0;
+    for ( ii=0; ii<count; ii++ )
+    {
+        total += values[ii];
+    }
+    if ( total<0 )
+    {
+        return (int32_t)( (total - count/2) / count );
+    }
+    return (int32_t)( (total + count/2) / count );
+}
+
+// average of the samples within the Hampel limit of the median
+static int32_t WeightFilter_hampel( const int32_t *sorted, int count, int *used )
+{
+    int32_t     deviations[WEIGHT_FILTER_MAX];
+    int32_t     kept[WEIGHT_FILTER_MAX];
+    int32_t     median;
+    int32_t     mad;
+    int         ii;
+
+    median = WeightFilter_median( sorted, count );
+    for ( ii=0; ii<count; ii++ )
+    {
+        deviations[ii] = ( sorted[ii]>median ) ? sorted[ii]-median : median-sorted[ii];
+    }
+    WeightFilter_sort( deviations, count );
+    mad = WeightFilter_median( deviations, count );
+    // a quiet window can have a MAD of zero - allow one count of noise
+    if ( mad<1 )
+    {
+        mad = 1;
+    }
+
+    *used = 0;
+    for ( ii=0; ii<count; ii++ )
+    {
+        int32_t deviation = ( sorted[ii]>median ) ? sorted[ii]-median : median-sorted[ii];
+        if ( (int64_t)deviation*HAMPEL_SCALE <= (int64_t)mad*HAMPEL_THRESHOLD_X10000 )
+        {
+            kept[(*used)++] = sorted[ii];
+        }
+    }
+    // the median itself is always kept, so used is at least 1
+    return WeightFilter_mean( kept, *used );
+}
+
+// Public Functions
+
+// Filter a window of raw samples
+bool WeightFilter_apply( WeightFilter_t filter, const int32_t *samples, int count, WeightFilterResult_t *result )
+{
+    int32_t     sorted[WEIGHT_FILTER_MAX];
+    int         trim;
+    int         ii;
+
+    if ( count>WEIGHT_FILTER_MAX )
+    {
+        count = WEIGHT_FILTER_MAX;
+    }
+    if ( count<1 )
+    {
+        return false;
+    }
+    for ( ii=0; ii<count; ii++ )
+    {
+        sorted[ii] = samples[ii];
+    }
+    WeightFilter_sort( sorted, count );
+
+    switch ( filter )
+    {
+        case WEIGHT_FILTER_MEDIAN:
+            result->value = WeightFilter_median( sorted, count );
+            result->used = count;
+            break;
+        case WEIGHT_FILTER_TRIMMED_MEAN:
+            trim = count / 4;
+            result->value = WeightFilter_mean( &sorted[trim], count-2*trim );
+            result->used = count - 2*trim;
+            break;
+        case WEIGHT_FILTER_HAMPEL:
+            result->value = WeightFilter_hampel( sorted, count, &result->used );
+            break;
+        case WEIGHT_FILTER_MEAN:
+        default:
+            result->value = WeightFilter_mean( sorted, count );
+            result->used = count;
+            break;
+    }
+    result->rejected = count - result->used;
+    return true;
+}
+
+// Name of a filter, for logging
+const char *WeightFilter_name( WeightFilter_t filter )
+{
+    switch ( filter )
+    {
+        case WEIGHT_FILTER_MEDIAN:          return "median";
+        case WEIGHT_FILTER_TRIMMED_MEAN:    return "trimmed mean";
+        case WEIGHT_FILTER_HAMPEL:          return "hampel";
+        case WEIGHT_FILTER_MEAN:
+        default:                            return "mean";
+    }
+}
@@ -0,0 +1,53 @@
+/*---------------------------------------------------------------------------
+
+    Weight Filter
+        Outlier rejecting filters for raw load cell readings
+
+    clayton@isnotcrazy.com
+
+---------------------------------------------------------------------------*/
+
+#ifndef WEIGHT_FILTER_H
+#define WEIGHT_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest window of samples a filter will take
+#define WEIGHT_FILTER_MAX       16
+
+// Filter types
+typedef enum
+{
+    WEIGHT_FILTER_MEAN = 0,         // plain average, nothing rejected
+    WEIGHT_FILTER_MEDIAN,           // median of the window
+    WEIGHT_FILTER_TRIMMED_MEAN,     // average after dropping the top and bottom quarter
+    WEIGHT_FILTER_HAMPEL            // average after rejecting samples > 3 sigma (by MAD) from the median
+} WeightFilter_t;
+
+// Filter output
+typedef struct
+{
+    int32_t     value;              // filtered raw value
+    int         used;               // samples contributing to the value
+    int         rejected;           // samples rejected as outliers
+} WeightFilterResult_t;
+
+// Functions
+
+// Filter a window of raw samples (integer arithmetic only)
+//  count is limited to WEIGHT_FILTER_MAX
+bool WeightFilter_apply( WeightFilter_t filter, const int32_t *samples, int count, WeightFilterResult_t *result );
+
+// Name of a filter, for logging
+const char *WeightFilter_name( WeightFilter_t filter );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif      // WEIGHT_FILTER_H
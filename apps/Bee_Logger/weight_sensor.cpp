@@ -0,0 +1,663 @@
+/*---------------------------------------------------------------------------
+
+    Weight Sensor
+        Routines to read from the HX711 load cell sensor
+
+    clayton@isnotcrazy.com
+
+    A sampler keeps a ring of the latest timestamped samples, so readings
+    never wait for the HX711.
+
+    With HX711_USE_PIO a state machine does the bit timing and DMA fills
+    a ring, so the sampler is a core0 thread that sleeps until the data
+    ready edge.  Bit-banged, the sampler runs on core1, which the RTOS
+    leaves idle, so no interrupt can stretch a clock pulse past the 60us
+    that powers the HX711 down.  Core1 has no RTOS, so it polls where a
+    thread would block, and hands the samples over through the lock-free
+    ring.  Core1 is not used with PIO: it would only poll a DMA count, and
+    every flash write would still have to lock it out.
+
+---------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
+#include "pico/multicore.h"
+#include "cmsis_os2.h"
+#include "console.h"
+#include "weight_sensor.h"
+#include "weight_calibration.h"
+#include "hx711.pio.h"
+
+// Macros
+
+#define HX711_CLOCK         8           // PD_SCK, shared by every HX711
+#define HX711_DATA          9           // DOUT of the first HX711, the others on the following pins
+                                        //  (GP10-12 carry temperature buses, so move this for more cells)
+#define HX711_DATA_MASK     (((1u << WEIGHT_CELLS) - 1) << HX711_DATA)
+
+#define HX711_GAIN          3           // GAIN: 1=128  2=32  3=64
+
+#define HX711_TIMEOUT_US    300000
+
+#define HX711_USE_PIO       1           // 1=PIO state machine and DMA ring   0=bit-banged
+#define HX711_ON_CORE1      (!HX711_USE_PIO)    // 1=sampler runs on core1   0=sampler thread on core0
+#define HX711_POLL_US       500         // core1 checks for a sample this often
+
+#define HX711_RING_BITS     8                                   // ring size in bytes, as a power of 2
+#define HX711_RING_SIZE     ((1 << HX711_RING_BITS) / sizeof(uint32_t))
+#define HX711_DMA_COUNT     0xFFFFFFFFu                         // transfers before the ring DMA must be re-armed
+
+#define HX711_READY_FLAG    0x0001          // event flag set by the DOUT falling edge
+#define HX711_READOUT_GUARD_US  (HX711_POLL_US + 1000)   // DOUT edges this soon after data ready are data bits
+                                                        //  (read out by PIO, or by core1 once its poll sees it)
+
+// DOUT edges interrupting core0 - every chip's while a core0 sampler waits for
+// them all, only the first chip's (for the latency) while core1 polls instead,
+// as core0 cannot tell when core1 is clocking data bits out of the others
+#if HX711_ON_CORE1
+#define HX711_READY_IRQ_CELLS   1
+#else
+#define HX711_READY_IRQ_CELLS   WEIGHT_CELLS
+#endif
+
+#define PIO_IN_BIT_COUNT    0x001Fu         // bit count field of a PIO "in" instruction
+
+static_assert( (WEIGHT_CELLS>=1) && (WEIGHT_CELLS<=4), "1 to 4 load cells are supported" );
+
+// clocks packed in each RX FIFO word - as many of the 24 as divide evenly and fit 32 bits
+static constexpr int hx711_word_clocks = (WEIGHT_CELLS==1) ? 24 : (WEIGHT_CELLS==2) ? 12 : 8;
+static constexpr int hx711_sample_words = 24 / hx711_word_clocks;
+
+#define WEIGHT_RING_SIZE    64          // timestamped samples kept by the sampler thread (power of 2)
+#define WEIGHT_STALE_MS     2000        // newest sample older than this means the sampler has stalled
+
+// Types
+
+typedef struct
+{
+    uint32_t    time_ms;                // ms since boot
+    int32_t     raw[WEIGHT_CELLS];
+} WeightSample_t;
+
+// Data
+
+#if !HX711_ON_CORE1
+static const osThreadAttr_t weight_sampler_attr = 
+{
+    .name = "weight",
+    .stack_size = 1024U,
+    .priority = osPriorityAboveNormal
+};
+#endif
+
+// Single producer (sampler thread) ring of the latest samples
+//  Only the producer writes weight_head.  Readers copy out a window and
+//  then re-check the head to make sure none of it was overwritten.
+static WeightSample_t       weight_ring[WEIGHT_RING_SIZE];
+static volatile uint32_t    weight_head;                // samples written so far
+
+static WeightFilter_t       weight_filter = WEIGHT_FILTER_HAMPEL;
+
+static osEventFlagsId_t     hx711_ready_event;
+static volatile uint32_t    hx711_ready_us;             // time of the last data ready edge
+static volatile uint32_t    hx711_readout_end_us;       // time the previous reading was clocked out
+static volatile uint32_t    hx711_latency_us;           // last measured conversion latency
+static volatile uint32_t    hx711_timeouts;             // samples the sampler gave up waiting for
+
+#if HX711_USE_PIO
+// samples written by DMA, aligned for the DMA ring wrap
+static uint32_t     hx711_ring[HX711_RING_SIZE] __attribute__((aligned(1 << HX711_RING_BITS)));
+static PIO          hx711_pio;
+static uint         hx711_sm;
+static int          hx711_dma_channel;
+static uint32_t     hx711_consumed;         // words taken from the ring so far
+#endif
+
+// Private Functions
+
+// DOUT falling edge - the HX711 has a conversion ready
+static void HX711_dataReadyIRQ( uint gpio, uint32_t events )
+{
+    uint32_t    now;
+
+    if ( (gpio<HX711_DATA) || (gpio>=HX711_DATA+WEIGHT_CELLS) || !(events & GPIO_IRQ_EDGE_FALL) )
+    {
+        return;
+    }
+    // latency is timed on the first chip
+    if ( gpio==HX711_DATA )
+    {
+        now = time_us_32();
+#if HX711_USE_PIO || HX711_ON_CORE1
+        // the state machine (or core1) clocks each reading out as soon as it is ready
+        if ( (now-hx711_ready_us) < HX711_READOUT_GUARD_US )
+        {
+            return;
+        }
+        hx711_readout_end_us = hx711_ready_us;
+#endif
+        hx711_latency_us = now - hx711_readout_end_us;
+        hx711_ready_us = now;
+    }
+    osEventFlagsSet( hx711_ready_event, HX711_READY_FLAG );
+}
+
+// sampling on core1, where there is no RTOS to block on
+static bool HX711_onCore1( void )
+{
+    return ( get_core_num()==1 );
+}
+
+// core1 - poll until ready, or timeout
+static bool HX711_poll( bool (*ready)( void ), int timeoutuSec )
+{
+    absolute_time_t     timeout;
+
+    timeout = make_timeout_time_us( timeoutuSec );
+    while ( !ready() )
+    {
+        if ( time_reached( timeout ) )
+        {
+            return false;
+        }
+        sleep_us( HX711_POLL_US );
+    }
+    return true;
+}
+
+// block the calling thread until the next data ready edge
+static bool HX711_waitForEdge( int timeoutuSec )
+{
+    uint32_t    flags;
+
+    flags = osEventFlagsWait( hx711_ready_event, HX711_READY_FLAG, osFlagsWaitAny, (timeoutuSec+999)/1000 );
+    return ( (flags & osFlagsError)==0 );
+}
+
+static void HX711_reset( void )
+{
+    sleep_us(500);
+    gpio_put( HX711_CLOCK, true );
+    sleep_us(200);
+    gpio_put( HX711_CLOCK, false );
+    sleep_us(500);
+}
+
+// split bits clocked in from every DOUT pin into each chip's reading
+//  one slice of WEIGHT_CELLS bits (lowest pin first) per clock, the first clock highest
+static void HX711_deinterleave( uint32_t bits, int clocks, uint32_t values[WEIGHT_CELLS] )
+{
+    uint32_t    slice;
+    int         clock;
+    int         cell;
+
+    for ( clock=clocks-1; clock>=0; clock-- )
+    {
+        slice = bits >> (clock*WEIGHT_CELLS);
+        for ( cell=0; cell<WEIGHT_CELLS; cell++ )
+        {
+            values[cell] = (values[cell] << 1) | ((slice >> cell) & 1);
+        }
+    }
+}
+
+#if HX711_USE_PIO
+
+// start the state machine and the DMA stream into the ring
+static void HX711_start( void )
+{
+    uint16_t            instructions[ sizeof(hx711_program_instructions)/sizeof(hx711_program_instructions[0]) ];
+    pio_program_t       program;
+    uint                offset;
+    dma_channel_config  config;
+
+    // sample every DOUT pin on each clock
+    memcpy( instructions, hx711_program_instructions, sizeof(instructions) );
+    instructions[hx711_offset_ready_sample] = (instructions[hx711_offset_ready_sample] & ~PIO_IN_BIT_COUNT) | WEIGHT_CELLS;
+    instructions[hx711_offset_bit_sample] = (instructions[hx711_offset_bit_sample] & ~PIO_IN_BIT_COUNT) | WEIGHT_CELLS;
+    program = hx711_program;
+    program.instructions = instructions;
+
+    hx711_pio = pio1;
+    offset = pio_add_program( hx711_pio, &program );
+    hx711_sm = (uint)pio_claim_unused_sm( hx711_pio, true );
+    hx711_program_init( hx711_pio, hx711_sm, offset, HX711_CLOCK, HX711_DATA, WEIGHT_CELLS, hx711_word_clocks*WEIGHT_CELLS );
+
+    hx711_dma_channel = dma_claim_unused_channel( true );
+    config = dma_channel_get_default_config( hx711_dma_channel );
+    channel_config_set_transfer_data_size( &config, DMA_SIZE_32 );
+    channel_config_set_read_increment( &config, false );
+    channel_config_set_write_increment( &config, true );
+    channel_config_set_ring( &config, true, HX711_RING_BITS );
+    channel_config_set_dreq( &config, pio_get_dreq( hx711_pio, hx711_sm, false ) );
+    dma_channel_configure( hx711_dma_channel, &config, hx711_ring, &hx711_pio->rxf[hx711_sm], HX711_DMA_COUNT, true );
+    hx711_consumed = 0;
+
+    // gain pulses to give after every reading, then go
+    pio_sm_put( hx711_pio, hx711_sm, HX711_GAIN-1 );
+    pio_sm_set_enabled( hx711_pio, hx711_sm, true );
+}
+
+// number of words DMA has written into the ring since the start
+static uint32_t HX711_produced( void )
+{
+    return HX711_DMA_COUNT - dma_hw->ch[hx711_dma_channel].transfer_count;
+}
+
+// a whole sample waiting in the ring
+static bool HX711_sampleReady( void )
+{
+    return ( (HX711_produced()-hx711_consumed) >= (uint32_t)hx711_sample_words );
+}
+
+// take the next sample from the ring, waiting for it if needed
+static bool HX711_read( bool wait, int32_t result[WEIGHT_CELLS] )
+{
+	uint32_t        uvalue[WEIGHT_CELLS];
+    uint32_t        lag;
+    int             ii;
+
+    // wait for a sample, blocking until the data ready edge
+    if ( HX711_onCore1() && !HX711_poll( HX711_sampleReady, HX711_TIMEOUT_US ) )
+    {
+        return false;
+    }
+    while ( !HX711_sampleReady() )
+    {
+        osEventFlagsClear( hx711_ready_event, HX711_READY_FLAG );
+        if ( HX711_sampleReady() )
+        {
+            break;
+        }
+        if ( !HX711_waitForEdge( HX711_TIMEOUT_US ) )
+        {
+            return false;
+        }
+        // the state machine clocks the sample out straight after the edge
+        osDelay( 1 );
+    }
+    // the ring may have lapped an idle reader - skip whole samples to catch up
+    lag = HX711_produced() - hx711_consumed;
+    if ( lag > HX711_RING_SIZE )
+    {
+        hx711_consumed += ( lag/hx711_sample_words - (HX711_RING_SIZE/hx711_sample_words - 1) ) * hx711_sample_words;
+    }
+    memset( uvalue, 0, sizeof(uvalue) );
+    for ( ii=0; ii<hx711_sample_words; ii++ )
+    {
+        HX711_deinterleave( hx711_ring[ hx711_consumed % HX711_RING_SIZE ], hx711_word_clocks, uvalue );
+        hx711_consumed++;
+    }
+
+    // convert to 24-bit signed values
+    for ( ii=0; ii<WEIGHT_CELLS; ii++ )
+    {
+        result[ii] = ((int32_t)(uvalue[ii] << 8)) / 256;
+    }
+    return true;
+}
+
+#else
+
+static void HX711_setGainFactor( void )
+{
+    int     ii;
+
+	// Set the channel and the gain factor for the next reading using the clock pin.
+	for ( ii=0; ii<HX711_GAIN; ii++ )
+    {
+        gpio_put( HX711_CLOCK, true );
+        busy_wait_us_32(10);
+        gpio_put( HX711_CLOCK, false );
+        busy_wait_us_32(10);
+	}
+}
+
+// Pulse the clock pin 24 times, reading every DOUT pin together on each clock
+static void HX711_shiftInData( uint32_t values[WEIGHT_CELLS] )
+{
+    uint32_t    pins;
+    int         i;
+
+    for( i=0; i<24; i++ ) 
+    {
+        gpio_put( HX711_CLOCK, true );
+        busy_wait_us_32(10);
+        pins = gpio_get_all();
+        HX711_deinterleave( (pins & HX711_DATA_MASK) >> HX711_DATA, 1, values );
+        gpio_put( HX711_CLOCK, false );
+        busy_wait_us_32(10);
+    }
+}
+
+// every DOUT low
+static bool HX711_allReady( void )
+{
+    return ( (gpio_get_all() & HX711_DATA_MASK)==0 );
+}
+
+static void HX711_enableReadyIRQ( bool enabled )
+{
+    int     ii;
+
+    for ( ii=0; ii<HX711_READY_IRQ_CELLS; ii++ )
+    {
+        if ( enabled )
+        {
+            gpio_acknowledge_irq( HX711_DATA+ii, GPIO_IRQ_EDGE_FALL );
+        }
+        gpio_set_irq_enabled( HX711_DATA+ii, GPIO_IRQ_EDGE_FALL, enabled );
+    }
+}
+
+static bool HX711_waitForReady( int timeoutuSec )
+{
+    absolute_time_t     timeout;
+    int64_t             remaining;
+
+    if ( HX711_onCore1() )
+    {
+        return HX711_poll( HX711_allReady, timeoutuSec );
+    }
+    timeout = make_timeout_time_us( timeoutuSec );
+    while ( 1 )
+    {
+        // the edge may already have happened
+        osEventFlagsClear( hx711_ready_event, HX711_READY_FLAG );
+        if ( HX711_allReady() )
+        {   // data ready
+            return true;
+        }
+        // block until a data pin goes low (or timeout)
+        remaining = absolute_time_diff_us( get_absolute_time(), timeout );
+        if ( remaining<=0 )
+        {
+            return false;
+        }
+        HX711_waitForEdge( (int)remaining );
+    }
+}
+
+// perform one reading, after waiting for it
+static bool HX711_read( bool wait, int32_t result[WEIGHT_CELLS] )
+{
+	uint32_t        uvalue[WEIGHT_CELLS];
+    uint32_t        interrupts;
+    bool            retb;
+    int             ii;
+
+    // always wait, but ignore this or not depending on flag
+    retb = HX711_waitForReady( HX711_TIMEOUT_US );
+    if ( wait && !retb )
+    {
+        return false;
+    }
+    // the data bits toggle DOUT, so ignore its edges while reading
+    //  (interrupt enables are per core, so core1 cannot - see HX711_READY_IRQ_CELLS)
+    if ( !HX711_onCore1() )
+    {
+        HX711_enableReadyIRQ( false );
+    }
+    // nothing may stretch a clock pulse on core1 - over 60us high powers the HX711 down
+    interrupts = HX711_onCore1() ? save_and_disable_interrupts() : 0;
+    // Pulse the clock pin 24 times to read the data.
+    memset( uvalue, 0, sizeof(uvalue) );
+    HX711_shiftInData( uvalue );
+
+	// Set the channel and the gain factor for the next reading using the clock pin.
+    HX711_setGainFactor();
+    if ( HX711_onCore1() )
+    {
+        restore_interrupts( interrupts );
+    }
+    hx711_readout_end_us = time_us_32();
+    if ( !HX711_onCore1() )
+    {
+        HX711_enableReadyIRQ( true );
+    }
+
+    for ( ii=0; ii<WEIGHT_CELLS; ii++ )
+    {
+        // convert to 24-bit signed value
+        // shift to top of word
+        uvalue[ii] = (uvalue[ii] << 8);
+        // change to signed and return to 24 bits
+        result[ii] = ((long)uvalue[ii]) / 256;
+    }
+
+    // always return wait result
+	return retb;
+}
+
+#endif
+
+
+// Add the next sample to the ring
+//  Only the sampler calls this, and it must not print (it may be on core1)
+static void WeightSensor_sample( void )
+{
+    int32_t     reading[WEIGHT_CELLS];
+    uint32_t    head;
+
+    if ( !HX711_read( true, reading ) )
+    {
+        hx711_timeouts++;
+#if !HX711_USE_PIO
+        HX711_reset();
+#endif
+        return;
+    }
+    head = weight_head;
+    weight_ring[ head % WEIGHT_RING_SIZE ].time_ms = to_ms_since_boot( get_absolute_time() );
+    memcpy( weight_ring[ head % WEIGHT_RING_SIZE ].raw, reading, sizeof(reading) );
+    // sample must be visible (to either core) before the head moves over it
+    __dmb();
+    weight_head = head + 1;
+}
+
+#if HX711_ON_CORE1
+
+// Core1 - keeps the ring filled with the latest samples
+//  It parks itself in RAM whenever core0 writes to flash (see flash_store.c)
+static void WeightSensor_core1( void )
+{
+    multicore_lockout_victim_init();
+    while ( 1 )
+    {
+        WeightSensor_sample();
+    }
+}
+
+#else
+
+// Background thread - keeps the ring filled with the latest samples
+static void WeightSensor_sampler( void *argument )
+{
+    while ( 1 )
+    {
+        WeightSensor_sample();
+    }
+}
+
+#endif
+
+// convert a load cell's raw reading to kg, with its stored calibration
+static Weight WeightSensor_scale( int cell, int32_t raw_reading )
+{
+    return WeightCalibration_convert( cell, raw_reading );
+}
+
+// Public Functions
+
+// Initialise the sensor
+void WeightSensor_init( void )
+{
+    int32_t reading[WEIGHT_CELLS];
+
+    WeightCalibration_init();
+	gpio_init_mask( HX711_DATA_MASK );
+	gpio_set_dir_in_masked( HX711_DATA_MASK );
+	gpio_init(HX711_CLOCK);
+	gpio_set_dir( HX711_CLOCK, GPIO_OUT );
+	gpio_put( HX711_CLOCK, false );
+    // reset the device - >60uS of high
+    HX711_reset();    
+    // data ready interrupt
+    hx711_ready_event = osEventFlagsNew( NULL );
+    gpio_set_irq_enabled_with_callback( HX711_DATA, GPIO_IRQ_EDGE_FALL, true, HX711_dataReadyIRQ );
+#if HX711_USE_PIO
+    HX711_start();
+#else
+    HX711_enableReadyIRQ( true );
+#endif
+    // dummy reading (made before the gain was selected)
+    HX711_read( false, reading );
+    // sample continuously from now on
+    weight_head = 0;
+#if HX711_ON_CORE1
+    multicore_launch_core1( WeightSensor_core1 );
+#else
+    osThreadNew( WeightSensor_sampler, NULL, &weight_sampler_attr );
+#endif
+}
+
+// Filter the most recent samples, without waiting for the sensor
+bool WeightSensor_window( int count, WeightWindow_t *window )
+{
+    WeightSample_t          samples[WEIGHT_FILTER_MAX];
+    int32_t                 raw[WEIGHT_FILTER_MAX];
+    WeightFilterResult_t    filtered;
+    uint32_t                head;
+    uint32_t                first;
+    uint32_t                now;
+    int                     ii;
+    int                     cell;
+
+    if ( count>WEIGHT_FILTER_MAX )
+    {
+        count = WEIGHT_FILTER_MAX;
+    }
+    if ( count<1 )
+    {
+        return false;
+    }
+
+    // copy out the newest samples, retrying if the sampler lapped us
+    do
+    {
+        head = weight_head;
+        __dmb();
+        if ( head<(uint32_t)count )
+        {
+            count = (int)head;
+        }
+        if ( count==0 )
+        {
+            return false;
+        }
+        first = head - count;
+        for ( ii=0; ii<count; ii++ )
+        {
+            samples[ii] = weight_ring[ (first+ii) % WEIGHT_RING_SIZE ];
+        }
+        __dmb();
+    } while ( (weight_head-first) >= WEIGHT_RING_SIZE );
+
+    now = to_ms_since_boot( get_absolute_time() );
+    if ( (now-samples[count-1].time_ms) > WEIGHT_STALE_MS )
+    {
+        printf( "Weight samples are stale (%u mSec old, %u timeouts)\n", now-samples[count-1].time_ms,
+                    (unsigned int)hx711_timeouts );
+        return false;
+    }
+
+    // filter each cell, then total them
+    window->count = count;
+    window->rejected = 0;
+    window->newest_ms = samples[count-1].time_ms;
+    window->value = 0;
+    for ( cell=0; cell<WEIGHT_CELLS; cell++ )
+    {
+        for ( ii=0; ii<count; ii++ )
+        {
+            raw[ii] = samples[ii].raw[cell];
+        }
+        WeightFilter_apply( weight_filter, raw, count, &filtered );
+        if ( filtered.rejected>window->rejected )
+        {
+            window->rejected = filtered.rejected;
+        }
+        window->cell_raw[cell] = filtered.value;
+        window->cell_value[cell] = WeightSensor_scale( cell, filtered.value ).to_milli();
+        window->value += window->cell_value[cell];
+    }
+    return true;
+}
+
+// Read the sensor, producing a result in kg
+bool WeightSensor_read( int count, milli_t *result )
+{
+    WeightWindow_t  window;
+    int             cell;
+
+    if ( !WeightSensor_window( count, &window ) )
+    {
+        printf( "Weight reading unavailable\n" );
+        return false;
+    }
+    for ( cell=0; cell<WEIGHT_CELLS; cell++ )
+    {
+        printf( "Cell %d Raw Reading:  %d  Scaled:  " MILLI_FMT " kg\n", cell+1, window.cell_raw[cell], 
+                    MILLI_ARGS(window.cell_value[cell]) );
+    }
+    printf( "Filter:  %s of %d readings, %d rejected\n", WeightFilter_name( weight_filter ), window.count, window.rejected );
+    printf( "Scaled Reading:  " MILLI_FMT " kg\n", MILLI_ARGS(window.value) );
+    printf( "Conversion latency:  %u uSec\n", WeightSensor_latency() );
+
+    *result = window.value;
+    return true;
+}
+
+// Select the filter used for readings
+void WeightSensor_setFilter( WeightFilter_t filter )
+{
+    weight_filter = filter;
+}
+
+// Last measured HX711 conversion latency in uSec
+uint32_t WeightSensor_latency( void )
+{
+    return hx711_latency_us;
+}
+
+// Console command
+void WeightSensor_command( const char *args )
+{
+    if ( !Console_match( &args, "filter" ) )
+    {
+        printf( "weight filter [mean | median | trimmed | hampel]\n" );
+        return;
+    }
+    if ( Console_match( &args, "mean" ) )
+    {
+        WeightSensor_setFilter( WEIGHT_FILTER_MEAN );
+    }
+    else if ( Console_match( &args, "median" ) )
+    {
+        WeightSensor_setFilter( WEIGHT_FILTER_MEDIAN );
+    }
+    else if ( Console_match( &args, "trimmed" ) )
+    {
+        WeightSensor_setFilter( WEIGHT_FILTER_TRIMMED_MEAN );
+    }
+    else if ( Console_match( &args, "hampel" ) )
+    {
+        WeightSensor_setFilter( WEIGHT_FILTER_HAMPEL );
+    }
+    printf( "Weight filter - %s\n", WeightFilter_name( weight_filter ) );
+}
@@ -11,18 +11,52 @@
 #define WEIGHT_SENSORS_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "weight_filter.h"
+#include "fixed_point.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Macros
+
+#define WEIGHT_CELLS        1           // load cells, each with its own HX711 (1..4)
+
+// Types
+
+// Summary of the most recent window of samples
+typedef struct
+{
+    int         count;          // samples in the window
+    int         rejected;       // samples rejected as outliers by the filter (worst cell)
+    uint32_t    newest_ms;      // time of the newest sample, ms since boot
+    milli_t     value;          // total of the cells in kg (x 1000)
+    int32_t     cell_raw[WEIGHT_CELLS];     // filtered raw reading of each cell
+    milli_t     cell_value[WEIGHT_CELLS];   // filtered reading of each cell in kg (x 1000)
+} WeightWindow_t;
+
 // Functions
 
-// Initialise the sensor
+// Initialise the sensor, and start the background sampler
 void WeightSensor_init( void );
 
-// Read the sensor, producing a result in kg
-bool WeightSensor_read( int count, double *result );
+// Read the sensor, producing the total of the cells in kg (x 1000)
+//  Returns the filtered value of the latest count samples immediately
+bool WeightSensor_read( int count, milli_t *result );
+
+// Filter the latest count samples (at most WEIGHT_FILTER_MAX), without waiting
+bool WeightSensor_window( int count, WeightWindow_t *window );
+
+// Select the filter used by WeightSensor_read and WeightSensor_window
+void WeightSensor_setFilter( WeightFilter_t filter );
+
+// Last measured HX711 conversion latency in uSec
+//  (from the end of one reading to data ready for the next)
+uint32_t WeightSensor_latency( void );
+
+// Console command handler - "weight filter [mean|median|trimmed|hampel]"
+void WeightSensor_command( const char *args );
 
 #ifdef __cplusplus
 }